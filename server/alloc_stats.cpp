@@ -0,0 +1,42 @@
+#include "alloc_stats.h"
+
+#ifdef ALLOC_STATS
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local uint64_t t_allocations = 0;
+thread_local uint64_t t_taken = 0;
+}
+
+void* operator new(std::size_t size) {
+    t_allocations++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    t_allocations++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+uint64_t alloc_stats::threadAllocations() { return t_allocations; }
+
+uint64_t alloc_stats::takeThreadAllocations() {
+    uint64_t n = t_allocations - t_taken;
+    t_taken = t_allocations;
+    return n;
+}
+
+#else
+
+uint64_t alloc_stats::threadAllocations() { return 0; }
+uint64_t alloc_stats::takeThreadAllocations() { return 0; }
+
+#endif
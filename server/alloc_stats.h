@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+// Подсчёт выделений памяти в куче для проверки того, что обработка сессий
+// в установившемся режиме не выделяет память. Включается сборкой
+// make ALLOC_STATS=1 (заменяет глобальный operator new); в обычной сборке
+// счётчик всегда равен нулю.
+namespace alloc_stats {
+
+constexpr bool kEnabled =
+#ifdef ALLOC_STATS
+    true;
+#else
+    false;
+#endif
+
+// Число выделений, сделанных текущим потоком с момента запуска
+uint64_t threadAllocations();
+// Выделения текущего потока с прошлого вызова (для метрик)
+uint64_t takeThreadAllocations();
+
+// Считает выделения текущего потока за время жизни объекта
+class Scope {
+    uint64_t& total_;
+    uint64_t start_;
+public:
+    explicit Scope(uint64_t& total) : total_(total), start_(threadAllocations()) {}
+    ~Scope() { total_ += threadAllocations() - start_; }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+};
+
+}
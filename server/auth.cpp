@@ -0,0 +1,170 @@
+#include "auth.h"
+#include "client_db.h"
+
+#include <cstring>
+#include <ctime>
+#include <endian.h>
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+
+namespace {
+
+constexpr unsigned char kTicketVersion = 1;
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool isHex(std::string_view str) {
+    for (char c : str) {
+        if (hexValue(c) < 0) return false;
+    }
+    return true;
+}
+
+bool decodeHex(std::string_view hex, unsigned char* out) {
+    if (hex.size() % 2 != 0) return false;
+    for (size_t i = 0; i < hex.size() / 2; i++) {
+        int hi = hexValue(hex[2 * i]);
+        int lo = hexValue(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0) return false;
+        out[i] = static_cast<unsigned char>(hi << 4 | lo);
+    }
+    return true;
+}
+
+void encodeHex(const unsigned char* data, size_t len, char* out) {
+    static const char kHex[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; i++) {
+        out[2 * i] = kHex[data[i] >> 4];
+        out[2 * i + 1] = kHex[data[i] & 0x0F];
+    }
+}
+
+}
+
+bool AuthEngine::init(uint32_t ticket_lifetime) {
+    ticket_lifetime_ = ticket_lifetime;
+
+    // Ключ HMAC длиной в блок SHA-256; внутренний и внешний контексты
+    // после обработки ключа вычисляются один раз и далее только копируются
+    unsigned char key[SHA256_CBLOCK];
+    if (RAND_bytes(key, sizeof(key)) != 1) return false;
+    unsigned char pad[SHA256_CBLOCK];
+    for (size_t i = 0; i < sizeof(key); i++) pad[i] = key[i] ^ 0x36;
+    SHA256_Init(&hmac_inner_);
+    SHA256_Update(&hmac_inner_, pad, sizeof(pad));
+    for (size_t i = 0; i < sizeof(key); i++) pad[i] = key[i] ^ 0x5c;
+    SHA256_Init(&hmac_outer_);
+    SHA256_Update(&hmac_outer_, pad, sizeof(pad));
+    OPENSSL_cleanse(key, sizeof(key));
+    OPENSSL_cleanse(pad, sizeof(pad));
+    return true;
+}
+
+void AuthEngine::mac(const unsigned char* data, size_t len, unsigned char* out) const {
+    unsigned char inner[SHA256_DIGEST_LENGTH];
+    SHA256_CTX ctx = hmac_inner_;
+    SHA256_Update(&ctx, data, len);
+    SHA256_Final(inner, &ctx);
+    ctx = hmac_outer_;
+    SHA256_Update(&ctx, inner, sizeof(inner));
+    SHA256_Final(out, &ctx);
+}
+
+bool AuthEngine::parse(std::string_view message, Request& request) {
+    request = Request();
+
+    // Суффиксы флагов — не hex, поэтому отделяются от хеша и билета однозначно
+    for (; !message.empty(); message.remove_suffix(1)) {
+        if (message.back() == 'T' && !request.want_ticket) {
+            request.want_ticket = true;
+        } else if (message.back() == 'Z' && !request.compact) {
+            request.compact = true;
+        } else if (message.back() == 'M' && !request.shared_ring) {
+            request.shared_ring = true;
+        } else {
+            break;
+        }
+    }
+
+    if (message.size() >= 2 && message[0] == '#' && message[1] == 'R') {
+        request.resume = true;
+        request.ticket = message.substr(2);
+        return !request.ticket.empty() && request.ticket.size() <= kMaxTicketHex && isHex(request.ticket);
+    }
+    if (message.size() < kMinMessage) return false;
+
+    size_t login_len = message.size() - kSaltLen - kHashHexLen;
+    if (login_len > kMaxLogin) return false;
+    request.login = message.substr(0, login_len);
+    request.salt = message.substr(login_len, kSaltLen);
+    if (!isHex(request.salt)) return false;
+    return decodeHex(message.substr(login_len + kSaltLen), request.digest);
+}
+
+AuthEngine::Result AuthEngine::verify(const Request& request, char* login, size_t& login_len) const {
+    if (!request.resume) {
+        bool found = false;
+        bool ok = db_.verifyDigest(request.login, request.salt, request.digest, found);
+        if (!found) return Result::UnknownLogin;
+        if (!ok) return Result::BadHash;
+        memcpy(login, request.login.data(), request.login.size());
+        login_len = request.login.size();
+        return Result::Ok;
+    }
+
+    // Билет: версия(1) срок(8, LE) длина логина(1) логин MAC(32)
+    unsigned char ticket[kMaxTicketHex / 2];
+    size_t size = request.ticket.size() / 2;
+    if (ticket_lifetime_ == 0 || size < 10 + SHA256_DIGEST_LENGTH || !decodeHex(request.ticket, ticket)) {
+        return Result::BadTicket;
+    }
+    size_t body = size - SHA256_DIGEST_LENGTH;
+    unsigned char expected[SHA256_DIGEST_LENGTH];
+    mac(ticket, body, expected);
+    if (CRYPTO_memcmp(expected, ticket + body, SHA256_DIGEST_LENGTH) != 0 ||
+        ticket[0] != kTicketVersion || ticket[9] != body - 10) {
+        return Result::BadTicket;
+    }
+
+    uint64_t expiry;
+    memcpy(&expiry, ticket + 1, sizeof(expiry));
+    if (le64toh(expiry) < static_cast<uint64_t>(std::time(nullptr))) return Result::ExpiredTicket;
+
+    std::string_view ticket_login(reinterpret_cast<const char*>(ticket + 10), body - 10);
+    if (!db_.contains(ticket_login)) return Result::UnknownLogin;
+    memcpy(login, ticket_login.data(), ticket_login.size());
+    login_len = ticket_login.size();
+    return Result::Ok;
+}
+
+size_t AuthEngine::issueTicket(std::string_view login, char* out) const {
+    if (ticket_lifetime_ == 0 || login.size() > kMaxLogin) return 0;
+
+    unsigned char ticket[kMaxTicketHex / 2];
+    uint64_t expiry = htole64(static_cast<uint64_t>(std::time(nullptr)) + ticket_lifetime_);
+    ticket[0] = kTicketVersion;
+    memcpy(ticket + 1, &expiry, sizeof(expiry));
+    ticket[9] = static_cast<unsigned char>(login.size());
+    memcpy(ticket + 10, login.data(), login.size());
+    size_t body = 10 + login.size();
+    mac(ticket, body, ticket + body);
+    size_t size = body + SHA256_DIGEST_LENGTH;
+    encodeHex(ticket, size, out);
+    return 2 * size;
+}
+
+const char* AuthEngine::describe(Result result) {
+    switch (result) {
+    case Result::Ok:            return "успех";
+    case Result::UnknownLogin:  return "клиент не найден";
+    case Result::BadHash:       return "неверный хеш";
+    case Result::BadTicket:     return "недействительный билет";
+    case Result::ExpiredTicket: return "срок действия билета истёк";
+    }
+    return "";
+}
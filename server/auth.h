@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+// Низкоуровневый SHA256_Init/Update/Final не выделяет память и позволяет
+// копировать готовое состояние хеша; в OpenSSL 3 он помечен устаревшим
+#define OPENSSL_SUPPRESS_DEPRECATED
+#include <openssl/sha.h>
+
+class ClientDB;
+
+// Проверка сообщений аутентификации.
+//
+// Полная аутентификация:   <логин><соль: 16 hex><SHA256(соль + пароль): 64 hex>[T][Z][M]
+// Возобновление по билету: #R<билет: hex>[T][Z][M]
+//
+// Логин — всё, что предшествует соли (логины в базе не начинаются с '#').
+// Сообщение может завершаться '\n'. Суффиксы идут в любом порядке:
+// 'T' запрашивает билет возобновления — сервер отвечает "OK<билет>\n"
+// вместо "OK"; 'Z' включает компактное кодирование векторов (protocol.h);
+// 'M' запрашивает кольцо в разделяемой памяти (shm_ring.h).
+//
+// Хеш из сообщения декодируется в 32 байта и сравнивается с ожидаемым
+// за постоянное время. Билет — это версия, срок действия, логин и
+// HMAC-SHA256 от них на ключе, создаваемом при запуске сервера; состояние
+// HMAC после обработки ключа вычисляется один раз.
+class AuthEngine {
+public:
+    static constexpr size_t kSaltLen = 16;
+    static constexpr size_t kHashHexLen = 2 * SHA256_DIGEST_LENGTH;
+    static constexpr size_t kMaxLogin = 255;
+    static constexpr size_t kMinMessage = 1 + kSaltLen + kHashHexLen;
+    // Наибольшая длина билета в hex: версия, срок, длина логина, логин, MAC
+    static constexpr size_t kMaxTicketHex = 2 * (1 + 8 + 1 + kMaxLogin + SHA256_DIGEST_LENGTH);
+
+    enum class Result { Ok, UnknownLogin, BadHash, BadTicket, ExpiredTicket };
+
+    struct Request {
+        bool resume = false;
+        bool want_ticket = false;
+        bool compact = false;
+        bool shared_ring = false;
+        std::string_view login;
+        std::string_view salt;
+        unsigned char digest[SHA256_DIGEST_LENGTH];
+        std::string_view ticket;
+    };
+
+    explicit AuthEngine(const ClientDB& db) : db_(db) {}
+
+    // Создаёт ключ билетов; lifetime == 0 отключает выдачу билетов
+    bool init(uint32_t ticket_lifetime);
+
+    static bool parse(std::string_view message, Request& request);
+    // При успехе копирует в login (не меньше kMaxLogin байт) логин клиента;
+    // для возобновления логин берётся из билета
+    Result verify(const Request& request, char* login, size_t& login_len) const;
+    // Пишет hex-билет для логина в out (не меньше kMaxTicketHex байт);
+    // возвращает длину или 0, если билеты отключены
+    size_t issueTicket(std::string_view login, char* out) const;
+
+    static const char* describe(Result result);
+
+private:
+    const ClientDB& db_;
+    uint32_t ticket_lifetime_ = 0;
+    SHA256_CTX hmac_inner_;
+    SHA256_CTX hmac_outer_;
+
+    void mac(const unsigned char* data, size_t len, unsigned char* out) const;
+};
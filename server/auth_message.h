@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#define OPENSSL_SUPPRESS_DEPRECATED
+#include <openssl/sha.h>
+
+// Сборка сообщения аутентификации на стороне клиента (клиентская библиотека,
+// генератор нагрузки, бенчмарки и тесты): логин, соль из 16 hex-символов и
+// SHA256(соль + пароль) в hex. Суффиксы режимов сессии ('Z', 'M') и '\n'
+// дописывает вызывающий.
+namespace proto {
+
+constexpr size_t kAuthSaltSize = 16;
+
+// Соль из 16 hex-символов по 64 случайным битам
+inline std::string authSalt(uint64_t random) {
+    static const char kHex[] = "0123456789abcdef";
+    std::string salt(kAuthSaltSize, '0');
+    for (size_t i = 0; i < salt.size(); i++) salt[i] = kHex[(random >> (4 * i)) & 0xF];
+    return salt;
+}
+
+inline std::string authMessage(std::string_view login, std::string_view password, std::string_view salt) {
+    static const char kHex[] = "0123456789abcdef";
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, salt.data(), salt.size());
+    SHA256_Update(&ctx, password.data(), password.size());
+    SHA256_Final(hash, &ctx);
+
+    std::string message;
+    message.reserve(login.size() + salt.size() + 2 * sizeof(hash) + 3);
+    message.append(login).append(salt);
+    for (unsigned char b : hash) {
+        message += kHex[b >> 4];
+        message += kHex[b & 0xF];
+    }
+    return message;
+}
+
+}
@@ -0,0 +1,482 @@
+// Генератор нагрузки по протоколу сервера: каждый запрос — соединение,
+// аутентификация SHA256(соль + пароль), один пакет векторов и чтение
+// результатов. Соединения работают в отдельных потоках.
+//
+// С -k N соединение постоянное: одна аутентификация, затем пакеты с флагом
+// keep-alive, и запрос — это один пакет. В замкнутом цикле в полёте
+// держится N пакетов (конвейер), в открытом — по одному.
+//
+//   замкнутый цикл (-r 0): следующий запрос сразу после ответа;
+//   открытый цикл  (-r N): запросы по расписанию N в секунду на все
+//                          соединения; задержка считается от момента по
+//                          расписанию, поэтому отставание не скрывается.
+//
+// С -e compact данные векторов отправляются в компактном кодировании
+// (суффикс 'Z' аутентификации); -g walk заменяет равномерно распределённые
+// элементы случайным блужданием, для которого работает разностное кодирование.
+//
+// С -U <path> соединения идут через Unix-сокет сервера, а -m shm дополнительно
+// запрашивает кольцо в разделяемой памяти (суффикс 'M'): пакеты пишутся в
+// кольцо, ответы по-прежнему читаются из сокета.
+//
+// Сборка и запуск: make load_gen && ./bench/load_gen -c 8 -n 1000 -b 10 -d 5
+
+#include "../auth_message.h"
+#include "../codec.h"
+#include "../protocol.h"
+#include "../shm_ring.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <endian.h>
+#include <iostream>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string address = "127.0.0.1";
+    int port = 33333;
+    std::string login = "user";
+    std::string password = "P@ssW0rd";
+    size_t connections = 4;
+    uint32_t vector_size = 1000;
+    uint32_t batch_size = 10;
+    double duration = 5;
+    double rate = 0;                // запросов в секунду, 0 — замкнутый цикл
+    uint32_t ops = 0;               // маска proto::kOp*, 0 — обычный ответ
+    size_t pipeline = 0;            // пакетов в полёте на сессию, 0 — соединение на запрос
+    bool compact = false;           // компактное кодирование данных векторов
+    bool walk = false;              // элементы — случайное блуждание
+    std::string unix_path;          // Unix-сокет вместо TCP
+    bool shm = false;               // пакеты через кольцо в разделяемой памяти
+};
+
+// Адрес сервера: TCP или Unix-сокет
+struct Endpoint {
+    sockaddr_storage addr;
+    socklen_t len = 0;
+};
+
+// Сессия: сокет и, если сервер его передал, кольцо для данных пакетов
+struct Session {
+    int sock = -1;
+    std::unique_ptr<ShmRing> ring;
+};
+
+struct WorkerResult {
+    std::vector<uint64_t> latencies_ns;
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    uint64_t bytes_sent = 0;
+};
+
+void printHelp() {
+    std::cout << "Использование: ./bench/load_gen [параметры]\n"
+              << "  -a <addr>   Адрес сервера (127.0.0.1)\n"
+              << "  -p <port>   Порт (33333)\n"
+              << "  -u <login>  Логин (user)\n"
+              << "  -w <pass>   Пароль (P@ssW0rd)\n"
+              << "  -c <n>      Одновременных соединений (4)\n"
+              << "  -n <size>   Элементов в векторе (1000)\n"
+              << "  -b <n>      Векторов в пакете (10)\n"
+              << "  -d <sec>    Длительность (5)\n"
+              << "  -r <rps>    Открытый цикл: запросов в секунду (0 — замкнутый цикл)\n"
+              << "  -o <mask>   Маска операций статистик (0 — только среднее)\n"
+              << "  -k <n>      Постоянные сессии, n пакетов в полёте (0 — соединение на запрос)\n"
+              << "  -e <enc>    Кодирование данных: raw или compact (raw)\n"
+              << "  -g <data>   Данные: uniform (±10^6) или walk — случайное блуждание (uniform)\n"
+              << "  -U <path>   Подключаться через Unix-сокет вместо TCP\n"
+              << "  -m <mode>   Передача пакетов через Unix-сокет: socket или shm — кольцо (socket)\n";
+}
+
+bool parseArgs(int argc, char* argv[], Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0) {
+            printHelp();
+            return false;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Ошибка: нет значения для " << argv[i] << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+        switch (argv[i - 1][1]) {
+        case 'a': opt.address = value; break;
+        case 'p': opt.port = std::atoi(value); break;
+        case 'u': opt.login = value; break;
+        case 'w': opt.password = value; break;
+        case 'c': opt.connections = std::max(1ul, std::strtoul(value, nullptr, 10)); break;
+        case 'n': opt.vector_size = static_cast<uint32_t>(std::strtoul(value, nullptr, 10)); break;
+        case 'b': opt.batch_size = static_cast<uint32_t>(std::strtoul(value, nullptr, 10)); break;
+        case 'd': opt.duration = std::atof(value); break;
+        case 'r': opt.rate = std::atof(value); break;
+        case 'o': opt.ops = static_cast<uint32_t>(std::strtoul(value, nullptr, 0)); break;
+        case 'k': opt.pipeline = std::strtoul(value, nullptr, 10); break;
+        case 'e':
+            if (strcmp(value, "raw") != 0 && strcmp(value, "compact") != 0) {
+                std::cerr << "Ошибка: неизвестное кодирование " << value << std::endl;
+                return false;
+            }
+            opt.compact = strcmp(value, "compact") == 0;
+            break;
+        case 'g':
+            if (strcmp(value, "uniform") != 0 && strcmp(value, "walk") != 0) {
+                std::cerr << "Ошибка: неизвестный вид данных " << value << std::endl;
+                return false;
+            }
+            opt.walk = strcmp(value, "walk") == 0;
+            break;
+        case 'U': opt.unix_path = value; break;
+        case 'm':
+            if (strcmp(value, "socket") != 0 && strcmp(value, "shm") != 0) {
+                std::cerr << "Ошибка: неизвестный способ передачи " << value << std::endl;
+                return false;
+            }
+            opt.shm = strcmp(value, "shm") == 0;
+            break;
+        default:
+            std::cerr << "Ошибка: неизвестный параметр " << argv[i - 1] << std::endl;
+            return false;
+        }
+    }
+    if (opt.batch_size == 0 || opt.batch_size > proto::kCountMask) {
+        std::cerr << "Ошибка: неверное число векторов в пакете" << std::endl;
+        return false;
+    }
+    if (opt.shm && opt.unix_path.empty()) {
+        std::cerr << "Ошибка: кольцо передаётся только через Unix-сокет (-U)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string authMessage(const Options& opt, std::mt19937_64& rng) {
+    std::string message = proto::authMessage(opt.login, opt.password, proto::authSalt(rng()));
+    if (opt.compact) message += 'Z';
+    if (opt.shm) message += 'M';
+    message += '\n';
+    return message;
+}
+
+// Пакет векторов собирается один раз и отправляется каждым запросом
+std::string buildBatch(const Options& opt) {
+    std::string batch;
+    auto put32 = [&batch](uint32_t v) {
+        v = htole32(v);
+        batch.append(reinterpret_cast<const char*>(&v), sizeof(v));
+    };
+    put32(opt.batch_size | (opt.ops ? proto::kFlagOps : 0) | (opt.pipeline ? proto::kFlagKeepAlive : 0));
+    if (opt.ops) put32(opt.ops);
+    std::mt19937_64 rng(42);
+    std::vector<int64_t> values(opt.vector_size);
+    for (uint32_t i = 0; i < opt.batch_size; i++) {
+        put32(opt.vector_size);
+        int64_t x = 1000000000;
+        for (int64_t& v : values) {
+            int64_t r = static_cast<int64_t>(rng() % 2000001) - 1000000;
+            v = opt.walk ? (x += r / 10000) : r;
+        }
+        if (opt.compact) {
+            codec::encode(values.data(), values.size(), batch);
+            continue;
+        }
+        for (int64_t v : values) {
+            uint64_t le = htole64(static_cast<uint64_t>(v));
+            batch.append(reinterpret_cast<const char*>(&le), sizeof(le));
+        }
+    }
+    return batch;
+}
+
+bool sendAll(int sock, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(sock, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool recvAll(int sock, char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = recv(sock, data, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Первый байт ответа на аутентификацию; вместе с ним может прийти
+// дескриптор кольца
+bool recvStatus(Session& session, char* status) {
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    iovec iov = {status, 1};
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n;
+    do {
+        n = recvmsg(session.sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return false;
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        int fd;
+        memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+        session.ring = std::make_unique<ShmRing>();
+        if (!session.ring->attach(fd)) return false;
+        session.ring->closeFd();
+    }
+    return true;
+}
+
+// Соединение и аутентификация; false при ошибке
+bool openSession(const Endpoint& endpoint, const std::string& auth, Session& session) {
+    session.ring.reset();
+    session.sock = socket(endpoint.addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (session.sock < 0) return false;
+    if (endpoint.addr.ss_family == AF_INET) {
+        int nodelay = 1;
+        setsockopt(session.sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+
+    bool ok = connect(session.sock, reinterpret_cast<const sockaddr*>(&endpoint.addr), endpoint.len) == 0;
+    char status[2];
+    ok = ok && sendAll(session.sock, auth.data(), auth.size()) && recvStatus(session, status) &&
+         recvAll(session.sock, status + 1, 1) && memcmp(status, "OK", 2) == 0;
+    if (!ok) {
+        close(session.sock);
+        session.sock = -1;
+        return false;
+    }
+    return true;
+}
+
+// Данные сессии: в кольцо, если оно есть, иначе в сокет. Сервер, уснувший
+// над пустым кольцом, будит байт в сокете
+bool sendData(Session& session, const char* data, size_t len) {
+    if (!session.ring) return sendAll(session.sock, data, len);
+    ShmRing& ring = *session.ring;
+    while (len > 0) {
+        if (!ring.waitForSpace(1, 5000)) return false;
+        size_t n = std::min(len, ring.writable());
+        memcpy(ring.writePtr(), data, n);
+        data += n;
+        len -= n;
+        char doorbell = 0;
+        if (ring.commit(n) && !sendAll(session.sock, &doorbell, 1)) return false;
+    }
+    return true;
+}
+
+void closeSession(Session& session) {
+    close(session.sock);
+    session.sock = -1;
+    session.ring.reset();
+}
+
+// Один запрос: соединение, аутентификация, пакет, результаты
+bool runRequest(const Endpoint& endpoint, const std::string& auth, const std::string& batch, size_t reply_size) {
+    Session session;
+    if (!openSession(endpoint, auth, session)) return false;
+    std::vector<char> reply(reply_size);
+    bool ok = sendData(session, batch.data(), batch.size()) && recvAll(session.sock, reply.data(), reply.size());
+    closeSession(session);
+    return ok;
+}
+
+// Постоянная сессия: пакеты отправляются, не дожидаясь предыдущих ответов,
+// пока в полёте меньше opt.pipeline; ответы приходят в порядке пакетов
+void runSession(const Options& opt, const Endpoint& endpoint, const std::string& batch, size_t reply_size,
+                std::mt19937_64& rng, Clock::duration period, Clock::time_point next, Clock::time_point stop,
+                WorkerResult& result) {
+    std::vector<char> reply(reply_size);
+    std::deque<Clock::time_point> inflight;
+    size_t depth = opt.rate > 0 ? 1 : opt.pipeline;
+    Session session;
+    for (;;) {
+        if (session.sock < 0) {
+            if (Clock::now() >= stop) break;
+            std::string auth = authMessage(opt, rng);
+            if (!openSession(endpoint, auth, session)) {
+                result.errors++;
+                continue;
+            }
+            result.bytes_sent += auth.size();
+        }
+
+        bool ok = true;
+        while (ok && inflight.size() < depth) {
+            Clock::time_point issued;
+            if (opt.rate > 0) {
+                if (next >= stop) break;
+                std::this_thread::sleep_until(next);
+                issued = next;
+                next += period;
+            } else {
+                issued = Clock::now();
+                if (issued >= stop) break;
+            }
+            ok = sendData(session, batch.data(), batch.size());
+            inflight.push_back(issued);
+        }
+        if (ok && inflight.empty()) break;
+
+        ok = ok && recvAll(session.sock, reply.data(), reply.size());
+        if (!ok) {
+            result.errors += inflight.size();
+            inflight.clear();
+            closeSession(session);
+            continue;
+        }
+        result.latencies_ns.push_back(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - inflight.front()).count()));
+        inflight.pop_front();
+        result.requests++;
+        result.bytes_sent += batch.size();
+    }
+    if (session.sock >= 0) {
+        // Слово количества 0 — конец сессии
+        uint32_t end = 0;
+        sendData(session, reinterpret_cast<const char*>(&end), sizeof(end));
+        closeSession(session);
+    }
+}
+
+void worker(const Options& opt, const Endpoint& endpoint, const std::string& batch, size_t index,
+            Clock::time_point start, Clock::time_point stop, WorkerResult& result) {
+    std::mt19937_64 rng(index + 1);
+    size_t reply_size = opt.batch_size * (opt.ops ? proto::recordSize(opt.ops) : sizeof(int64_t));
+
+    // В открытом цикле соединения сдвинуты по фазе на равные доли периода
+    Clock::duration period{};
+    Clock::time_point next = start;
+    if (opt.rate > 0) {
+        period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(opt.connections / opt.rate));
+        next += period * index / opt.connections;
+    }
+    if (opt.pipeline > 0) {
+        runSession(opt, endpoint, batch, reply_size, rng, period, next, stop, result);
+        return;
+    }
+
+    for (;;) {
+        Clock::time_point issued;
+        if (opt.rate > 0) {
+            if (next >= stop) break;
+            std::this_thread::sleep_until(next);
+            issued = next;
+            next += period;
+        } else {
+            issued = Clock::now();
+            if (issued >= stop) break;
+        }
+        std::string auth = authMessage(opt, rng);
+        if (runRequest(endpoint, auth, batch, reply_size)) {
+            result.latencies_ns.push_back(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - issued).count()));
+            result.requests++;
+            result.bytes_sent += auth.size() + batch.size();
+        } else {
+            result.errors++;
+        }
+    }
+}
+
+double percentileUs(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t i = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return static_cast<double>(sorted[i]) / 1000.0;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) return 1;
+
+    Endpoint endpoint;
+    memset(&endpoint.addr, 0, sizeof(endpoint.addr));
+    if (!opt.unix_path.empty()) {
+        auto& addr = reinterpret_cast<sockaddr_un&>(endpoint.addr);
+        if (opt.unix_path.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "Ошибка: слишком длинный путь Unix-сокета" << std::endl;
+            return 1;
+        }
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, opt.unix_path.c_str(), opt.unix_path.size() + 1);
+        endpoint.len = sizeof(addr);
+    } else {
+        auto& addr = reinterpret_cast<sockaddr_in&>(endpoint.addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(opt.port));
+        if (inet_pton(AF_INET, opt.address.c_str(), &addr.sin_addr) <= 0) {
+            std::cerr << "Ошибка преобразования адреса: " << opt.address << std::endl;
+            return 1;
+        }
+        endpoint.len = sizeof(addr);
+    }
+
+    std::string batch = buildBatch(opt);
+    std::vector<WorkerResult> results(opt.connections);
+    std::vector<std::thread> threads;
+    Clock::time_point start = Clock::now() + std::chrono::milliseconds(10);
+    Clock::time_point stop = start + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(opt.duration));
+    for (size_t i = 0; i < opt.connections; i++) {
+        threads.emplace_back(worker, std::cref(opt), std::cref(endpoint), std::cref(batch), i, start, stop,
+                             std::ref(results[i]));
+    }
+    for (auto& t : threads) t.join();
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    WorkerResult total;
+    for (const WorkerResult& r : results) {
+        total.latencies_ns.insert(total.latencies_ns.end(), r.latencies_ns.begin(), r.latencies_ns.end());
+        total.requests += r.requests;
+        total.errors += r.errors;
+        total.bytes_sent += r.bytes_sent;
+    }
+    std::sort(total.latencies_ns.begin(), total.latencies_ns.end());
+
+    double rps = static_cast<double>(total.requests) / elapsed;
+    printf("Режим: %s%s%s%s, соединений: %zu, векторов в пакете: %u, элементов: %u\n",
+           opt.rate > 0 ? "открытый цикл" : "замкнутый цикл", opt.pipeline ? ", постоянные сессии" : "",
+           opt.compact ? ", компактное кодирование" : "",
+           opt.shm ? ", кольцо в разделяемой памяти" : !opt.unix_path.empty() ? ", Unix-сокет" : "", opt.connections, opt.batch_size, opt.vector_size);
+    printf("Запросов: %llu, ошибок: %llu, время: %.2f с\n", static_cast<unsigned long long>(total.requests),
+           static_cast<unsigned long long>(total.errors), elapsed);
+    printf("Пропускная способность: %.0f запросов/с, %.0f векторов/с, %.1f МБ/с\n", rps,
+           rps * opt.batch_size, static_cast<double>(total.bytes_sent) / elapsed / 1e6);
+    printf("Задержка, мкс: p50 %.1f  p99 %.1f  p999 %.1f  max %.1f\n", percentileUs(total.latencies_ns, 0.5),
+           percentileUs(total.latencies_ns, 0.99), percentileUs(total.latencies_ns, 0.999),
+           percentileUs(total.latencies_ns, 1.0));
+    return total.errors == 0 ? 0 : 2;
+}
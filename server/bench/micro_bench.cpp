@@ -0,0 +1,255 @@
+// Микробенчмарки горячих путей сервера без сети:
+//
+//   свёртка   — sumWrapped, accumulate и accumulateStats для каждой
+//               реализации, поддерживаемой процессором;
+//   компактное кодирование — степень сжатия и распаковка блоков вместе
+//               со свёрткой, как на сервере;
+//   параллельная свёртка — большой вектор блоками в пуле из 1, 2, 4...
+//               потоков (с копированием в блоки, как в сессии);
+//   аутентификация — разбор сообщения и проверка SHA256(соль + пароль);
+//   ClientDB  — поиск существующих и отсутствующих логинов в базе.
+//
+// Сборка и запуск: make micro_bench && ./bench/micro_bench [элементов] [клиентов]
+
+#include "../auth.h"
+#include "../auth_message.h"
+#include "../client_db.h"
+#include "../codec.h"
+#include "../parallel_reduce.h"
+#include "../reduce.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+volatile int64_t sink;
+
+// Повторяет f не меньше 200 мс и возвращает нс на вызов
+template <typename F>
+double nsPerCall(F f) {
+    size_t reps = 1;
+    for (;;) {
+        auto start = Clock::now();
+        for (size_t r = 0; r < reps; r++) f(r);
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        if (ns > 2e8) return ns / static_cast<double>(reps);
+        reps *= 2;
+    }
+}
+
+void benchReduce(size_t size) {
+    std::vector<int64_t> data(size);
+    std::mt19937_64 rng(42);
+    for (auto& v : data) v = static_cast<int64_t>(rng() % 2000001) - 1000000;
+    double bytes = static_cast<double>(size * sizeof(int64_t));
+
+    printf("Свёртка вектора из %zu элементов, ГБ/с:\n", size);
+    printf("  %-8s %10s %10s %10s %12s\n", "", "wrap", "wide", "min/max", "+дисперсия");
+    for (const char* name : {"scalar", "avx2", "avx512"}) {
+        if (!reduce::forceImplementation(name)) continue;
+        double wrap = nsPerCall([&](size_t) { sink = reduce::sumWrapped(data.data(), size); });
+        double wide = nsPerCall([&](size_t) {
+            reduce::Sum sum;
+            reduce::accumulate(sum, data.data(), size);
+            sink = static_cast<int64_t>(sum.total);
+        });
+        double stats = nsPerCall([&](size_t) {
+            reduce::Stats s;
+            reduce::accumulateStats(s, data.data(), size, false);
+            sink = s.min + s.max;
+        });
+        double variance = nsPerCall([&](size_t) {
+            reduce::Stats s;
+            reduce::accumulateStats(s, data.data(), size, true);
+            sink = static_cast<int64_t>(s.m2);
+        });
+        printf("  %-8s %10.2f %10.2f %10.2f %12.2f\n", name, bytes / wrap, bytes / wide, bytes / stats,
+               bytes / variance);
+    }
+}
+
+// Распаковка и свёртка блок за блоком, как в сессии сервера
+int64_t decodeAndSum(const std::string& encoded, size_t size) {
+    int64_t block[codec::kBlockSize];
+    uint64_t prev = 0;
+    size_t pos = 0;
+    int64_t sum = 0;
+    for (size_t done = 0; done < size; done += codec::kBlockSize) {
+        size_t n = std::min(codec::kBlockSize, size - done);
+        size_t used = 0;
+        if (codec::decodeBlock(encoded.data() + pos, encoded.size() - pos, n, prev, block, used) != codec::Status::Ok) {
+            return 0;
+        }
+        sum += reduce::sumWrapped(block, n);
+        pos += used;
+    }
+    return sum;
+}
+
+void benchCodec(size_t size) {
+    std::mt19937_64 rng(42);
+    std::vector<int64_t> uniform(size), walk(size);
+    int64_t x = 1000000000;
+    for (size_t i = 0; i < size; i++) {
+        uniform[i] = static_cast<int64_t>(rng() % 2000001) - 1000000;
+        x += static_cast<int64_t>(rng() % 201) - 100;
+        walk[i] = x;
+    }
+    double bytes = static_cast<double>(size * sizeof(int64_t));
+
+    printf("Компактное кодирование, %zu элементов, распаковка со свёрткой (ГБ/с несжатых данных):\n", size);
+    printf("  %-8s %8s %10s %10s\n", "", "сжатие", "scalar", "avx2");
+    const std::pair<const char*, const std::vector<int64_t>*> inputs[] = {{"uniform", &uniform}, {"walk", &walk}};
+    for (const auto& input : inputs) {
+        std::string encoded;
+        codec::encode(input.second->data(), size, encoded);
+        double ratio = bytes / static_cast<double>(encoded.size());
+        double rates[2] = {0, 0};
+        const char* impls[2] = {"scalar", "avx2"};
+        for (int k = 0; k < 2; k++) {
+            if (!codec::forceImplementation(impls[k])) continue;
+            rates[k] = bytes / nsPerCall([&](size_t) { sink = decodeAndSum(encoded, size); });
+        }
+        printf("  %-8s %7.2fx %10.2f %10.2f\n", input.first, ratio, rates[0], rates[1]);
+    }
+}
+
+void benchParallel(size_t size) {
+    // Вектор заведомо больше кэша, иначе сравнение нечестно к пулу
+    size = std::max<size_t>(size, 16u << 20);
+    std::vector<int64_t> data(size);
+    std::mt19937_64 rng(42);
+    for (auto& v : data) v = static_cast<int64_t>(rng() % 2000001) - 1000000;
+    double bytes = static_cast<double>(size * sizeof(int64_t));
+    const char* raw = reinterpret_cast<const char*>(data.data());
+
+    printf("Параллельная свёртка вектора из %zu элементов со статистиками и дисперсией, ГБ/с:\n", size);
+    double serial = nsPerCall([&](size_t) {
+        reduce::Stats s;
+        reduce::accumulateStats(s, data.data(), size, true);
+        sink = static_cast<int64_t>(s.m2);
+    });
+    printf("  %-10s %8.2f\n", "подряд", bytes / serial);
+    size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        WorkerPool pool(threads);
+        ParallelReducer reducer(pool);
+        double ns = nsPerCall([&](size_t) {
+            reducer.begin(ParallelReducer::Kind::StatsVariance, size);
+            // Порции по 64 КиБ — как из входного буфера сессии
+            for (size_t done = 0; done < size;) {
+                size_t n = std::min<size_t>(size - done, 8192);
+                for (size_t copied = 0; copied < n;) {
+                    size_t k = std::min(n - copied, reducer.room());
+                    memcpy(reducer.fillPtr(), raw + (done + copied) * sizeof(int64_t), k * sizeof(int64_t));
+                    reducer.commit(k);
+                    copied += k;
+                }
+                done += n;
+            }
+            int64_t wrapped;
+            reduce::Sum sum;
+            reduce::Stats stats;
+            reducer.finish(wrapped, sum, stats);
+            sink = static_cast<int64_t>(stats.m2);
+        });
+        printf("  %-4zu потоков %8.2f\n", threads, bytes / ns);
+    }
+}
+
+void benchClients(size_t clients) {
+    // Временная база "userN passN"
+    char path[] = "/tmp/micro_bench_db_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return;
+    }
+    close(fd);
+    {
+        std::ofstream db(path);
+        for (size_t i = 0; i < clients; i++) db << "user" << i << " pass" << i << "\n";
+    }
+
+    ClientDB db;
+    auto start = Clock::now();
+    bool loaded = db.load(path);
+    double load_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::string snapshot = std::string(path) + ".kdb";
+    double snapshot_ms = 0;
+    if (loaded && db.writeSnapshot(snapshot)) {
+        ClientDB mapped;
+        start = Clock::now();
+        mapped.load(snapshot);
+        snapshot_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+    unlink(snapshot.c_str());
+    unlink(path);
+    if (!loaded) return;
+
+    std::vector<std::string> hits, misses;
+    std::mt19937_64 rng(7);
+    for (size_t i = 0; i < 4096; i++) {
+        hits.push_back("user" + std::to_string(rng() % clients));
+        misses.push_back("nobody" + std::to_string(rng() % clients));
+    }
+    double hit = nsPerCall([&](size_t r) { sink = db.contains(hits[r & 4095]); });
+    double miss = nsPerCall([&](size_t r) { sink = db.contains(misses[r & 4095]); });
+
+    printf("ClientDB, клиентов: %zu\n", clients);
+    printf("  загрузка текста: %.1f мс, снимка KDB1: %.3f мс\n", load_ms, snapshot_ms);
+    printf("  поиск: найден %.1f нс, не найден %.1f нс\n", hit, miss);
+
+    // Полная проверка сообщения аутентификации и возобновление по билету
+    AuthEngine auth(db);
+    if (!auth.init(300)) return;
+    std::vector<std::string> messages;
+    for (size_t i = 0; i < 256; i++) {
+        size_t id = rng() % clients;
+        messages.push_back(
+            proto::authMessage("user" + std::to_string(id), "pass" + std::to_string(id), proto::authSalt(i)));
+    }
+    char login[AuthEngine::kMaxLogin];
+    size_t login_len = 0;
+    double full = nsPerCall([&](size_t r) {
+        AuthEngine::Request request;
+        AuthEngine::parse(messages[r & 255], request);
+        sink = static_cast<int64_t>(auth.verify(request, login, login_len));
+    });
+    char ticket[AuthEngine::kMaxTicketHex];
+    std::string resume = "#R" + std::string(ticket, auth.issueTicket("user0", ticket));
+    double resumed = nsPerCall([&](size_t) {
+        AuthEngine::Request request;
+        AuthEngine::parse(resume, request);
+        sink = static_cast<int64_t>(auth.verify(request, login, login_len));
+    });
+    printf("Аутентификация: по хешу %.0f нс, по билету %.0f нс\n", full, resumed);
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t size = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    size_t clients = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+    if (size == 0 || clients == 0) {
+        fprintf(stderr, "Использование: ./bench/micro_bench [элементов] [клиентов]\n");
+        return 1;
+    }
+    benchReduce(size);
+    benchCodec(size);
+    benchParallel(size);
+    benchClients(clients);
+    return 0;
+}
@@ -0,0 +1,612 @@
+// Воспроизведение трассы сессий, записанной сервером с -o, против любой
+// сборки сервера. Каждая сессия трассы проигрывается в отдельном
+// соединении: байты клиента отправляются теми же порциями, что и при
+// записи, — с исходными интервалами (-x 1), ускоренно (-x N) или без пауз
+// (-x 0), — а ответ сервера сравнивается с записанным побайтно.
+//
+// Сессии, возобновлённые по билету, пропускаются: ключ билетов у каждого
+// процесса свой. Выданные билеты в сравнении не участвуют, а запрос кольца
+// (суффикс 'M') снимается — данные идут через сокет.
+//
+// Дисперсия и стандартное отклонение (kOpVariance, kOpStddev) сервер
+// накапливает по порциям, пришедшим из сети, поэтому при другой нарезке
+// данных они могут разойтись в младших битах. Раскладка ответа выводится из
+// данных клиента, и эти поля сравниваются с относительной точностью 1e-9,
+// а всё остальное — побайтно.
+//
+// Задержка ответа — от отправки последней порции клиента, предшествовавшей
+// ему при записи, до получения его последнего байта; рядом выводится
+// задержка, записанная в трассе. С -o итог сохраняется в файл, а с -b
+// сравнивается с таким же файлом прогона против другой сборки.
+//
+// Сборка и запуск: make replay && ./bench/replay -f sessions.rcp -c 16 -x 0
+
+#include "../capture.h"
+#include "../codec.h"
+#include "../protocol.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string address = "127.0.0.1";
+    int port = 33333;
+    std::string unix_path;
+    std::string trace_file;
+    size_t connections = 16;        // одновременных соединений
+    double speed = 1;               // множитель темпа, 0 — без пауз
+    int timeout_ms = 10000;         // ожидание ответа сервера
+    std::string summary_file;
+    std::string baseline_file;
+};
+
+// Порция данных клиента: конец в input и время от начала сессии
+struct Chunk {
+    size_t end;
+    uint64_t time_ns;
+};
+
+// Записанный ответ: конец в expected, время и последняя порция клиента перед ним
+struct Reply {
+    size_t end;
+    uint64_t time_ns;
+    size_t last_chunk;              // SIZE_MAX — ответ до данных клиента
+};
+
+struct TraceSession {
+    uint64_t open_ns = 0;
+    std::string input;
+    std::vector<Chunk> chunks;
+    std::string expected;
+    std::vector<Reply> replies;
+    bool closed = false;
+    bool lost = false;
+    bool resumed = false;
+    bool want_ticket = false;
+    bool compact = false;
+    std::vector<size_t> doubles;    // смещения полей double в expected
+};
+
+struct Totals {
+    uint64_t replayed = 0;
+    uint64_t mismatched = 0;
+    uint64_t inexact = 0;           // совпали с точностью до младших битов double
+    uint64_t errors = 0;
+    uint64_t bytes_in = 0;
+    uint64_t replies = 0;
+    std::vector<uint64_t> latencies_ns;
+    std::vector<uint64_t> captured_ns;
+    uint64_t max_lag_ns = 0;
+};
+
+void printHelp() {
+    std::cout << "Использование: ./bench/replay -f <trace> [параметры]\n"
+              << "  -f <file>   Трасса, записанная сервером с -o (обязательный)\n"
+              << "  -a <addr>   Адрес сервера (127.0.0.1)\n"
+              << "  -p <port>   Порт (33333)\n"
+              << "  -U <path>   Подключаться через Unix-сокет вместо TCP\n"
+              << "  -c <n>      Одновременных соединений (16)\n"
+              << "  -x <speed>  Темп: 1 — как при записи, N — в N раз быстрее, 0 — без пауз (1)\n"
+              << "  -t <ms>     Ожидание ответа сервера (10000)\n"
+              << "  -o <file>   Сохранить итог прогона\n"
+              << "  -b <file>   Сравнить с итогом другого прогона\n";
+}
+
+bool parseArgs(int argc, char* argv[], Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0) {
+            printHelp();
+            return false;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Ошибка: нет значения для " << argv[i] << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+        switch (argv[i - 1][1]) {
+        case 'f': opt.trace_file = value; break;
+        case 'a': opt.address = value; break;
+        case 'p': opt.port = std::atoi(value); break;
+        case 'U': opt.unix_path = value; break;
+        case 'c': opt.connections = std::max(1ul, std::strtoul(value, nullptr, 10)); break;
+        case 'x': opt.speed = std::max(0.0, std::atof(value)); break;
+        case 't': opt.timeout_ms = std::max(1, std::atoi(value)); break;
+        case 'o': opt.summary_file = value; break;
+        case 'b': opt.baseline_file = value; break;
+        default:
+            std::cerr << "Ошибка: неизвестный параметр " << argv[i - 1] << std::endl;
+            return false;
+        }
+    }
+    if (opt.trace_file.empty()) {
+        std::cerr << "Ошибка: не задана трасса (-f)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Сообщение аутентификации: билет возобновления не воспроизводится, запрос
+// кольца снимается. Границы порций сдвигаются вместе с данными
+void rewriteAuth(TraceSession& s) {
+    if (s.input.compare(0, 2, "#R") == 0) {
+        s.resumed = true;
+        return;
+    }
+    size_t newline = s.input.find('\n');
+    if (newline == std::string::npos || newline > 1023) return;
+    size_t suffix = newline;
+    while (suffix > 0 && strchr("TZM", s.input[suffix - 1])) suffix--;
+    std::string flags = s.input.substr(suffix, newline - suffix);
+    s.want_ticket = flags.find('T') != std::string::npos;
+    s.compact = flags.find('Z') != std::string::npos;
+    flags.erase(std::remove(flags.begin(), flags.end(), 'M'), flags.end());
+    size_t removed = newline - suffix - flags.size();
+    if (removed == 0) return;
+    s.input.replace(suffix, newline - suffix, flags);
+    size_t kept_end = suffix + flags.size();
+    for (Chunk& c : s.chunks) {
+        if (c.end >= newline) c.end -= removed;
+        else if (c.end > kept_end) c.end = kept_end;
+    }
+}
+
+// Выданный билет ("OK<билет>\n") отличается от сборки к сборке и в
+// сравнении не участвует
+size_t skipTicket(const std::string& reply) {
+    if (reply.compare(0, 2, "OK") != 0) return 0;
+    size_t newline = reply.find('\n', 2);
+    return newline == std::string::npos ? 0 : newline - 1;
+}
+
+// Проходит по пакетам в данных клиента и отмечает, где в ответе лежат поля
+// double. Разбор останавливается на первом непонятном месте: дальше ответ
+// сравнивается побайтно
+void findDoubles(TraceSession& s) {
+    size_t pos = s.input.find('\n');
+    if (pos == std::string::npos || s.expected.compare(0, 2, "OK") != 0) return;
+    pos++;
+    size_t out = 2;
+    auto get32 = [&s, &pos](uint32_t& v) {
+        if (s.input.size() - pos < sizeof(v)) return false;
+        memcpy(&v, s.input.data() + pos, sizeof(v));
+        v = le32toh(v);
+        pos += sizeof(v);
+        return true;
+    };
+    uint32_t word;
+    while (get32(word)) {
+        uint32_t flags = word & proto::kFlagsMask;
+        uint32_t count = word & proto::kCountMask;
+        uint32_t ops = 0;
+        if ((flags & proto::kFlagOps) && !get32(ops)) return;
+        if (count == 0) return;
+        if (flags & proto::kFlagFramedReply) out += sizeof(uint32_t);
+        size_t record = ops ? proto::recordSize(ops) : sizeof(int64_t);
+        size_t variance = (ops & proto::kOpSum ? 16 : 0) +
+                          8 * __builtin_popcount(ops & (proto::kOpMean | proto::kOpMin | proto::kOpMax));
+        size_t stddev = variance + (ops & proto::kOpVariance ? 8 : 0);
+        for (uint32_t v = 0; v < count; v++) {
+            uint32_t size;
+            if (!get32(size)) return;
+            if (!s.compact) {
+                if ((s.input.size() - pos) / sizeof(int64_t) < size) return;
+                pos += size * sizeof(int64_t);
+            } else {
+                int64_t block[codec::kBlockSize];
+                uint64_t prev = 0;
+                for (uint32_t left = size; left > 0;) {
+                    size_t n = std::min<size_t>(left, codec::kBlockSize);
+                    size_t used;
+                    if (codec::decodeBlock(s.input.data() + pos, s.input.size() - pos, n, prev, block, used) !=
+                        codec::Status::Ok) {
+                        return;
+                    }
+                    pos += used;
+                    left -= static_cast<uint32_t>(n);
+                }
+            }
+            if (size > 0 && (ops & proto::kOpVariance)) s.doubles.push_back(out + variance);
+            if (size > 0 && (ops & proto::kOpStddev)) s.doubles.push_back(out + stddev);
+            out += record;
+        }
+        if (!(flags & proto::kFlagKeepAlive)) return;
+    }
+}
+
+enum class Match { Exact, Inexact, Different };
+
+Match compareReply(const TraceSession& s, const std::string& actual) {
+    if (actual == s.expected) return Match::Exact;
+    if (actual.size() != s.expected.size()) return Match::Different;
+    size_t pos = 0;
+    for (size_t offset : s.doubles) {
+        if (offset + sizeof(double) > actual.size()) break;
+        if (actual.compare(pos, offset - pos, s.expected, pos, offset - pos) != 0) return Match::Different;
+        double a, e;
+        memcpy(&a, actual.data() + offset, sizeof(a));
+        memcpy(&e, s.expected.data() + offset, sizeof(e));
+        if (!(std::fabs(a - e) <= 1e-9 * std::max(1.0, std::fabs(e)))) return Match::Different;
+        pos = offset + sizeof(double);
+    }
+    return actual.compare(pos, std::string::npos, s.expected, pos, std::string::npos) == 0 ? Match::Inexact
+                                                                                        : Match::Different;
+}
+
+bool loadTrace(const std::string& file, std::vector<TraceSession>& sessions, uint64_t& incomplete) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+        std::cerr << "Ошибка открытия трассы: " << file << std::endl;
+        return false;
+    }
+    std::string trace((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    capture::Reader reader;
+    if (!reader.open(trace)) {
+        std::cerr << "Ошибка: " << file << " — не трасса сессий" << std::endl;
+        return false;
+    }
+
+    std::unordered_map<uint32_t, size_t> index;
+    // Ответы собираются по сессиям, а разбираются, когда известны все порции
+    std::vector<std::vector<uint64_t>> out_times;
+    std::vector<std::vector<size_t>> out_ends;
+    capture::Record r;
+    while (reader.next(r)) {
+        if (r.kind == capture::Kind::Open) {
+            index[r.session] = sessions.size();
+            sessions.emplace_back();
+            sessions.back().open_ns = r.time_ns;
+            out_times.emplace_back();
+            out_ends.emplace_back();
+            continue;
+        }
+        auto it = index.find(r.session);
+        if (it == index.end()) continue;
+        size_t i = it->second;
+        TraceSession& s = sessions[i];
+        uint64_t t = r.time_ns - s.open_ns;
+        switch (r.kind) {
+        case capture::Kind::In:
+            s.input.append(r.data.data(), r.data.size());
+            s.chunks.push_back({s.input.size(), t});
+            break;
+        case capture::Kind::Out:
+            s.expected.append(r.data.data(), r.data.size());
+            out_times[i].push_back(t);
+            out_ends[i].push_back(s.expected.size());
+            break;
+        case capture::Kind::Close:
+            s.closed = true;
+            s.lost = !r.data.empty() && r.data[0] != 0;
+            index.erase(it);
+            break;
+        default:
+            break;
+        }
+    }
+    if (reader.truncated()) std::cerr << "Предупреждение: трасса оборвана" << std::endl;
+
+    incomplete = 0;
+    for (size_t i = 0; i < sessions.size(); i++) {
+        TraceSession& s = sessions[i];
+        if (!s.closed || s.lost) {
+            incomplete++;
+            continue;
+        }
+        rewriteAuth(s);
+        size_t skip = s.want_ticket ? skipTicket(s.expected) : 0;
+        if (skip) s.expected.erase(2, skip);
+        findDoubles(s);
+        size_t chunk = 0;
+        for (size_t k = 0; k < out_ends[i].size(); k++) {
+            size_t end = out_ends[i][k];
+            end = end <= 2 ? end : end < 2 + skip ? 2 : end - skip;
+            if (!s.replies.empty() && s.replies.back().end >= end) continue;
+            while (chunk < s.chunks.size() && s.chunks[chunk].time_ns <= out_times[i][k]) chunk++;
+            s.replies.push_back({end, out_times[i][k], chunk == 0 ? SIZE_MAX : chunk - 1});
+        }
+    }
+    return true;
+}
+
+int connectTo(const Options& opt) {
+    sockaddr_storage addr;
+    socklen_t len;
+    memset(&addr, 0, sizeof(addr));
+    if (!opt.unix_path.empty()) {
+        auto& un = reinterpret_cast<sockaddr_un&>(addr);
+        if (opt.unix_path.size() >= sizeof(un.sun_path)) return -1;
+        un.sun_family = AF_UNIX;
+        memcpy(un.sun_path, opt.unix_path.c_str(), opt.unix_path.size() + 1);
+        len = sizeof(un);
+    } else {
+        auto& in = reinterpret_cast<sockaddr_in&>(addr);
+        in.sin_family = AF_INET;
+        in.sin_port = htons(static_cast<uint16_t>(opt.port));
+        if (inet_pton(AF_INET, opt.address.c_str(), &in.sin_addr) <= 0) return -1;
+        len = sizeof(in);
+    }
+    int fd = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (addr.ss_family == AF_INET) {
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), len) < 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+uint64_t nsSince(Clock::time_point from) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - from).count());
+}
+
+Clock::time_point scaled(Clock::time_point base, uint64_t ns, double speed) {
+    return base + std::chrono::nanoseconds(static_cast<int64_t>(static_cast<double>(ns) / speed));
+}
+
+// Одна сессия: порции клиента по расписанию, ответы по мере прихода.
+// Сессия кончается, когда получен весь записанный ответ или сервер закрыл
+// соединение; false — ошибка соединения или тайм-аут
+bool replaySession(const Options& opt, const TraceSession& s, std::string& actual, Totals& totals) {
+    int fd = connectTo(opt);
+    if (fd < 0) return false;
+    Clock::time_point start = Clock::now();
+    Clock::time_point last_progress = start;
+    std::vector<Clock::time_point> sent_at(s.chunks.size());
+    size_t chunk = 0;
+    size_t sent = 0;
+    size_t reply = 0;
+    bool skipping_ticket = false;
+    bool ok = true;
+    char buf[64 * 1024];
+
+    for (;;) {
+        // Отправляем всё, чему пришло время, пока сокет принимает
+        bool blocked = false;
+        while (chunk < s.chunks.size() &&
+               (opt.speed == 0 || Clock::now() >= scaled(start, s.chunks[chunk].time_ns, opt.speed))) {
+            ssize_t n = send(fd, s.input.data() + sent, s.chunks[chunk].end - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                blocked = true;
+                break;
+            }
+            if (n < 0) break;   // сервер закрыл сессию; ответ проверит сравнение
+            sent += static_cast<size_t>(n);
+            totals.bytes_in += static_cast<uint64_t>(n);
+            last_progress = Clock::now();
+            if (sent == s.chunks[chunk].end) sent_at[chunk++] = Clock::now();
+        }
+        if (chunk == s.chunks.size() && actual.size() >= s.expected.size()) break;
+
+        int timeout = opt.timeout_ms;
+        if (chunk < s.chunks.size() && !blocked && opt.speed > 0) {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+                scaled(start, s.chunks[chunk].time_ns, opt.speed) - Clock::now());
+            timeout = static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(wait.count() + 1, timeout)));
+        }
+        pollfd p = {fd, static_cast<short>(POLLIN | (blocked ? POLLOUT : 0)), 0};
+        int ready = poll(&p, 1, timeout);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready == 0 && nsSince(last_progress) >= static_cast<uint64_t>(opt.timeout_ms) * 1000000) {
+            ok = false;
+            break;
+        }
+        if (!(p.revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+        if (n <= 0) break;
+        last_progress = Clock::now();
+        for (ssize_t i = 0; i < n; i++) {
+            if (skipping_ticket) {
+                skipping_ticket = buf[i] != '\n';
+                continue;
+            }
+            actual += buf[i];
+            if (s.want_ticket && actual.size() == 2 && actual == "OK") skipping_ticket = true;
+        }
+        while (reply < s.replies.size() && actual.size() >= s.replies[reply].end) {
+            const Reply& r = s.replies[reply++];
+            if (r.last_chunk == SIZE_MAX || r.last_chunk >= chunk) continue;
+            totals.latencies_ns.push_back(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(last_progress - sent_at[r.last_chunk]).count()));
+            totals.captured_ns.push_back(r.time_ns - s.chunks[r.last_chunk].time_ns);
+            totals.replies++;
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+void worker(const Options& opt, const std::vector<TraceSession>& sessions, const std::vector<size_t>& order,
+            std::atomic<size_t>& next, Clock::time_point start, uint64_t first_open_ns, Totals& totals) {
+    // Отсчёт общий для всех потоков и для итогового времени, в том числе
+    // без пауз (-x 0): иначе быстрые потоки начали бы раньше start
+    std::this_thread::sleep_until(start);
+    std::string actual;
+    for (;;) {
+        size_t i = next++;
+        if (i >= order.size()) break;
+        const TraceSession& s = sessions[order[i]];
+        if (opt.speed > 0) {
+            Clock::time_point due = scaled(start, s.open_ns - first_open_ns, opt.speed);
+            std::this_thread::sleep_until(due);
+            totals.max_lag_ns = std::max(totals.max_lag_ns, static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - due).count()));
+        }
+        actual.clear();
+        bool ok = replaySession(opt, s, actual, totals);
+        totals.replayed++;
+        if (!ok) {
+            totals.errors++;
+        } else {
+            Match match = compareReply(s, actual);
+            totals.mismatched += match == Match::Different;
+            totals.inexact += match == Match::Inexact;
+        }
+    }
+}
+
+double percentileUs(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t i = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return static_cast<double>(sorted[i]) / 1000.0;
+}
+
+// Итог прогона — строки "ключ значение" в фиксированном порядке
+std::vector<std::pair<std::string, double>> summarize(const Totals& t, double elapsed) {
+    return {
+        {"sessions_per_s", static_cast<double>(t.replayed) / elapsed},
+        {"replies_per_s", static_cast<double>(t.replies) / elapsed},
+        {"mb_in_per_s", static_cast<double>(t.bytes_in) / elapsed / 1e6},
+        {"latency_p50_us", percentileUs(t.latencies_ns, 0.5)},
+        {"latency_p99_us", percentileUs(t.latencies_ns, 0.99)},
+        {"latency_p999_us", percentileUs(t.latencies_ns, 0.999)},
+        {"latency_max_us", percentileUs(t.latencies_ns, 1.0)},
+    };
+}
+
+bool compareWithBaseline(const std::string& file, const std::vector<std::pair<std::string, double>>& current) {
+    std::ifstream in(file);
+    if (!in) {
+        std::cerr << "Ошибка открытия итога прогона: " << file << std::endl;
+        return false;
+    }
+    std::map<std::string, double> baseline;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        double value;
+        if (fields >> key >> value) baseline[key] = value;
+    }
+    printf("Сравнение с %s:\n", file.c_str());
+    for (const auto& [key, value] : current) {
+        auto it = baseline.find(key);
+        if (it == baseline.end()) continue;
+        double delta = it->second != 0 ? (value - it->second) / it->second * 100 : 0;
+        printf("  %-16s %12.1f -> %12.1f  (%+.1f%%)\n", key.c_str(), it->second, value, delta);
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) return 1;
+
+    std::vector<TraceSession> sessions;
+    uint64_t incomplete = 0;
+    if (!loadTrace(opt.trace_file, sessions, incomplete)) return 1;
+
+    std::vector<size_t> order;
+    uint64_t resumed = 0;
+    for (size_t i = 0; i < sessions.size(); i++) {
+        if (!sessions[i].closed || sessions[i].lost) continue;
+        if (sessions[i].resumed) {
+            resumed++;
+            continue;
+        }
+        order.push_back(i);
+    }
+    if (order.empty()) {
+        std::cerr << "Ошибка: в трассе нет сессий для воспроизведения" << std::endl;
+        return 1;
+    }
+    uint64_t first_open_ns = sessions[order.front()].open_ns;
+
+    std::vector<Totals> results(std::min(opt.connections, order.size()));
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next{0};
+    Clock::time_point start = Clock::now() + std::chrono::milliseconds(10);
+    for (Totals& totals : results) {
+        threads.emplace_back(worker, std::cref(opt), std::cref(sessions), std::cref(order), std::ref(next), start,
+                             first_open_ns, std::ref(totals));
+    }
+    for (auto& t : threads) t.join();
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    Totals total;
+    for (const Totals& r : results) {
+        total.replayed += r.replayed;
+        total.mismatched += r.mismatched;
+        total.inexact += r.inexact;
+        total.errors += r.errors;
+        total.bytes_in += r.bytes_in;
+        total.replies += r.replies;
+        total.latencies_ns.insert(total.latencies_ns.end(), r.latencies_ns.begin(), r.latencies_ns.end());
+        total.captured_ns.insert(total.captured_ns.end(), r.captured_ns.begin(), r.captured_ns.end());
+        total.max_lag_ns = std::max(total.max_lag_ns, r.max_lag_ns);
+    }
+    std::sort(total.latencies_ns.begin(), total.latencies_ns.end());
+    std::sort(total.captured_ns.begin(), total.captured_ns.end());
+
+    printf("Трасса: %s, сессий: %zu (пропущено: неполных %llu, по билету %llu)\n", opt.trace_file.c_str(),
+           sessions.size(), static_cast<unsigned long long>(incomplete), static_cast<unsigned long long>(resumed));
+    if (opt.speed > 0) {
+        printf("Темп: x%g, соединений: %zu, наибольшее отставание от расписания: %.1f мс\n", opt.speed,
+               results.size(), static_cast<double>(total.max_lag_ns) / 1e6);
+    } else {
+        printf("Темп: без пауз, соединений: %zu\n", results.size());
+    }
+    printf("Воспроизведено: %llu, ответ совпал: %llu (в младших битах дисперсии: %llu), расхождений: %llu, "
+           "ошибок: %llu, время: %.2f с\n",
+           static_cast<unsigned long long>(total.replayed),
+           static_cast<unsigned long long>(total.replayed - total.mismatched - total.errors),
+           static_cast<unsigned long long>(total.inexact), static_cast<unsigned long long>(total.mismatched),
+           static_cast<unsigned long long>(total.errors), elapsed);
+    auto summary = summarize(total, elapsed);
+    printf("Пропускная способность: %.0f сессий/с, %.0f ответов/с, %.1f МБ/с\n", summary[0].second,
+           summary[1].second, summary[2].second);
+    printf("Задержка, мкс:        p50 %.1f  p99 %.1f  p999 %.1f  max %.1f\n", summary[3].second, summary[4].second,
+           summary[5].second, summary[6].second);
+    printf("При записи, мкс:      p50 %.1f  p99 %.1f  p999 %.1f  max %.1f\n", percentileUs(total.captured_ns, 0.5),
+           percentileUs(total.captured_ns, 0.99), percentileUs(total.captured_ns, 0.999),
+           percentileUs(total.captured_ns, 1.0));
+
+    if (!opt.summary_file.empty()) {
+        std::ofstream out(opt.summary_file);
+        for (const auto& [key, value] : summary) out << key << ' ' << value << '\n';
+        if (!out) {
+            std::cerr << "Ошибка записи итога прогона: " << opt.summary_file << std::endl;
+            return 1;
+        }
+    }
+    if (!opt.baseline_file.empty() && !compareWithBaseline(opt.baseline_file, summary)) return 1;
+    return total.mismatched == 0 && total.errors == 0 ? 0 : 2;
+}
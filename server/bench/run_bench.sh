@@ -0,0 +1,41 @@
+#!/bin/sh
+# Полный прогон бенчмарков: микробенчмарки, затем генератор нагрузки
+# против сервера, запущенного на отдельном порту с временной базой.
+#
+#   make bench [BENCH_PORT=33399] [BENCH_ARGS="-c 8 -n 1000 -b 10 -d 5"]
+set -e
+cd "$(dirname "$0")/.."
+
+PORT=${BENCH_PORT:-33399}
+ARGS=${BENCH_ARGS:-"-c 8 -n 1000 -b 10 -d 3"}
+TMP=$(mktemp -d)
+trap 'kill $SERVER $CAPTURE 2>/dev/null || true; wait 2>/dev/null; rm -rf "$TMP"' EXIT
+
+./bench/micro_bench
+
+echo "user P@ssW0rd" > "$TMP/db.txt"
+./server -d "$TMP/db.txt" -LU "$TMP/log.txt" -p "$PORT" -u "$TMP/server.sock" -t "$(nproc)" -v warn > /dev/null &
+SERVER=$!
+# Второй сервер пишет трассу сессий для bench/replay; порт занимается
+# сразу, пока его не занял локальный порт какого-нибудь соединения
+./server -d "$TMP/db.txt" -LU "$TMP/capture.log" -p "$((PORT + 1))" -o "$TMP/sessions.rcp" -v warn > /dev/null &
+CAPTURE=$!
+sleep 0.5
+
+echo "--- замкнутый цикл"
+./bench/load_gen -p "$PORT" $ARGS
+echo "--- открытый цикл, 2000 запросов/с"
+./bench/load_gen -p "$PORT" $ARGS -r 2000
+echo "--- постоянные сессии, конвейер из 4 пакетов"
+./bench/load_gen -p "$PORT" $ARGS -k 4
+echo "--- постоянные сессии, компактное кодирование, случайное блуждание"
+./bench/load_gen -p "$PORT" $ARGS -k 4 -e compact -g walk
+echo "--- постоянные сессии, Unix-сокет"
+./bench/load_gen -U "$TMP/server.sock" $ARGS -k 4
+echo "--- постоянные сессии, кольцо в разделяемой памяти"
+./bench/load_gen -U "$TMP/server.sock" $ARGS -k 4 -m shm
+echo "--- запись сессий и их воспроизведение без пауз"
+./bench/load_gen -p "$((PORT + 1))" $ARGS -k 4 -d 0.5 > /dev/null
+kill $CAPTURE
+wait $CAPTURE || true
+./bench/replay -f "$TMP/sessions.rcp" -p "$PORT" -x 0 -c 8
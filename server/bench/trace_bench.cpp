@@ -0,0 +1,82 @@
+// Стоимость обработки одного вектора с трассировкой и без неё.
+//
+//   "до"        — каждый элемент печатается в std::cout, как раньше
+//                 делал processVectors (stdout перенаправлен в /dev/null);
+//   "отключено" — вывод под trace::enabled<Trace>(), уровень при запуске INFO;
+//   "вырезано"  — тот же исходник (trace_vector.cpp), собранный с
+//                 TRACE_LEVEL=1: вызовы TRACE отброшены при сборке.
+//
+// Сборка и запуск: make trace_bench && ./bench/trace_bench [элементов] [повторов]
+
+#include "trace_vector.h"
+#include "../trace.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace {
+
+volatile int64_t sink;
+
+void vectorBefore(std::vector<int64_t>& data) {
+    int64_t avg = trace_bench::reduce(data);
+    std::cout << "Вектор 1 данные: ";
+    for (size_t j = 0; j < data.size(); j++) {
+        std::cout << data[j];
+        if (j < data.size() - 1) std::cout << ", ";
+    }
+    std::cout << std::endl;
+    std::cout << "Среднее арифметическое: " << avg << std::endl;
+    sink = avg;
+}
+
+void vectorRuntimeOff(std::vector<int64_t>& data) {
+    sink = trace_bench::vectorTraceLevel0(data);
+}
+
+void vectorCompiledOut(std::vector<int64_t>& data) {
+    sink = trace_bench::vectorTraceLevel1(data);
+}
+
+template <typename F>
+double nsPerVector(F f, std::vector<int64_t>& data, int reps) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++) {
+        f(data);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / reps;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t size = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    int reps = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    std::vector<int64_t> data(size);
+    std::mt19937_64 rng(42);
+    for (auto& v : data) {
+        v = static_cast<int64_t>(rng() % 2000001) - 1000000;
+    }
+
+    std::ofstream devnull("/dev/null");
+    std::streambuf* saved = std::cout.rdbuf(devnull.rdbuf());
+    trace::setLevel(trace::Level::Info);
+
+    double before = nsPerVector(vectorBefore, data, reps);
+    double runtime_off = nsPerVector(vectorRuntimeOff, data, reps);
+    double compiled_out = nsPerVector(vectorCompiledOut, data, reps);
+
+    std::cout.rdbuf(saved);
+    std::cout << "Элементов в векторе: " << size << ", повторов: " << reps << "\n";
+    std::cout << "  до (вывод каждого элемента): " << before / 1000.0 << " мкс/вектор\n";
+    std::cout << "  TRACE отключён при запуске:  " << runtime_off / 1000.0 << " мкс/вектор\n";
+    std::cout << "  TRACE вырезан при сборке:    " << compiled_out / 1000.0 << " мкс/вектор\n";
+    std::cout << "  ускорение: " << before / runtime_off << "x / " << before / compiled_out << "x\n";
+    return 0;
+}
@@ -0,0 +1,26 @@
+#include "trace_vector.h"
+#include "../trace.h"
+
+#include <sstream>
+
+// Имя функции содержит уровень сборки: vectorTraceLevel0, vectorTraceLevel1
+#define TRACE_VECTOR_NAME(level) TRACE_VECTOR_NAME_(level)
+#define TRACE_VECTOR_NAME_(level) vectorTraceLevel##level
+
+namespace trace_bench {
+
+int64_t TRACE_VECTOR_NAME(TRACE_LEVEL)(std::vector<int64_t>& data) {
+    int64_t avg = reduce(data);
+    if (trace::enabled<trace::Level::Trace>()) {
+        std::ostringstream dump;
+        for (size_t j = 0; j < data.size(); j++) {
+            dump << data[j];
+            if (j < data.size() - 1) dump << ", ";
+        }
+        trace::print<trace::Level::Trace>("Вектор 1 данные: ", dump.str());
+    }
+    trace::print<trace::Level::Trace>("Среднее арифметическое: ", avg);
+    return avg;
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <endian.h>
+#include <vector>
+
+// Обработка вектора с трассировкой для bench/trace_bench. trace_vector.cpp
+// собирается дважды из одного исходника: с TRACE_LEVEL=0 вывод TRACE
+// отключается уровнем при запуске, с TRACE_LEVEL=1 он вырезан при сборке.
+namespace trace_bench {
+
+inline int64_t reduce(std::vector<int64_t>& data) {
+    for (auto& val : data) {
+        val = le64toh(val);
+    }
+    int64_t sum = 0;
+    for (const auto& val : data) {
+        sum += val;
+    }
+    return sum / static_cast<int64_t>(data.size());
+}
+
+int64_t vectorTraceLevel0(std::vector<int64_t>& data);
+int64_t vectorTraceLevel1(std::vector<int64_t>& data);
+
+}
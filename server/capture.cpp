@@ -0,0 +1,198 @@
+#include "capture.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace capture {
+
+namespace {
+
+uint64_t monotonicNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void putVarint(std::vector<char>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+bool writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+}
+
+Writer::~Writer() {
+    close();
+}
+
+bool Writer::open(const std::string& path) {
+    // Трасса содержит сообщения аутентификации: читать её может только
+    // владелец, в том числе если файл уже существовал с другими правами
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd_ < 0) return false;
+    if (fchmod(fd_, 0600) < 0) {
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    uint32_t magic = htole32(kMagic);
+    uint64_t start = htole64(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count()));
+    char header[kHeaderSize];
+    memcpy(header, &magic, sizeof(magic));
+    memcpy(header + sizeof(magic), &start, sizeof(start));
+    if (!writeAll(fd_, header, sizeof(header))) {
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    pending_.reserve(kFlushBytes * 2);
+    last_ns_ = monotonicNs();
+    stopping_ = false;
+    writer_ = std::thread(&Writer::writerLoop, this);
+    return true;
+}
+
+void Writer::close() {
+    if (fd_ < 0) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+    ::close(fd_);
+    fd_ = -1;
+}
+
+uint64_t Writer::dropped() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
+
+uint32_t Writer::begin() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t session = ++next_session_;
+    put(Kind::Open, session, nullptr, 0, false);
+    return session;
+}
+
+bool Writer::data(uint32_t session, Kind kind, const char* data, size_t len) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_.size() + len > kMaxPending) {
+        dropped_ += len;
+        return false;
+    }
+    put(kind, session, data, len, true);
+    if (pending_.size() >= kFlushBytes) wake_.notify_one();
+    return true;
+}
+
+void Writer::end(uint32_t session, bool lost) {
+    // Закрытие пишется всегда, даже сверх предела: иначе неполную запись
+    // сессии не отличить от оборванной
+    char flag = lost ? 1 : 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    put(Kind::Close, session, &flag, 1, true);
+}
+
+void Writer::put(Kind kind, uint32_t session, const char* data, size_t len, bool with_data) {
+    // Время берётся под мьютексом, поэтому записи идут по возрастанию
+    uint64_t now = monotonicNs();
+    pending_.push_back(static_cast<char>(kind));
+    putVarint(pending_, session);
+    putVarint(pending_, now - last_ns_);
+    last_ns_ = now;
+    if (!with_data) return;
+    putVarint(pending_, len);
+    pending_.insert(pending_.end(), data, data + len);
+}
+
+void Writer::writerLoop() {
+    // Два буфера по очереди: память, однажды выделенная под пик, остаётся
+    std::vector<char> batch;
+    batch.reserve(kFlushBytes * 2);
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait_for(lock, std::chrono::milliseconds(kFlushIntervalMs),
+                       [this] { return stopping_ || pending_.size() >= kFlushBytes; });
+        bool stopping = stopping_;
+        batch.swap(pending_);
+        lock.unlock();
+        if (!batch.empty() && !writeAll(fd_, batch.data(), batch.size())) {
+            // Диск недоступен: дальше данные копятся до предела и отбрасываются
+            lock.lock();
+            dropped_ += batch.size();
+            lock.unlock();
+        }
+        batch.clear();
+        if (stopping) return;
+        lock.lock();
+    }
+}
+
+bool Reader::open(std::string_view trace) {
+    if (trace.size() < kHeaderSize) return false;
+    uint32_t magic;
+    memcpy(&magic, trace.data(), sizeof(magic));
+    if (le32toh(magic) != kMagic) return false;
+    memcpy(&start_ns_, trace.data() + sizeof(magic), sizeof(start_ns_));
+    start_ns_ = le64toh(start_ns_);
+    trace_ = trace;
+    pos_ = kHeaderSize;
+    time_ns_ = 0;
+    truncated_ = false;
+    return true;
+}
+
+bool Reader::next(Record& record) {
+    if (pos_ >= trace_.size()) return false;
+    uint8_t kind = static_cast<uint8_t>(trace_[pos_++]);
+    uint64_t session, delta, len = 0;
+    bool ok = kind >= static_cast<uint8_t>(Kind::Open) && kind <= static_cast<uint8_t>(Kind::Close) &&
+              varint(session) && varint(delta);
+    if (ok && kind != static_cast<uint8_t>(Kind::Open)) {
+        ok = varint(len) && len <= trace_.size() - pos_;
+    }
+    if (!ok) {
+        truncated_ = true;
+        pos_ = trace_.size();
+        return false;
+    }
+    time_ns_ += delta;
+    record.kind = static_cast<Kind>(kind);
+    record.session = static_cast<uint32_t>(session);
+    record.time_ns = time_ns_;
+    record.data = trace_.substr(pos_, len);
+    pos_ += len;
+    return true;
+}
+
+bool Reader::varint(uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && pos_ < trace_.size(); shift += 7) {
+        uint8_t b = static_cast<uint8_t>(trace_[pos_++]);
+        value |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Запись сессий в двоичную трассу для воспроизведения (bench/replay).
+//
+// Формат: заголовок — "RCP1" и uint64 LE, время начала записи
+// (CLOCK_REALTIME, нс); затем записи. Запись — байт вида, номер сессии,
+// время от предыдущей записи в нс и, для In и Out, длина и данные; числа —
+// varint (по 7 бит, младшие вперёд).
+//
+//   Open  — сессия принята;
+//   In    — байты от клиента в том виде, в каком они пришли: сообщение
+//           аутентификации и кадры векторов (из сокета или кольца);
+//   Out   — байты ответа в момент отправки;
+//   Close — конец сессии; данные — 1 байт: 1, если часть записей потеряна.
+//
+// Сообщения аутентификации записываются как есть (логин, соль, хеш пароля
+// или билет возобновления), поэтому трасса — секрет уровня базы клиентов:
+// файл создаётся с правами 0600.
+//
+// Сессии только дописывают байты в буфер под мьютексом, файл пишет фоновый
+// поток. Если на диск не успевает уйти kMaxPending байт, новые данные
+// отбрасываются, а сессия, потерявшая запись, помечается неполной: реактор
+// никогда не ждёт диска.
+namespace capture {
+
+constexpr uint32_t kMagic = 0x31504352;   // "RCP1"
+constexpr size_t kHeaderSize = 12;
+
+enum class Kind : uint8_t { Open = 1, In = 2, Out = 3, Close = 4 };
+
+class Writer {
+public:
+    Writer() = default;
+    ~Writer();
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    // Создаёт (перезаписывает) файл трассы с правами 0600 и запускает
+    // фоновую запись
+    bool open(const std::string& path);
+    // Дописывает накопленное и закрывает файл
+    void close();
+    uint64_t dropped() const;
+
+    // Новая сессия; возвращает её номер
+    uint32_t begin();
+    // false — данные не записаны, запись сессии неполна
+    bool data(uint32_t session, Kind kind, const char* data, size_t len);
+    void end(uint32_t session, bool lost);
+
+private:
+    static constexpr size_t kMaxPending = 64 * 1024 * 1024;
+    static constexpr size_t kFlushBytes = 1024 * 1024;
+    static constexpr int kFlushIntervalMs = 100;
+
+    int fd_ = -1;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<char> pending_;
+    uint64_t last_ns_ = 0;
+    uint32_t next_session_ = 0;
+    uint64_t dropped_ = 0;
+    bool stopping_ = false;
+    std::thread writer_;
+
+    void put(Kind kind, uint32_t session, const char* data, size_t len, bool with_data);
+    void writerLoop();
+};
+
+// Запись трассы; time_ns — от начала записи
+struct Record {
+    Kind kind;
+    uint32_t session;
+    uint64_t time_ns;
+    std::string_view data;
+};
+
+// Последовательное чтение трассы, целиком загруженной в память
+class Reader {
+public:
+    // Проверяет заголовок
+    bool open(std::string_view trace);
+    uint64_t startRealtimeNs() const { return start_ns_; }
+    // false — трасса кончилась; truncated() — последняя запись оборвана
+    bool next(Record& record);
+    bool truncated() const { return truncated_; }
+
+private:
+    std::string_view trace_;
+    size_t pos_ = 0;
+    uint64_t start_ns_ = 0;
+    uint64_t time_ns_ = 0;
+    bool truncated_ = false;
+
+    bool varint(uint64_t& value);
+};
+
+}
@@ -0,0 +1,469 @@
+#include "client.h"
+#include "../auth_message.h"
+#include "../protocol.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Данные векторов уходят в сокет как есть, без перестановки байтов
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "клиент поддерживает только little-endian хосты");
+
+namespace client {
+
+namespace {
+
+constexpr size_t kRecvBufSize = 64 * 1024;
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+std::string authMessage(const Options& options) {
+    static thread_local std::mt19937_64 rng(std::random_device{}());
+    return proto::authMessage(options.login, options.password, proto::authSalt(rng())) + '\n';
+}
+
+bool sendAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool recvAll(int fd, char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = recv(fd, data, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+uint64_t load64(const char*& p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    p += sizeof(v);
+    return le64toh(v);
+}
+
+double loadDouble(const char*& p) {
+    uint64_t bits = load64(p);
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+}
+
+Client::Client(Options options) : options_(std::move(options)) {}
+
+Client::~Client() {
+    stop();
+}
+
+bool Client::start(std::string& error) {
+    if (options_.connections == 0 || options_.max_inflight == 0) {
+        error = "Пустой пул соединений";
+        return false;
+    }
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        error = std::string("Ошибка создания epoll: ") + strerror(errno);
+        return false;
+    }
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+
+    // Адреса соединений попадают в epoll: размер пула больше не меняется
+    connections_ = std::vector<Connection>(options_.connections);
+    for (Connection& conn : connections_) {
+        if (!connect(conn, error)) {
+            for (Connection& opened : connections_) {
+                if (opened.fd >= 0) close(opened.fd);
+                opened.fd = -1;
+            }
+            return false;
+        }
+    }
+    running_ = true;
+    thread_ = std::thread(&Client::run, this);
+    return true;
+}
+
+void Client::stop() {
+    if (running_) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        uint64_t one = 1;
+        if (write(wake_fd_, &one, sizeof(one)) < 0) {}
+        thread_.join();
+        running_ = false;
+    }
+    if (wake_fd_ >= 0) close(wake_fd_);
+    if (epoll_fd_ >= 0) close(epoll_fd_);
+    wake_fd_ = epoll_fd_ = -1;
+}
+
+void Client::submit(std::vector<VectorRef> vectors, uint32_t ops, Callback done) {
+    auto batch = std::make_unique<Batch>();
+    batch->done = std::move(done);
+    if (vectors.empty() || vectors.size() > proto::kCountMask) {
+        complete(*batch, "Неверное число векторов в пакете: " + std::to_string(vectors.size()));
+        return;
+    }
+    if (ops & ~proto::kKnownOps) {
+        complete(*batch, "Неверная маска операций: " + std::to_string(ops));
+        return;
+    }
+
+    // Заголовок пакета и размеры векторов — в одном массиве; iovec
+    // ссылаются на него и на данные вызывающего
+    batch->ops = ops;
+    batch->count = vectors.size();
+    batch->header.reserve(2 + vectors.size());
+    batch->header.push_back(htole32(static_cast<uint32_t>(vectors.size()) | proto::kFlagKeepAlive |
+                                    (ops ? proto::kFlagOps : 0)));
+    if (ops) batch->header.push_back(htole32(ops));
+    for (const VectorRef& v : vectors) batch->header.push_back(htole32(v.size));
+
+    size_t head = ops ? 2 : 1;
+    batch->iov.reserve(1 + 2 * vectors.size());
+    batch->iov.push_back({batch->header.data(), head * sizeof(uint32_t)});
+    for (size_t i = 0; i < vectors.size(); i++) {
+        batch->iov.push_back({&batch->header[head + i], sizeof(uint32_t)});
+        if (vectors[i].size == 0) continue;
+        batch->iov.push_back({const_cast<int64_t*>(vectors[i].data), vectors[i].size * sizeof(int64_t)});
+    }
+    batch->reply.resize(vectors.size() * (ops ? proto::recordSize(ops) : sizeof(int64_t)));
+
+    {
+        // Будим поток под блокировкой: после stop() дескриптор закрыт
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_ && !stopping_) {
+            queue_.push_back(std::move(batch));
+            uint64_t one = 1;
+            if (write(wake_fd_, &one, sizeof(one)) < 0) {}
+            return;
+        }
+    }
+    complete(*batch, "Клиент не запущен");
+}
+
+std::future<Result> Client::submit(std::vector<VectorRef> vectors, uint32_t ops) {
+    auto promise = std::make_shared<std::promise<Result>>();
+    std::future<Result> future = promise->get_future();
+    submit(std::move(vectors), ops, [promise](Result&& result) { promise->set_value(std::move(result)); });
+    return future;
+}
+
+bool Client::connect(Connection& conn, std::string& error) {
+    sockaddr_storage addr;
+    socklen_t len;
+    memset(&addr, 0, sizeof(addr));
+    if (!options_.unix_path.empty()) {
+        auto& un = reinterpret_cast<sockaddr_un&>(addr);
+        if (options_.unix_path.size() >= sizeof(un.sun_path)) {
+            error = "Слишком длинный путь Unix-сокета";
+            return false;
+        }
+        un.sun_family = AF_UNIX;
+        memcpy(un.sun_path, options_.unix_path.c_str(), options_.unix_path.size() + 1);
+        len = sizeof(un);
+    } else {
+        auto& in = reinterpret_cast<sockaddr_in&>(addr);
+        in.sin_family = AF_INET;
+        in.sin_port = htons(static_cast<uint16_t>(options_.port));
+        if (inet_pton(AF_INET, options_.address.c_str(), &in.sin_addr) <= 0) {
+            error = "Ошибка преобразования адреса: " + options_.address;
+            return false;
+        }
+        len = sizeof(in);
+    }
+
+    int fd = socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        error = std::string("Ошибка создания сокета: ") + strerror(errno);
+        return false;
+    }
+    if (addr.ss_family == AF_INET) {
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+    // Подключение и аутентификация блокирующие, со сроком
+    timeval tv = {options_.timeout_ms / 1000, (options_.timeout_ms % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), len) < 0) {
+        error = std::string("Ошибка подключения к серверу: ") + strerror(errno);
+        close(fd);
+        return false;
+    }
+    std::string auth = authMessage(options_);
+    char status[2];
+    if (!sendAll(fd, auth.data(), auth.size()) || !recvAll(fd, status, sizeof(status))) {
+        error = "Ошибка обмена при аутентификации";
+        close(fd);
+        return false;
+    }
+    if (memcmp(status, "OK", 2) != 0) {
+        error = "Сервер отклонил аутентификацию " + options_.login;
+        close(fd);
+        return false;
+    }
+
+    timeval none = {0, 0};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &none, sizeof(none));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &none, sizeof(none));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    ev.data.ptr = &conn;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        error = std::string("Ошибка добавления сокета в epoll: ") + strerror(errno);
+        close(fd);
+        return false;
+    }
+    conn.fd = fd;
+    conn.unsent = 0;
+    conn.iov_index = conn.iov_offset = 0;
+    return true;
+}
+
+void Client::disconnect(Connection& conn, const std::string& error) {
+    close(conn.fd);
+    conn.fd = -1;
+
+    // Пакеты, из которых в сокет не ушло ни байта, вернутся в очередь и
+    // уйдут по другому соединению; остальные завершаются ошибкой
+    size_t started = conn.unsent + (conn.unsent < conn.batches.size() &&
+                                    (conn.iov_index > 0 || conn.iov_offset > 0));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = conn.batches.size(); i > started; i--) {
+            queue_.push_front(std::move(conn.batches[i - 1]));
+        }
+    }
+    for (size_t i = 0; i < started; i++) complete(*conn.batches[i], error);
+    conn.batches.clear();
+    conn.unsent = conn.iov_index = conn.iov_offset = 0;
+}
+
+void Client::dispatch() {
+    std::deque<std::unique_ptr<Batch>> failed;
+    std::string error;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (queue_.empty()) return;
+        // Упавшие соединения переподключаются, только когда есть что отправить
+        bool any = false;
+        for (Connection& conn : connections_) {
+            if (conn.fd < 0) {
+                lock.unlock();
+                connect(conn, error);
+                lock.lock();
+            }
+            any = any || conn.fd >= 0;
+        }
+        if (!any) {
+            failed.swap(queue_);
+        }
+
+        while (!queue_.empty()) {
+            Connection* best = nullptr;
+            for (Connection& conn : connections_) {
+                if (conn.fd >= 0 && conn.batches.size() < options_.max_inflight &&
+                    (!best || conn.batches.size() < best->batches.size())) {
+                    best = &conn;
+                }
+            }
+            if (!best) break;
+            best->batches.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+    }
+    for (auto& batch : failed) complete(*batch, error);
+
+    for (Connection& conn : connections_) {
+        if (conn.fd >= 0 && conn.unsent < conn.batches.size() && !flush(conn)) {
+            disconnect(conn, std::string("Ошибка отправки пакета: ") + strerror(errno));
+        }
+    }
+}
+
+bool Client::flush(Connection& conn) {
+    while (conn.unsent < conn.batches.size()) {
+        // Собираем iovec нескольких пакетов подряд, начиная с позиции отправки
+        iovec iov[IOV_MAX];
+        int count = 0;
+        size_t b = conn.unsent;
+        size_t index = conn.iov_index;
+        size_t offset = conn.iov_offset;
+        while (b < conn.batches.size() && count < IOV_MAX) {
+            const iovec& src = conn.batches[b]->iov[index];
+            iov[count].iov_base = static_cast<char*>(src.iov_base) + offset;
+            iov[count].iov_len = src.iov_len - offset;
+            count++;
+            offset = 0;
+            if (++index == conn.batches[b]->iov.size()) {
+                index = 0;
+                b++;
+            }
+        }
+
+        msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = static_cast<size_t>(count);
+        ssize_t n = sendmsg(conn.fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        size_t sent = static_cast<size_t>(n);
+        while (sent > 0) {
+            const iovec& src = conn.batches[conn.unsent]->iov[conn.iov_index];
+            size_t left = src.iov_len - conn.iov_offset;
+            if (sent < left) {
+                conn.iov_offset += sent;
+                break;
+            }
+            sent -= left;
+            conn.iov_offset = 0;
+            if (++conn.iov_index == conn.batches[conn.unsent]->iov.size()) {
+                conn.iov_index = 0;
+                conn.unsent++;
+            }
+        }
+    }
+    return true;
+}
+
+bool Client::receive(Connection& conn) {
+    static thread_local char buf[kRecvBufSize];
+    for (;;) {
+        ssize_t n = recv(conn.fd, buf, sizeof(buf), 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        if (n == 0) {
+            errno = ECONNRESET;
+            return false;
+        }
+
+        // Ответы приходят в порядке пакетов: байты достаются первому из ждущих
+        const char* p = buf;
+        size_t avail = static_cast<size_t>(n);
+        while (avail > 0) {
+            if (conn.unsent == 0 && conn.iov_index == 0 && conn.iov_offset == 0) {
+                errno = EPROTO;
+                return false;
+            }
+            Batch& batch = *conn.batches.front();
+            size_t take = std::min(avail, batch.reply.size() - batch.received);
+            memcpy(batch.reply.data() + batch.received, p, take);
+            batch.received += take;
+            p += take;
+            avail -= take;
+            if (batch.received < batch.reply.size()) break;
+
+            complete(batch, "");
+            conn.batches.pop_front();
+            if (conn.unsent > 0) conn.unsent--;
+        }
+    }
+}
+
+void Client::run() {
+    epoll_event events[64];
+    for (;;) {
+        int n = epoll_wait(epoll_fd_, events, 64, -1);
+        if (n < 0 && errno != EINTR) break;
+        for (int i = 0; i < n; i++) {
+            if (!events[i].data.ptr) {
+                uint64_t value;
+                if (read(wake_fd_, &value, sizeof(value)) < 0) {}
+                continue;
+            }
+            Connection& conn = *static_cast<Connection*>(events[i].data.ptr);
+            if (conn.fd < 0) continue;
+            bool ok = true;
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) ok = receive(conn);
+            if (ok && (events[i].events & EPOLLOUT)) ok = flush(conn);
+            if (!ok) {
+                std::string reason = errno == EPROTO ? "Ответ сервера без запроса"
+                                                     : std::string("Соединение разорвано: ") + strerror(errno);
+                disconnect(conn, reason);
+            }
+        }
+        dispatch();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!stopping_ || !queue_.empty()) continue;
+        bool idle = true;
+        for (const Connection& conn : connections_) idle = idle && conn.batches.empty();
+        if (idle) break;
+    }
+
+    // Слово количества 0 после пакета с keep-alive завершает сессию
+    for (Connection& conn : connections_) {
+        if (conn.fd < 0) continue;
+        uint32_t end = 0;
+        ::send(conn.fd, &end, sizeof(end), MSG_NOSIGNAL);
+        close(conn.fd);
+        conn.fd = -1;
+    }
+}
+
+void Client::complete(Batch& batch, std::string error) {
+    Result result;
+    result.error = std::move(error);
+    if (result.ok()) {
+        const char* p = batch.reply.data();
+        if (batch.ops == 0) {
+            result.means.resize(batch.count);
+            for (int64_t& mean : result.means) mean = static_cast<int64_t>(load64(p));
+        } else {
+            // Поля записи идут в порядке битов маски
+            result.stats.resize(batch.count);
+            for (Stats& s : result.stats) {
+                if (batch.ops & proto::kOpSum) {
+                    uint64_t low = load64(p);
+                    uint64_t high = load64(p);
+                    s.sum = static_cast<int128_t>((static_cast<uint128_t>(high) << 64) | low);
+                }
+                if (batch.ops & proto::kOpMean) s.mean = static_cast<int64_t>(load64(p));
+                if (batch.ops & proto::kOpMin) s.min = static_cast<int64_t>(load64(p));
+                if (batch.ops & proto::kOpMax) s.max = static_cast<int64_t>(load64(p));
+                if (batch.ops & proto::kOpVariance) s.variance = loadDouble(p);
+                if (batch.ops & proto::kOpStddev) s.stddev = loadDouble(p);
+                if (batch.ops & proto::kOpNegatives) s.negatives = load64(p);
+            }
+        }
+    }
+    if (batch.done) batch.done(std::move(result));
+}
+
+}
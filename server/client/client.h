@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+
+// Асинхронный клиент сервера свёртки векторов с пулом соединений.
+//
+// Каждое соединение пула аутентифицируется один раз и дальше работает как
+// постоянная сессия: пакеты отправляются с флагом keep-alive, не дожидаясь
+// ответов на предыдущие (не больше max_inflight в полёте на соединение), а
+// ответы разбираются по порядку. Пакеты отправляются через sendmsg (writev
+// с MSG_NOSIGNAL), по нескольку за вызов, прямо из буферов вызывающего:
+// заголовки пакета собираются в отдельный массив, а данные векторов не
+// копируются. Поэтому данные должны оставаться живыми и
+// неизменными, пока не выполнен результат пакета.
+//
+// Все сокеты обслуживает один поток ввода-вывода на epoll; обратные вызовы
+// выполняются в нём и не должны блокироваться. Разорванное соединение
+// переподключается при следующем пакете; пакеты, уже отправленные в него,
+// завершаются ошибкой (сервер закрывает сессию при ошибке в данных,
+// поэтому повтор такого пакета закончился бы тем же).
+namespace client {
+
+__extension__ typedef __int128 int128_t;
+
+struct Options {
+    std::string address = "127.0.0.1";
+    int port = 33333;
+    std::string unix_path;              // Unix-сокет вместо TCP
+    std::string login = "user";
+    std::string password = "P@ssW0rd";
+    size_t connections = 4;             // соединений в пуле
+    size_t max_inflight = 64;           // пакетов в полёте на соединение
+    int timeout_ms = 10000;             // подключение и аутентификация
+};
+
+// Вектор в памяти вызывающего (int64 в порядке байтов хоста)
+struct VectorRef {
+    const int64_t* data;
+    uint32_t size;
+};
+
+// Запись статистик вектора; заполнены поля, запрошенные маской proto::kOp*
+struct Stats {
+    int128_t sum = 0;
+    int64_t mean = 0;
+    int64_t min = 0;
+    int64_t max = 0;
+    double variance = 0;
+    double stddev = 0;
+    uint64_t negatives = 0;
+};
+
+// Результат пакета: средние (маска операций 0) или записи статистик
+struct Result {
+    std::string error;                  // пусто при успехе
+    std::vector<int64_t> means;
+    std::vector<Stats> stats;
+
+    bool ok() const { return error.empty(); }
+};
+
+using Callback = std::function<void(Result&&)>;
+
+class Client {
+public:
+    explicit Client(Options options);
+    // Дожидается всех поставленных пакетов и закрывает сессии
+    ~Client();
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    // Открывает и аутентифицирует все соединения пула, запускает поток
+    // ввода-вывода; при ошибке error содержит её описание
+    bool start(std::string& error);
+    // Дожидается всех поставленных пакетов и закрывает сессии
+    void stop();
+
+    // Ставит пакет в очередь. ops — маска proto::kOp* (0 — только средние)
+    void submit(std::vector<VectorRef> vectors, uint32_t ops, Callback done);
+    std::future<Result> submit(std::vector<VectorRef> vectors, uint32_t ops = 0);
+
+private:
+    struct Batch {
+        std::vector<uint32_t> header;   // слово количества, маска, размеры векторов (LE)
+        std::vector<iovec> iov;
+        uint32_t ops = 0;
+        size_t count = 0;
+        std::vector<char> reply;
+        size_t received = 0;
+        Callback done;
+    };
+    struct Connection {
+        int fd = -1;
+        std::deque<std::unique_ptr<Batch>> batches;   // в порядке ответов
+        size_t unsent = 0;              // первый не отправленный до конца пакет
+        size_t iov_index = 0;           // позиция отправки в нём
+        size_t iov_offset = 0;
+    };
+
+    Options options_;
+    std::vector<Connection> connections_;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::thread thread_;
+
+    std::mutex mutex_;
+    std::deque<std::unique_ptr<Batch>> queue_;
+    bool stopping_ = false;
+    std::atomic<bool> running_{false};
+
+    bool connect(Connection& conn, std::string& error);
+    void disconnect(Connection& conn, const std::string& error);
+    void dispatch();
+    bool flush(Connection& conn);
+    bool receive(Connection& conn);
+    void run();
+    static void complete(Batch& batch, std::string error);
+};
+
+}
@@ -0,0 +1,166 @@
+// Проверка клиентской библиотеки против запущенного сервера (make check):
+// результаты сверяются с посчитанными локально. Сервер должен работать в
+// режиме суммирования wrap с ограничением размера вектора по умолчанию
+// (100000 элементов) и знать пользователя user с паролем P@ssW0rd.
+//
+//   ./client/client_test [-p <port>] [-U <path>]
+
+#include "client.h"
+#include "../protocol.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* what) {
+    printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) failures++;
+}
+
+std::vector<std::vector<int64_t>> makeVectors(size_t count, size_t max_size, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<std::vector<int64_t>> vectors(count);
+    for (auto& v : vectors) {
+        v.resize(rng() % (max_size + 1));
+        for (int64_t& x : v) x = static_cast<int64_t>(rng() % 2000001) - 1000000;
+    }
+    return vectors;
+}
+
+std::vector<client::VectorRef> refs(const std::vector<std::vector<int64_t>>& vectors) {
+    std::vector<client::VectorRef> out;
+    for (const auto& v : vectors) out.push_back({v.data(), static_cast<uint32_t>(v.size())});
+    return out;
+}
+
+// Среднее, как его считает сервер в режиме wrap
+int64_t mean(const std::vector<int64_t>& v) {
+    if (v.empty()) return 0;
+    uint64_t sum = 0;
+    for (int64_t x : v) sum += static_cast<uint64_t>(x);
+    return static_cast<int64_t>(sum) / static_cast<int64_t>(v.size());
+}
+
+bool meansMatch(const client::Result& result, const std::vector<std::vector<int64_t>>& vectors) {
+    if (!result.ok() || result.means.size() != vectors.size()) return false;
+    for (size_t i = 0; i < vectors.size(); i++) {
+        if (result.means[i] != mean(vectors[i])) return false;
+    }
+    return true;
+}
+
+bool statsMatch(const client::Result& result, const std::vector<std::vector<int64_t>>& vectors) {
+    if (!result.ok() || result.stats.size() != vectors.size()) return false;
+    for (size_t i = 0; i < vectors.size(); i++) {
+        const auto& v = vectors[i];
+        const client::Stats& s = result.stats[i];
+        client::int128_t sum = 0;
+        uint64_t negatives = 0;
+        double sq = 0;
+        for (int64_t x : v) {
+            sum += x;
+            negatives += x < 0;
+        }
+        double avg = v.empty() ? 0 : static_cast<double>(sum) / static_cast<double>(v.size());
+        for (int64_t x : v) sq += (static_cast<double>(x) - avg) * (static_cast<double>(x) - avg);
+        double variance = v.empty() ? 0 : sq / static_cast<double>(v.size());
+        bool ok = s.sum == sum && s.mean == mean(v) && s.negatives == negatives &&
+                  s.min == (v.empty() ? 0 : *std::min_element(v.begin(), v.end())) &&
+                  s.max == (v.empty() ? 0 : *std::max_element(v.begin(), v.end())) &&
+                  std::fabs(s.variance - variance) <= 1e-9 * std::max(1.0, variance) &&
+                  std::fabs(s.stddev - std::sqrt(variance)) <= 1e-9 * std::max(1.0, std::sqrt(variance));
+        if (!ok) return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    client::Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-p") == 0) options.port = std::atoi(argv[i + 1]);
+        if (strcmp(argv[i], "-U") == 0) options.unix_path = argv[i + 1];
+    }
+    options.connections = 3;
+    options.max_inflight = 8;
+
+    {
+        client::Options wrong = options;
+        wrong.password = "wrong";
+        client::Client c(wrong);
+        std::string error;
+        check(!c.start(error) && !error.empty(), "неверный пароль отклоняется при запуске");
+    }
+
+    client::Client c(options);
+    std::string error;
+    if (!c.start(error)) {
+        printf("FAIL запуск клиента: %s\n", error.c_str());
+        return 1;
+    }
+
+    auto small = makeVectors(10, 1000, 1);
+    small[3].clear();
+    check(meansMatch(c.submit(refs(small)).get(), small), "средние одного пакета, с пустым вектором");
+    check(statsMatch(c.submit(refs(small), proto::kKnownOps).get(), small), "все статистики пакета");
+    auto partial = c.submit(refs(small), proto::kOpMin | proto::kOpNegatives).get();
+    check(partial.ok() && partial.stats.size() == small.size() && partial.stats[0].min != 0 &&
+              partial.stats[0].mean == 0 && partial.stats[0].negatives != 0,
+          "только запрошенные поля записи");
+
+    // Много пакетов в полёте сразу: на соединение больше, чем max_inflight,
+    // и векторы, которые не уходят в сокет одним вызовом
+    std::vector<std::vector<std::vector<int64_t>>> batches;
+    for (uint64_t i = 0; i < 200; i++) batches.push_back(makeVectors(1 + i % 7, i % 10 == 0 ? 100000 : 2000, i + 10));
+    std::vector<std::future<client::Result>> futures;
+    for (size_t i = 0; i < batches.size(); i++) {
+        futures.push_back(c.submit(refs(batches[i]), i % 2 ? proto::kKnownOps : 0));
+    }
+    bool all = true;
+    for (size_t i = 0; i < futures.size(); i++) {
+        client::Result result = futures[i].get();
+        all = all && (i % 2 ? statsMatch(result, batches[i]) : meansMatch(result, batches[i]));
+    }
+    check(all, "200 пакетов конвейером по пулу");
+
+    std::promise<bool> called;
+    c.submit(refs(small), 0, [&](client::Result&& result) { called.set_value(meansMatch(result, small)); });
+    check(called.get_future().get(), "обратный вызов");
+
+    // Сервер закрывает сессию на слишком большом векторе; пакет получает
+    // ошибку, а следующие идут по переподключённым соединениям
+    std::vector<std::vector<int64_t>> oversize(1, std::vector<int64_t>(100001, 1));
+    check(!c.submit(refs(oversize)).get().ok(), "ошибка сервера завершает пакет ошибкой");
+    futures.clear();
+    for (size_t i = 0; i < 20; i++) futures.push_back(c.submit(refs(small)));
+    all = true;
+    for (auto& f : futures) all = all && meansMatch(f.get(), small);
+    check(all, "пакеты после переподключения");
+
+    check(!c.submit({}, 0).get().ok(), "пустой пакет отклоняется");
+    check(!c.submit(refs(small), 0x80).get().ok(), "неизвестная операция отклоняется");
+
+    // stop() дожидается поставленных пакетов
+    std::atomic<size_t> done{0};
+    for (size_t i = 0; i < 50; i++) {
+        c.submit(refs(small), 0, [&](client::Result&& result) { done += meansMatch(result, small); });
+    }
+    c.stop();
+    check(done == 50, "stop() завершает поставленные пакеты");
+    check(!c.submit(refs(small)).get().ok(), "после stop() пакеты не принимаются");
+
+    printf("%s\n", failures ? "ЕСТЬ ОШИБКИ" : "Все проверки пройдены");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,21 @@
+#!/bin/sh
+# Проверка клиентской библиотеки против сервера, запущенного на отдельном
+# порту с временной базой: по TCP, затем через Unix-сокет.
+#
+#   make check [CHECK_PORT=33398]
+set -e
+cd "$(dirname "$0")/.."
+
+PORT=${CHECK_PORT:-33398}
+TMP=$(mktemp -d)
+trap 'kill $SERVER 2>/dev/null; wait 2>/dev/null; rm -rf "$TMP"' EXIT
+
+echo "user P@ssW0rd" > "$TMP/db.txt"
+./server -d "$TMP/db.txt" -LU "$TMP/log.txt" -p "$PORT" -u "$TMP/server.sock" -v warn > /dev/null &
+SERVER=$!
+sleep 0.5
+
+echo "--- TCP"
+./client/client_test -p "$PORT"
+echo "--- Unix-сокет"
+./client/client_test -U "$TMP/server.sock"
@@ -0,0 +1,357 @@
+#include "client_db.h"
+#include "auth.h"
+#include "trace.h"
+
+#include <cctype>
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <openssl/crypto.h>
+
+namespace {
+
+constexpr char kMagic[4] = {'K', 'D', 'B', '1'};
+constexpr size_t kHeaderSize = 32;
+constexpr size_t kSlotSize = 8;
+constexpr size_t kEntryHeader = 3;
+
+uint32_t load32(const char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return le32toh(v);
+}
+
+uint64_t load64(const char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return le64toh(v);
+}
+
+void store32(char* p, uint32_t v) {
+    v = htole32(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+void store64(char* p, uint64_t v) {
+    v = htole64(v);
+    memcpy(p, &v, sizeof(v));
+}
+
+// FNV-1a, свёрнутый до 32 бит
+uint32_t hashLogin(std::string_view login) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : login) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+std::string_view entryLogin(const char* strings, uint64_t offset) {
+    return std::string_view(strings + offset + kEntryHeader, static_cast<unsigned char>(strings[offset]));
+}
+
+}
+
+ClientSnapshot::~ClientSnapshot() {
+    if (map_) munmap(map_, map_size_);
+}
+
+std::unique_ptr<ClientSnapshot> ClientSnapshot::load(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Ошибка открытия файла базы данных: " << filename << std::endl;
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        std::cerr << "Ошибка чтения файла базы данных: " << filename << std::endl;
+        return nullptr;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* map = nullptr;
+    if (size > 0) {
+        map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        std::cerr << "Ошибка отображения файла базы данных: " << filename << std::endl;
+        return nullptr;
+    }
+
+    std::unique_ptr<ClientSnapshot> snapshot(new ClientSnapshot());
+    const char* data = static_cast<const char*>(map);
+    if (size >= sizeof(kMagic) && memcmp(data, kMagic, sizeof(kMagic)) == 0) {
+        // Двоичный снимок остаётся отображённым на всё время жизни
+        snapshot->map_ = map;
+        snapshot->map_size_ = size;
+        if (!snapshot->attach(data, size)) {
+            std::cerr << "Повреждённый снимок базы данных: " << filename << std::endl;
+            return nullptr;
+        }
+        return snapshot;
+    }
+
+    bool built = snapshot->build(data, size);
+    if (map) munmap(map, size);
+    if (!built) {
+        std::cerr << "Слишком большая база данных: " << filename << std::endl;
+        return nullptr;
+    }
+    return snapshot;
+}
+
+bool ClientSnapshot::attach(const char* data, size_t size) {
+    if (size < kHeaderSize) return false;
+    uint32_t slots = load32(data + 4);
+    uint64_t strings_size = load64(data + 16);
+    if (slots == 0 || (slots & (slots - 1)) != 0) return false;
+    uint64_t strings_offset = kHeaderSize + static_cast<uint64_t>(slots) * kSlotSize;
+    if (strings_offset > size || strings_size > size - strings_offset) return false;
+
+    data_ = data;
+    data_size_ = strings_offset + strings_size;
+    mask_ = slots - 1;
+    entries_ = load32(data + 8);
+    slots_ = data + kHeaderSize;
+    strings_ = data + strings_offset;
+    strings_size_ = strings_size;
+    return true;
+}
+
+bool ClientSnapshot::build(const char* text, size_t size) {
+    // Разбор строк "логин пароль"; пустые строки и комментарии пропускаются
+    struct Line { std::string_view login, password; };
+    std::vector<Line> lines;
+    uint64_t strings_size = 0;
+    const char* end = text + size;
+    for (const char* p = text; p < end;) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        const char* q = p;
+        p = eol + 1;
+        if (q == eol || *q == '#') continue;
+
+        std::string_view tokens[2];
+        size_t found = 0;
+        while (found < 2) {
+            while (q < eol && std::isspace(static_cast<unsigned char>(*q))) q++;
+            const char* start = q;
+            while (q < eol && !std::isspace(static_cast<unsigned char>(*q))) q++;
+            if (q == start) break;
+            tokens[found++] = std::string_view(start, q - start);
+        }
+        if (found < 2) continue;
+        if (tokens[0].size() > kMaxLogin || tokens[1].size() > kMaxPassword) {
+            std::cerr << "Пропущена запись со слишком длинным логином или паролем" << std::endl;
+            continue;
+        }
+        lines.push_back({tokens[0], tokens[1]});
+        strings_size += kEntryHeader + tokens[0].size() + tokens[1].size();
+    }
+    if (strings_size >= UINT32_MAX) return false;
+
+    uint32_t slots = 16;
+    while (slots < 2 * lines.size()) slots *= 2;
+    size_t strings_offset = kHeaderSize + static_cast<size_t>(slots) * kSlotSize;
+    image_.assign(strings_offset + strings_size, 0);
+    char* image = image_.data();
+    char* slot_base = image + kHeaderSize;
+    char* strings = image + strings_offset;
+
+    // Повторный логин заменяет предыдущую запись, как и раньше
+    uint64_t offset = 0;
+    uint32_t entries = 0;
+    uint32_t mask = slots - 1;
+    for (const Line& line : lines) {
+        char* entry = strings + offset;
+        entry[0] = static_cast<char>(line.login.size());
+        uint16_t password_len = htole16(static_cast<uint16_t>(line.password.size()));
+        memcpy(entry + 1, &password_len, sizeof(password_len));
+        memcpy(entry + kEntryHeader, line.login.data(), line.login.size());
+        memcpy(entry + kEntryHeader + line.login.size(), line.password.data(), line.password.size());
+
+        uint32_t hash = hashLogin(line.login);
+        for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+            char* slot = slot_base + i * kSlotSize;
+            uint32_t ref = load32(slot + 4);
+            if (ref == 0) {
+                entries++;
+            } else if (load32(slot) != hash || entryLogin(strings, ref - 1) != line.login) {
+                continue;
+            }
+            store32(slot, hash);
+            store32(slot + 4, static_cast<uint32_t>(offset + 1));
+            break;
+        }
+        offset += kEntryHeader + line.login.size() + line.password.size();
+    }
+
+    memcpy(image, kMagic, sizeof(kMagic));
+    store32(image + 4, slots);
+    store32(image + 8, entries);
+    store64(image + 16, strings_size);
+    return attach(image, image_.size());
+}
+
+bool ClientSnapshot::find(std::string_view login, std::string_view& password) const {
+    uint32_t hash = hashLogin(login);
+    uint32_t i = hash & mask_;
+    for (uint32_t probes = 0; probes <= mask_; probes++, i = (i + 1) & mask_) {
+        const char* slot = slots_ + i * kSlotSize;
+        uint32_t ref = load32(slot + 4);
+        if (ref == 0) return false;
+        if (load32(slot) != hash) continue;
+
+        uint64_t offset = ref - 1;
+        if (offset + kEntryHeader > strings_size_) return false;
+        const char* entry = strings_ + offset;
+        size_t login_len = static_cast<unsigned char>(entry[0]);
+        uint16_t password_len;
+        memcpy(&password_len, entry + 1, sizeof(password_len));
+        password_len = le16toh(password_len);
+        if (offset + kEntryHeader + login_len + password_len > strings_size_) return false;
+        if (std::string_view(entry + kEntryHeader, login_len) != login) continue;
+        password = std::string_view(entry + kEntryHeader + login_len, password_len);
+        return true;
+    }
+    return false;
+}
+
+bool ClientSnapshot::write(const std::string& filename) const {
+    // Пишем во временный файл и переименовываем, чтобы работающий сервер
+    // при перезагрузке не увидел недописанный снимок
+    std::string tmp = filename + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return false;
+    size_t done = 0;
+    while (done < data_size_) {
+        ssize_t n = ::write(fd, data_ + done, data_size_ - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    bool ok = done == data_size_ && fsync(fd) == 0;
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), filename.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Регистрация читателя в счётчике текущей эпохи. Если эпоха сменилась
+// между чтением и регистрацией, читатель перерегистрируется, поэтому
+// после смены эпохи снимок, прочитанный через старый счётчик, может
+// держать только уже учтённый читатель.
+class ClientDB::ReadGuard {
+    const ClientDB& db_;
+    uint32_t slot_;
+    const ClientSnapshot* snapshot_;
+
+public:
+    explicit ReadGuard(const ClientDB& db) : db_(db) {
+        for (;;) {
+            uint32_t epoch = db_.epoch_.load();
+            slot_ = epoch & 1;
+            db_.readers_[slot_].fetch_add(1);
+            if (db_.epoch_.load() == epoch) break;
+            db_.readers_[slot_].fetch_sub(1);
+        }
+        snapshot_ = db_.current_.load();
+    }
+    ~ReadGuard() { db_.readers_[slot_].fetch_sub(1, std::memory_order_release); }
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+
+    const ClientSnapshot* get() const { return snapshot_; }
+
+    bool find(std::string_view login, std::string_view& password) const {
+        return snapshot_ && snapshot_->find(login, password);
+    }
+};
+
+ClientDB::~ClientDB() {
+    delete current_.load();
+}
+
+bool ClientDB::load(const std::string& filename) {
+    // Снимок строится без блокировок; мьютекс лишь упорядочивает загрузки
+    std::unique_ptr<ClientSnapshot> snapshot = ClientSnapshot::load(filename);
+    if (!snapshot) return false;
+    trace::print<trace::Level::Debug>("Загружено записей из ", filename, ": ", snapshot->size());
+
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    const ClientSnapshot* old = current_.exchange(snapshot.release());
+    uint32_t epoch = epoch_.fetch_add(1);
+    while (readers_[epoch & 1].load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+    }
+    delete old;
+    return true;
+}
+
+bool ClientDB::writeSnapshot(const std::string& filename) const {
+    ReadGuard guard(*this);
+    return guard.get() && guard.get()->write(filename);
+}
+
+size_t ClientDB::getClientCount() const {
+    ReadGuard guard(*this);
+    return guard.get() ? guard.get()->size() : 0;
+}
+
+bool ClientDB::contains(std::string_view login) const {
+    ReadGuard guard(*this);
+    std::string_view password;
+    return guard.find(login, password);
+}
+
+bool ClientDB::auth(std::string_view login, std::string_view password) const {
+    ReadGuard guard(*this);
+    std::string_view expected;
+    if (!guard.find(login, expected)) {
+        trace::print<trace::Level::Debug>("Клиент не найден: ", login);
+        return false;
+    }
+
+    bool result = (expected == password);
+    trace::print<trace::Level::Debug>("Аутентификация ", login, ": ", (result ? "УСПЕХ" : "НЕУДАЧА"));
+    return result;
+}
+
+bool ClientDB::verifyDigest(std::string_view login, std::string_view salt,
+                            const unsigned char* digest, bool& found) const {
+    ReadGuard guard(*this);
+    std::string_view password;
+    found = guard.find(login, password);
+    if (!found) {
+        trace::print<trace::Level::Debug>("Клиент не найден в базе: '", login, "'");
+        return false;
+    }
+
+    // Вычисляем ожидаемый хеш: SHA256(salt + password) без склейки строк
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, salt.data(), salt.size());
+    SHA256_Update(&ctx, password.data(), password.size());
+    SHA256_Final(hash, &ctx);
+
+    // Секреты выводятся только на уровне TRACE, который по умолчанию не компилируется
+    trace::print<trace::Level::Trace>("Найден пароль для логина '", login, "': '", password, "'");
+    trace::print<trace::Level::Trace>("Соль: '", salt, "'");
+
+    // Сравнение двоичных хешей за постоянное время
+    bool result = CRYPTO_memcmp(hash, digest, sizeof(hash)) == 0;
+    trace::print<trace::Level::Debug>("Аутентификация '", login, "': ", (result ? "УСПЕХ" : "НЕУДАЧА"));
+    return result;
+}
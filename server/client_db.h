@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Неизменяемый снимок базы клиентов — образ в формате KDB1:
+//
+//   заголовок: "KDB1", число слотов (степень двойки), число клиентов,
+//              резерв, размер области строк (u64), резерв (u64)
+//   слоты:     { хеш логина (u32), смещение записи + 1 (u32, 0 — пусто) }
+//   строки:    записи { длина логина (u8), длина пароля (u16), логин, пароль }
+//
+// Числа хранятся в порядке little-endian. Поиск — открытая адресация с
+// линейным пробированием по 8-байтным слотам; заполнение не выше половины.
+// Текстовая база при загрузке собирается в такой же образ в памяти, а
+// двоичный снимок отображается через mmap без разбора, поэтому запуск
+// не зависит от числа клиентов. Границы записей проверяются при поиске.
+class ClientSnapshot {
+public:
+    static constexpr size_t kMaxLogin = 255;
+    static constexpr size_t kMaxPassword = 65535;
+
+    ~ClientSnapshot();
+    ClientSnapshot(const ClientSnapshot&) = delete;
+    ClientSnapshot& operator=(const ClientSnapshot&) = delete;
+
+    // Загружает текстовую базу ("логин пароль" в строке) или снимок KDB1;
+    // при ошибке выводит сообщение и возвращает nullptr
+    static std::unique_ptr<ClientSnapshot> load(const std::string& filename);
+
+    bool find(std::string_view login, std::string_view& password) const;
+    size_t size() const { return entries_; }
+    bool write(const std::string& filename) const;
+
+private:
+    std::vector<char> image_;   // образ, собранный из текстовой базы
+    void* map_ = nullptr;       // или отображённый файл снимка
+    size_t map_size_ = 0;
+    const char* data_ = nullptr;
+    size_t data_size_ = 0;
+    uint32_t mask_ = 0;
+    size_t entries_ = 0;
+    const char* slots_ = nullptr;
+    const char* strings_ = nullptr;
+    uint64_t strings_size_ = 0;
+
+    ClientSnapshot() = default;
+    bool attach(const char* data, size_t size);
+    bool build(const char* text, size_t size);
+};
+
+// База клиентов. Проверки аутентификации читают текущий снимок без
+// блокировок: читатель отмечается в одном из двух счётчиков эпохи, а
+// загрузка новой базы публикует снимок атомарной заменой указателя,
+// переключает эпоху и освобождает старый снимок, когда счётчик прежней
+// эпохи обнулится.
+class ClientDB {
+    std::atomic<const ClientSnapshot*> current_{nullptr};
+    std::atomic<uint32_t> epoch_{0};
+    mutable std::atomic<uint64_t> readers_[2] = {};
+    std::mutex update_mutex_;
+
+    class ReadGuard;
+
+public:
+    ClientDB() = default;
+    ~ClientDB();
+    ClientDB(const ClientDB&) = delete;
+    ClientDB& operator=(const ClientDB&) = delete;
+
+    // Загружает базу и атомарно заменяет текущую; безопасно вызывать
+    // параллельно с проверками
+    bool load(const std::string& filename);
+    bool writeSnapshot(const std::string& filename) const;
+
+    bool auth(std::string_view login, std::string_view password) const;
+    // Сравнивает digest с SHA256(salt + пароль) за постоянное время;
+    // found сообщает, есть ли логин в базе
+    bool verifyDigest(std::string_view login, std::string_view salt,
+                      const unsigned char* digest, bool& found) const;
+    bool contains(std::string_view login) const;
+    size_t getClientCount() const;
+};
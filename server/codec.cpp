@@ -0,0 +1,295 @@
+#include "codec.h"
+
+#include <atomic>
+#include <cstring>
+#include <endian.h>
+
+#if defined(__x86_64__) && __BYTE_ORDER == __LITTLE_ENDIAN
+#include <immintrin.h>
+#define CODEC_HAVE_X86 1
+#endif
+
+namespace codec {
+
+namespace {
+
+// Распаковка читает 8 байт с любого байта упакованных данных и ещё 8
+// следом для ширины больше 56 бит; если после блока во входных данных
+// меньше байт, он копируется в буфер с нулевым хвостом
+constexpr size_t kSlack = 16;
+
+inline uint64_t loadLE(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return le64toh(v);
+}
+
+inline uint64_t zigzag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+inline uint64_t unzigzag(uint64_t u) {
+    return (u >> 1) ^ (0 - (u & 1));
+}
+
+inline unsigned width(uint64_t range) {
+    return range ? 64 - __builtin_clzll(range) : 0;
+}
+
+size_t varintSize(uint64_t v) {
+    size_t n = 1;
+    for (; v >= 0x80; v >>= 7) n++;
+    return n;
+}
+
+void putVarint(std::string& out, uint64_t v) {
+    for (; v >= 0x80; v >>= 7) out += static_cast<char>(v | 0x80);
+    out += static_cast<char>(v);
+}
+
+Status readVarint(const unsigned char*& p, const unsigned char* end, uint64_t& value) {
+    uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (p == end) return Status::NeedMore;
+        unsigned char b = *p++;
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            value = v;
+            return Status::Ok;
+        }
+    }
+    return Status::Invalid;
+}
+
+// out[i] = base + i-е поле из w бит, начиная с поля from
+void unpackFrom(const unsigned char* p, size_t from, size_t n, unsigned w, uint64_t base, uint64_t* out) {
+    if (w == 0) {
+        for (size_t i = from; i < n; i++) out[i] = base;
+        return;
+    }
+    uint64_t mask = w == 64 ? ~uint64_t(0) : (uint64_t(1) << w) - 1;
+    for (size_t i = from; i < n; i++) {
+        size_t bit = i * w;
+        unsigned shift = bit & 7;
+        const unsigned char* q = p + (bit >> 3);
+        uint64_t v = loadLE(q) >> shift;
+        if (shift + w > 64) v |= loadLE(q + 8) << (64 - shift);
+        out[i] = base + (v & mask);
+    }
+}
+
+void unpackPortable(const unsigned char* p, size_t n, unsigned w, uint64_t base, uint64_t* out) {
+    unpackFrom(p, 0, n, w, base, out);
+}
+
+#ifdef CODEC_HAVE_X86
+
+// Четыре поля за раз: сбор 8 байт с байтовых смещений полей, сдвиг на
+// смещение внутри байта и маска; при ширине больше 56 бит старшие биты
+// поля добираются вторым сбором
+__attribute__((target("avx2")))
+void unpackAvx2(const unsigned char* p, size_t n, unsigned w, uint64_t base, uint64_t* out) {
+    if (w == 0) {
+        unpackFrom(p, 0, n, w, base, out);
+        return;
+    }
+    const long long* src = reinterpret_cast<const long long*>(p);
+    const __m256i mask = _mm256_set1_epi64x(w == 64 ? -1 : static_cast<long long>((uint64_t(1) << w) - 1));
+    const __m256i seven = _mm256_set1_epi64x(7);
+    const __m256i sixty_four = _mm256_set1_epi64x(64);
+    const __m256i vbase = _mm256_set1_epi64x(static_cast<long long>(base));
+    const __m256i step = _mm256_set1_epi64x(4 * w);
+    __m256i bit = _mm256_setr_epi64x(0, w, 2 * w, 3 * w);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i byte = _mm256_srli_epi64(bit, 3);
+        __m256i shift = _mm256_and_si256(bit, seven);
+        __m256i v = _mm256_srlv_epi64(_mm256_i64gather_epi64(src, byte, 1), shift);
+        if (w > 56) {
+            __m256i hi = _mm256_i64gather_epi64(src + 1, byte, 1);
+            v = _mm256_or_si256(v, _mm256_sllv_epi64(hi, _mm256_sub_epi64(sixty_four, shift)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_add_epi64(vbase, _mm256_and_si256(v, mask)));
+        bit = _mm256_add_epi64(bit, step);
+    }
+    unpackFrom(p, i, n, w, base, out);
+}
+
+#endif
+
+struct Kernel {
+    const char* name;
+    void (*unpack)(const unsigned char*, size_t, unsigned, uint64_t, uint64_t*);
+};
+
+const Kernel kPortable = {"scalar", unpackPortable};
+#ifdef CODEC_HAVE_X86
+const Kernel kAvx2 = {"avx2", unpackAvx2};
+#endif
+
+const Kernel* detect() {
+#ifdef CODEC_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return &kAvx2;
+#endif
+    return &kPortable;
+}
+
+std::atomic<const Kernel*> g_kernel{nullptr};
+
+const Kernel& kernel() {
+    const Kernel* k = g_kernel.load(std::memory_order_acquire);
+    if (!k) {
+        k = detect();
+        g_kernel.store(k, std::memory_order_release);
+    }
+    return *k;
+}
+
+void pack(const int64_t* values, size_t n, uint64_t base, unsigned w, std::string& out) {
+    uint64_t acc = 0;
+    unsigned bits = 0;
+    // В acc меньше 8 неотправленных бит, поэтому за раз добавляется до 32
+    auto put = [&](uint64_t v, unsigned count) {
+        acc |= (v & ((uint64_t(1) << count) - 1)) << bits;
+        for (bits += count; bits >= 8; bits -= 8) {
+            out += static_cast<char>(acc);
+            acc >>= 8;
+        }
+    };
+    for (size_t i = 0; i < n; i++) {
+        uint64_t v = static_cast<uint64_t>(values[i]) - base;
+        if (w > 32) {
+            put(v, 32);
+            put(v >> 32, w - 32);
+        } else if (w > 0) {
+            put(v, w);
+        }
+    }
+    if (bits > 0) out += static_cast<char>(acc);
+}
+
+void encodeBlock(const int64_t* values, size_t n, uint64_t& prev, std::string& out) {
+    int64_t deltas[kBlockSize];
+    int64_t lo = values[0], hi = values[0];
+    int64_t dlo = INT64_MAX, dhi = INT64_MIN;
+    size_t varints = 0, delta_varints = 0;
+    uint64_t last = prev;
+    for (size_t i = 0; i < n; i++) {
+        int64_t x = values[i];
+        int64_t d = static_cast<int64_t>(static_cast<uint64_t>(x) - last);
+        last = static_cast<uint64_t>(x);
+        deltas[i] = d;
+        lo = x < lo ? x : lo;
+        hi = x > hi ? x : hi;
+        dlo = d < dlo ? d : dlo;
+        dhi = d > dhi ? d : dhi;
+        varints += varintSize(zigzag(x));
+        delta_varints += varintSize(zigzag(d));
+    }
+    prev = last;
+
+    unsigned w = width(static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo));
+    unsigned dw = width(static_cast<uint64_t>(dhi) - static_cast<uint64_t>(dlo));
+    size_t plain = varintSize(zigzag(lo)) + (n * w + 7) / 8;
+    size_t delta = varintSize(zigzag(dlo)) + (n * dw + 7) / 8;
+
+    // При равной длине предпочитается распаковка битов — она быстрее varint
+    if (plain <= delta && plain <= varints && plain <= delta_varints) {
+        out += static_cast<char>(w);
+        putVarint(out, zigzag(lo));
+        pack(values, n, static_cast<uint64_t>(lo), w, out);
+    } else if (delta <= varints && delta <= delta_varints) {
+        out += static_cast<char>(proto::kBlockDelta | dw);
+        putVarint(out, zigzag(dlo));
+        pack(deltas, n, static_cast<uint64_t>(dlo), dw, out);
+    } else if (varints <= delta_varints) {
+        out += static_cast<char>(proto::kBlockVarint);
+        for (size_t i = 0; i < n; i++) putVarint(out, zigzag(values[i]));
+    } else {
+        out += static_cast<char>(proto::kBlockDeltaVarint);
+        for (size_t i = 0; i < n; i++) putVarint(out, zigzag(deltas[i]));
+    }
+}
+
+}
+
+Status decodeBlock(const char* data, size_t len, size_t n, uint64_t& prev, int64_t* out, size_t& used) {
+    const unsigned char* begin = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = begin + len;
+    if (len == 0) return Status::NeedMore;
+    const unsigned char* p = begin + 1;
+    uint64_t* values = reinterpret_cast<uint64_t*>(out);
+    uint8_t mode = begin[0];
+    uint64_t last = prev;
+
+    if (mode == proto::kBlockVarint || mode == proto::kBlockDeltaVarint) {
+        bool delta = mode == proto::kBlockDeltaVarint;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t u;
+            Status status = readVarint(p, end, u);
+            if (status != Status::Ok) return status;
+            last = delta ? last + unzigzag(u) : unzigzag(u);
+            values[i] = last;
+        }
+    } else {
+        bool delta = mode & proto::kBlockDelta;
+        unsigned w = mode & ~proto::kBlockDelta;
+        if (w > proto::kMaxBlockWidth) return Status::Invalid;
+        uint64_t base;
+        Status status = readVarint(p, end, base);
+        if (status != Status::Ok) return status;
+        size_t packed = (n * w + 7) / 8;
+        size_t available = static_cast<size_t>(end - p);
+        if (available < packed) return Status::NeedMore;
+
+        const unsigned char* src = p;
+        unsigned char padded[kBlockSize * sizeof(uint64_t) + kSlack];
+        if (available < packed + kSlack) {
+            memcpy(padded, p, packed);
+            memset(padded + packed, 0, kSlack);
+            src = padded;
+        }
+        kernel().unpack(src, n, w, unzigzag(base), values);
+        p += packed;
+
+        if (delta) {
+            for (size_t i = 0; i < n; i++) values[i] = last += values[i];
+        } else {
+            last = values[n - 1];
+        }
+    }
+
+#if __BYTE_ORDER != __LITTLE_ENDIAN
+    for (size_t i = 0; i < n; i++) values[i] = htole64(values[i]);
+#endif
+    prev = last;
+    used = static_cast<size_t>(p - begin);
+    return Status::Ok;
+}
+
+void encode(const int64_t* values, size_t n, std::string& out) {
+    uint64_t prev = 0;
+    for (size_t i = 0; i < n; i += kBlockSize) {
+        encodeBlock(values + i, n - i < kBlockSize ? n - i : kBlockSize, prev, out);
+    }
+}
+
+const char* implementation() {
+    return kernel().name;
+}
+
+bool forceImplementation(const char* name) {
+    const Kernel* best = detect();
+    const Kernel* wanted = nullptr;
+    if (strcmp(name, "scalar") == 0) wanted = &kPortable;
+#ifdef CODEC_HAVE_X86
+    if (strcmp(name, "avx2") == 0 && best == &kAvx2) wanted = &kAvx2;
+#endif
+    (void)best;
+    if (!wanted) return false;
+    g_kernel.store(wanted, std::memory_order_release);
+    return true;
+}
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "protocol.h"
+
+// Компактное кодирование данных векторов (формат — в protocol.h).
+//
+// Сервер декодирует вектор поблочно: блок распаковывается в массив из
+// kBlockSize элементов, который остаётся в L1, и сразу передаётся свёртке,
+// так что промежуточного буфера на весь вектор нет. Распаковка битов
+// (AVX2 или переносимая) выбирается один раз при первом вызове.
+namespace codec {
+
+constexpr size_t kBlockSize = proto::kBlockSize;
+constexpr size_t kMaxVarint = 10;
+// Наибольший блок — kBlockSize varint по 10 байт
+constexpr size_t kMaxBlockBytes = 1 + kBlockSize * kMaxVarint;
+
+enum class Status { Ok, NeedMore, Invalid };
+
+// Декодирует блок из n (1..kBlockSize) элементов из data[0, len) в out —
+// little-endian int64, как данные несжатого вектора. prev — предыдущий
+// элемент вектора (0 перед первым), обновляется. used — длина блока.
+// NeedMore — блок пришёл не целиком; prev и used не меняются.
+Status decodeBlock(const char* data, size_t len, size_t n, uint64_t& prev, int64_t* out, size_t& used);
+
+// Дописывает к out вектор values (в порядке байтов хоста), выбирая для
+// каждого блока самый короткий способ
+void encode(const int64_t* values, size_t n, std::string& out);
+
+// Имя выбранной реализации распаковки: "avx2" или "scalar"
+const char* implementation();
+// Принудительный выбор реализации; false, если процессор её не поддерживает
+bool forceImplementation(const char* name);
+
+}
@@ -0,0 +1,183 @@
+#include "handoff.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace handoff {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x31444E48;   // "HND1"
+// Предел ядра на число дескрипторов в одном сообщении (SCM_MAX_FD)
+constexpr size_t kMaxFds = 253;
+
+// Заголовок перед дескрипторами: сколько в сообщении сокетов каждого вида;
+// дескрипторы идут в том же порядке — TCP, Unix, метрики
+struct Header {
+    uint32_t magic;
+    uint32_t tcp_count;
+    uint32_t has_unix;
+    uint32_t has_metrics;
+};
+
+bool unixAddress(const std::string& path, sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+}
+
+void Sockets::close() {
+    for (int fd : tcp) ::close(fd);
+    tcp.clear();
+    if (unix_fd >= 0) ::close(unix_fd);
+    if (metrics_fd >= 0) ::close(metrics_fd);
+    unix_fd = metrics_fd = -1;
+}
+
+int listen(const std::string& path) {
+    sockaddr_un addr;
+    if (!unixAddress(path, addr)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    // Файл мог остаться от прежнего процесса; тот, кто ещё держит старый
+    // сокет, больше на нём не принимает
+    unlink(path.c_str());
+    // Права выставляются до listen, поэтому подключиться раньше никто не
+    // успеет: получивший сокеты принимает соединения клиентов вместо сервера
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || chmod(path.c_str(), 0600) < 0 ||
+        ::listen(fd, 1) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool trustedPeer(int conn) {
+    ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) return false;
+    return cred.uid == geteuid();
+}
+
+int connect(const std::string& path) {
+    sockaddr_un addr;
+    if (!unixAddress(path, addr)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool send(int conn, const Sockets& sockets, int timeout_ms) {
+    std::vector<int> fds = sockets.tcp;
+    if (sockets.unix_fd >= 0) fds.push_back(sockets.unix_fd);
+    if (sockets.metrics_fd >= 0) fds.push_back(sockets.metrics_fd);
+    if (fds.empty() || fds.size() > kMaxFds) return false;
+
+    Header header = {kMagic, static_cast<uint32_t>(sockets.tcp.size()), sockets.unix_fd >= 0,
+                     sockets.metrics_fd >= 0};
+    iovec iov = {&header, sizeof(header)};
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+    ssize_t sent;
+    do {
+        sent = sendmsg(conn, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    if (sent != static_cast<ssize_t>(sizeof(header))) return false;
+
+    // Подтверждение приходит, когда новый процесс уже принимает соединения
+    pollfd in = {conn, POLLIN, 0};
+    int ready;
+    do {
+        ready = poll(&in, 1, timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+    char ack = 0;
+    return ready > 0 && recv(conn, &ack, 1, 0) == 1;
+}
+
+bool receive(int conn, Sockets& sockets) {
+    Header header;
+    iovec iov = {&header, sizeof(header)};
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * kMaxFds));
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    ssize_t received;
+    do {
+        received = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+    } while (received < 0 && errno == EINTR);
+
+    std::vector<int> fds;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        size_t first = fds.size();
+        fds.resize(first + count);
+        memcpy(fds.data() + first, CMSG_DATA(cmsg), sizeof(int) * count);
+    }
+    bool ok = received == static_cast<ssize_t>(sizeof(header)) && !(msg.msg_flags & MSG_CTRUNC) &&
+              header.magic == kMagic && header.tcp_count <= kMaxFds && header.has_unix <= 1 &&
+              header.has_metrics <= 1 &&
+              fds.size() == size_t{header.tcp_count} + header.has_unix + header.has_metrics;
+    if (!ok) {
+        for (int fd : fds) ::close(fd);
+        return false;
+    }
+    sockets.tcp.assign(fds.begin(), fds.begin() + header.tcp_count);
+    size_t next = header.tcp_count;
+    if (header.has_unix) sockets.unix_fd = fds[next++];
+    if (header.has_metrics) sockets.metrics_fd = fds[next];
+    return true;
+}
+
+bool confirm(int conn) {
+    char ack = 1;
+    return ::send(conn, &ack, 1, MSG_NOSIGNAL) == 1;
+}
+
+std::string socketName(int fd) {
+    sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len) < 0) return "";
+    if (addr.ss_family == AF_INET) {
+        const auto& in = reinterpret_cast<const sockaddr_in&>(addr);
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &in.sin_addr, ip, sizeof(ip));
+        return std::string(ip) + ":" + std::to_string(ntohs(in.sin_port));
+    }
+    if (addr.ss_family == AF_UNIX && len > offsetof(sockaddr_un, sun_path)) {
+        const auto& un = reinterpret_cast<const sockaddr_un&>(addr);
+        return std::string(un.sun_path, strnlen(un.sun_path, len - offsetof(sockaddr_un, sun_path)));
+    }
+    return "";
+}
+
+}
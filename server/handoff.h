@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Передача слушающих сокетов при обновлении сервера без простоя.
+//
+// Работающий сервер с -H <path> слушает на path управляющий Unix-сокет.
+// Новый процесс с тем же -H сначала полностью инициализируется (база
+// клиентов, журнал, ключ билетов), затем подключается к path и получает
+// через SCM_RIGHTS все слушающие сокеты старого: TCP (по одному на шард),
+// Unix-сокет клиентов и сокет метрик. Это те же открытые файлы, поэтому
+// очередь ожидающих соединений не теряется, а порт не освобождается ни на
+// миг. Запустив реакторы, новый процесс занимает path и отвечает байтом
+// подтверждения; только после него старый перестаёт принимать соединения,
+// дообслуживает открытые сессии и завершается. Если новый процесс упал
+// до подтверждения, старый продолжает работу как ни в чём не бывало.
+//
+// Если на path никто не слушает, сервер стартует обычным образом.
+namespace handoff {
+
+// Сокеты, передаваемые новому процессу; -1 — сокета нет
+struct Sockets {
+    std::vector<int> tcp;
+    int unix_fd = -1;
+    int metrics_fd = -1;
+
+    // Закрывает все дескрипторы
+    void close();
+};
+
+// Управляющий сокет на path (прежний файл удаляется, новый доступен только
+// владельцу); -1 при ошибке
+int listen(const std::string& path);
+// Подключившийся процесс запущен тем же пользователем (SO_PEERCRED)
+bool trustedPeer(int conn);
+// Подключение к работающему серверу; -1, если на path никто не слушает
+int connect(const std::string& path);
+
+// Старый процесс: отправляет сокеты и ждёт подтверждения не дольше timeout_ms
+bool send(int conn, const Sockets& sockets, int timeout_ms);
+// Новый процесс: принимает сокеты; подтверждение — confirm()
+bool receive(int conn, Sockets& sockets);
+bool confirm(int conn);
+
+// Адрес, к которому привязан сокет: "ip:port" или путь Unix-сокета
+std::string socketName(int fd);
+
+}
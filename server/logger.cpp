@@ -0,0 +1,288 @@
+#include "logger.h"
+
+#include <algorithm>
+#include <climits>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+// Пишет все iovec целиком, продолжая после частичной записи
+void writeAll(int fd, iovec* iov, size_t count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, static_cast<int>(std::min<size_t>(count, IOV_MAX)));
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        size_t left = static_cast<size_t>(written);
+        while (count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+            iov->iov_len -= left;
+        }
+    }
+}
+
+void formatStamp(std::time_t time, char* buf, size_t size) {
+    std::tm tm;
+    localtime_r(&time, &tm);
+    size_t n = std::strftime(buf, size, "[%Y-%m-%d %H:%M:%S] ", &tm);
+    buf[n] = '\0';
+}
+
+}
+
+Logger::~Logger() {
+    close();
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool Logger::open(const std::string& log_file) {
+    close();
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    log_file_ = log_file;
+    if (log_file_.empty()) return true;
+
+    fd_ = ::open(log_file_.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) return false;
+
+    if (!ring_) {
+        ring_.reset(new Record[kCapacity]);
+    }
+    for (size_t i = 0; i < kCapacity; i++) {
+        ring_[i].seq.store(i, std::memory_order_relaxed);
+    }
+    enqueue_pos_.store(0, std::memory_order_relaxed);
+    dequeue_pos_ = 0;
+
+    running_.store(true, std::memory_order_release);
+    writer_ = std::thread(&Logger::writerLoop, this);
+    return true;
+}
+
+void Logger::close() {
+    if (!running_.exchange(false)) return;
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+    }
+    wake_cv_.notify_one();
+    if (writer_.joinable()) writer_.join();
+}
+
+Logger::Record* Logger::reserve(size_t& pos) const {
+    pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+        Record* rec = &ring_[pos & (kCapacity - 1)];
+        size_t seq = rec->seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) return rec;
+        } else if (diff < 0) {
+            return nullptr;
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void Logger::commit(Record* rec, size_t pos, std::time_t time, size_t len) const {
+    rec->text[len] = '\n';
+    rec->len = static_cast<uint16_t>(len + 1);
+    rec->time = time;
+    rec->seq.store(pos + 1, std::memory_order_release);
+
+    if ((pos & (kFlushRecords - 1)) == kFlushRecords - 1) {
+        wake_cv_.notify_one();
+    }
+}
+
+bool Logger::push(std::time_t time, const char* level, const std::string& msg) const {
+    size_t pos;
+    Record* rec = reserve(pos);
+    if (!rec) return false;
+
+    // Запись: "УРОВЕНЬ: текст\n", длинный текст обрезается по границе UTF-8
+    size_t level_len = strlen(level);
+    size_t room = sizeof(rec->text) - level_len - 1;
+    size_t len = msg.size();
+    if (len > room) {
+        len = room;
+        while (len > 0 && (static_cast<unsigned char>(msg[len]) & 0xC0) == 0x80) len--;
+    }
+    memcpy(rec->text, level, level_len);
+    memcpy(rec->text + level_len, msg.data(), len);
+    commit(rec, pos, time, level_len + len);
+    return true;
+}
+
+bool Logger::pushf(std::time_t time, const char* fmt, va_list args) const {
+    size_t pos;
+    Record* rec = reserve(pos);
+    if (!rec) return false;
+
+    static const char kLevel[] = "INFO: ";
+    size_t level_len = sizeof(kLevel) - 1;
+    memcpy(rec->text, kLevel, level_len);
+    size_t room = sizeof(rec->text) - level_len - 1;
+    int n = vsnprintf(rec->text + level_len, room + 1, fmt, args);
+    size_t len = n < 0 ? 0 : std::min(static_cast<size_t>(n), room);
+    if (static_cast<size_t>(n) > room) {
+        while (len > 0 && (static_cast<unsigned char>(rec->text[level_len + len]) & 0xC0) == 0x80) len--;
+    }
+    commit(rec, pos, time, level_len + len);
+    return true;
+}
+
+void Logger::writeSync(const std::string& msg, bool critical) const {
+    std::lock_guard<std::mutex> lock(sync_mutex_);
+    if (log_file_.empty() || fd_ < 0) {
+        std::cout << msg << std::endl;
+        return;
+    }
+    char timestamp[32];
+    formatStamp(std::time(nullptr), timestamp, sizeof(timestamp));
+    std::string line = std::string(timestamp) + (critical ? "CRITICAL: " : "INFO: ") + msg + "\n";
+    iovec iov{const_cast<char*>(line.data()), line.size()};
+    writeAll(fd_, &iov, 1);
+}
+
+void Logger::log(const std::string& msg, bool critical) const {
+    if (!running_.load(std::memory_order_acquire)) {
+        writeSync(msg, critical);
+        return;
+    }
+
+    std::time_t now = std::time(nullptr);
+    const char* level = critical ? "CRITICAL: " : "INFO: ";
+    if (push(now, level, msg)) {
+        if (critical) wake_cv_.notify_one();
+        return;
+    }
+
+    if (!critical && policy_ == Overflow::Drop) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Буфер полон: будим писателя и ждём освобождения места
+    while (!push(now, level, msg)) {
+        wake_cv_.notify_one();
+        if (!running_.load(std::memory_order_acquire)) {
+            writeSync(msg, critical);
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void Logger::logf(const char* fmt, ...) const {
+    va_list args;
+    if (!running_.load(std::memory_order_acquire)) {
+        char buf[sizeof(Record::text)];
+        va_start(args, fmt);
+        vsnprintf(buf, sizeof(buf), fmt, args);
+        va_end(args);
+        writeSync(buf, false);
+        return;
+    }
+
+    std::time_t now = std::time(nullptr);
+    for (;;) {
+        va_start(args, fmt);
+        bool pushed = pushf(now, fmt, args);
+        va_end(args);
+        if (pushed) return;
+        if (policy_ == Overflow::Drop) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        wake_cv_.notify_one();
+        if (!running_.load(std::memory_order_acquire)) {
+            // Писатель остановлен, пока ждали места: пишем сами, как log()
+            char buf[sizeof(Record::text)];
+            va_start(args, fmt);
+            vsnprintf(buf, sizeof(buf), fmt, args);
+            va_end(args);
+            writeSync(buf, false);
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+const char* Logger::stamp(std::time_t time) {
+    if (time != cached_time_) {
+        formatStamp(time, cached_stamp_, sizeof(cached_stamp_));
+        cached_time_ = time;
+    }
+    return cached_stamp_;
+}
+
+size_t Logger::drainBatch() {
+    iovec iov[2 * kBatch];
+    size_t count = 0;
+    size_t pos = dequeue_pos_;
+    std::time_t batch_time = -1;
+
+    // Записи остаются в кольце до окончания writev, поэтому копирование
+    // не нужно. Пачка обрывается на смене секунды, так как все записи в ней
+    // ссылаются на одну кэшированную метку времени.
+    while (count < kBatch) {
+        Record& rec = ring_[(pos + count) & (kCapacity - 1)];
+        if (rec.seq.load(std::memory_order_acquire) != pos + count + 1) break;
+        if (count > 0 && rec.time != batch_time) break;
+        batch_time = rec.time;
+        const char* ts = stamp(rec.time);
+        iov[2 * count] = {const_cast<char*>(ts), strlen(ts)};
+        iov[2 * count + 1] = {rec.text, rec.len};
+        count++;
+    }
+    if (count == 0) return 0;
+
+    writeAll(fd_, iov, 2 * count);
+
+    for (size_t i = 0; i < count; i++) {
+        ring_[(pos + i) & (kCapacity - 1)].seq.store(pos + i + kCapacity, std::memory_order_release);
+    }
+    dequeue_pos_ = pos + count;
+    return count;
+}
+
+void Logger::writerLoop() {
+    for (;;) {
+        bool running = running_.load(std::memory_order_acquire);
+        {
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            wake_cv_.wait_for(lock, std::chrono::milliseconds(kFlushIntervalMs), [this] {
+                return !running_.load(std::memory_order_acquire) ||
+                       enqueue_pos_.load(std::memory_order_relaxed) - dequeue_pos_ >= kFlushRecords;
+            });
+        }
+        while (drainBatch() > 0) {}
+
+        uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (dropped != reported_dropped_) {
+            std::string line = std::string(stamp(std::time(nullptr))) + "INFO: Пропущено записей журнала (буфер переполнен): " +
+                               std::to_string(dropped - reported_dropped_) + "\n";
+            iovec iov{const_cast<char*>(line.data()), line.size()};
+            writeAll(fd_, &iov, 1);
+            reported_dropped_ = dropped;
+        }
+
+        if (!running) break;
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdarg>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Асинхронный журнал. Потоки-производители кладут готовые записи
+// ("INFO: текст\n") в ограниченный MPSC-кольцевой буфер без блокировок,
+// а один фоновый поток пишет их пачками через writev, подставляя метку
+// времени, которая форматируется не чаще раза в секунду.
+class Logger {
+public:
+    // Что делать, если буфер заполнен: отбросить запись или ждать места.
+    // Критические записи не отбрасываются никогда.
+    enum class Overflow { Drop, Block };
+
+    Logger(const std::string& log_file = "") : log_file_(log_file) {}
+    ~Logger();
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // Открывает файл и запускает фоновую запись; пустое имя — вывод в stdout
+    bool open(const std::string& log_file);
+    // Дописывает всё накопленное и останавливает фоновый поток
+    void close();
+    void setOverflowPolicy(Overflow policy) { policy_ = policy; }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    void log(const std::string& msg, bool critical = false) const;
+    // Запись уровня INFO в формате printf: текст форматируется прямо в
+    // ячейку кольцевого буфера, без промежуточных строк в куче
+    void logf(const char* fmt, ...) const __attribute__((format(printf, 2, 3)));
+
+private:
+    static constexpr size_t kCapacity = 4096;          // записей, степень двойки
+    static constexpr size_t kRecordSize = 512;
+    static constexpr size_t kBatch = 512;              // записей на один writev
+    static constexpr size_t kFlushRecords = 256;       // порог пробуждения писателя
+    static constexpr int kFlushIntervalMs = 50;        // порог по времени
+
+    struct alignas(64) Record {
+        std::atomic<size_t> seq;
+        std::time_t time;
+        uint16_t len;
+        char text[kRecordSize - sizeof(std::atomic<size_t>) - sizeof(std::time_t) - sizeof(uint16_t)];
+    };
+
+    std::string log_file_;
+    int fd_ = -1;
+    Overflow policy_ = Overflow::Block;
+
+    std::unique_ptr<Record[]> ring_;
+    alignas(64) mutable std::atomic<size_t> enqueue_pos_{0};
+    alignas(64) size_t dequeue_pos_ = 0;
+    mutable std::atomic<uint64_t> dropped_{0};
+    uint64_t reported_dropped_ = 0;
+
+    std::atomic<bool> running_{false};
+    std::thread writer_;
+    mutable std::mutex wake_mutex_;
+    mutable std::condition_variable wake_cv_;
+    mutable std::mutex sync_mutex_;
+
+    // Кэш метки времени "[YYYY-MM-DD HH:MM:SS] " для последней секунды
+    std::time_t cached_time_ = -1;
+    char cached_stamp_[32];
+
+    Record* reserve(size_t& pos) const;
+    void commit(Record* rec, size_t pos, std::time_t time, size_t len) const;
+    bool push(std::time_t time, const char* level, const std::string& msg) const;
+    bool pushf(std::time_t time, const char* fmt, va_list args) const;
+    void writeSync(const std::string& msg, bool critical) const;
+    const char* stamp(std::time_t time);
+    size_t drainBatch();
+    void writerLoop();
+};
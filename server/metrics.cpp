@@ -0,0 +1,273 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+namespace metrics {
+
+namespace {
+
+std::mutex g_registry_mutex;
+std::vector<std::unique_ptr<ThreadBlock>> g_blocks;
+
+const char* const kPhaseNames[kPhases] = {"accept_to_auth", "auth", "receive", "compute", "reply"};
+
+struct CounterInfo {
+    const char* name;
+    const char* help;
+};
+
+const CounterInfo kCounterInfo[kCounters] = {
+    {"server_connections_total", "Принятые соединения"},
+    {"server_auth_ok_total", "Успешные аутентификации"},
+    {"server_auth_failures_total", "Неудачные аутентификации"},
+    {"server_batches_total", "Принятые пакеты векторов"},
+    {"server_vectors_total", "Обработанные векторы"},
+    {"server_bytes_in_total", "Принято байт от клиентов"},
+    {"server_bytes_out_total", "Отправлено байт клиентам"},
+    {"server_rejected_oversize_total", "Отклонённые слишком большие пакеты и векторы"},
+    {"server_session_errors_total", "Сессии, завершённые с ошибкой"},
+    {"server_idle_timeouts_total", "Соединения, закрытые по тайм-ауту простоя"},
+    {"server_deadline_exceeded_total", "Соединения, закрытые по сроку фазы сессии"},
+    {"server_rejected_busy_total", "Соединения, отклонённые сверх лимита сессий"},
+    {"server_rate_limited_total", "Паузы чтения сессий по лимиту скорости логина"},
+    {"server_shared_rings_total", "Кольца в разделяемой памяти, переданные клиентам"},
+    {"server_heap_allocations_total", "Выделения памяти в куче при обслуживании сессий (только в сборке ALLOC_STATS=1)"},
+};
+
+// Границы гистограмм для экспорта: степени двойки наносекунд от ~1 мкс
+// до ~17 с; они совпадают с границами внутренних корзин
+constexpr size_t kFirstExportPower = 10;
+constexpr size_t kLastExportPower = 34;
+
+struct Snapshot {
+    uint64_t buckets[kPhases][kBuckets] = {};
+    uint64_t sum_ns[kPhases] = {};
+    uint64_t counters[kCounters] = {};
+};
+
+void collect(Snapshot& snap) {
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+    for (const auto& block : g_blocks) {
+        for (size_t p = 0; p < kPhases; p++) {
+            for (size_t b = 0; b < kBuckets; b++) {
+                snap.buckets[p][b] += block->buckets[p][b].load(std::memory_order_relaxed);
+            }
+            snap.sum_ns[p] += block->sum_ns[p].load(std::memory_order_relaxed);
+        }
+        for (size_t c = 0; c < kCounters; c++) {
+            snap.counters[c] += block->counters[c].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+uint64_t quantile(const uint64_t* buckets, uint64_t count, double q) {
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < kBuckets; b++) {
+        seen += buckets[b];
+        if (seen >= rank) return bucketUpper(b);
+    }
+    return bucketUpper(kBuckets - 1);
+}
+
+void append(std::string& out, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+void append(std::string& out, const char* fmt, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (len > 0) out.append(line, std::min(static_cast<size_t>(len), sizeof(line) - 1));
+}
+
+bool sendAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+}
+
+ThreadBlock* registerThread() {
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+    g_blocks.push_back(std::make_unique<ThreadBlock>());
+    return g_blocks.back().get();
+}
+
+std::string render() {
+    auto snap = std::make_unique<Snapshot>();
+    collect(*snap);
+
+    std::string out;
+    for (size_t c = 0; c < kCounters; c++) {
+        append(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", kCounterInfo[c].name, kCounterInfo[c].help,
+               kCounterInfo[c].name, kCounterInfo[c].name, static_cast<unsigned long long>(snap->counters[c]));
+    }
+
+    out += "# HELP server_phase_seconds Длительность фаз сессии\n# TYPE server_phase_seconds histogram\n";
+    for (size_t p = 0; p < kPhases; p++) {
+        const uint64_t* buckets = snap->buckets[p];
+        uint64_t cumulative = 0;
+        size_t b = 0;
+        for (size_t power = kFirstExportPower; power <= kLastExportPower; power++) {
+            uint64_t limit = uint64_t(1) << power;
+            for (; b < kBuckets && bucketUpper(b) < limit; b++) cumulative += buckets[b];
+            append(out, "server_phase_seconds_bucket{phase=\"%s\",le=\"%.9g\"} %llu\n", kPhaseNames[p],
+                   static_cast<double>(limit) / 1e9, static_cast<unsigned long long>(cumulative));
+        }
+        for (; b < kBuckets; b++) cumulative += buckets[b];
+        append(out, "server_phase_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %llu\n", kPhaseNames[p],
+               static_cast<unsigned long long>(cumulative));
+        append(out, "server_phase_seconds_sum{phase=\"%s\"} %.9f\n", kPhaseNames[p],
+               static_cast<double>(snap->sum_ns[p]) / 1e9);
+        append(out, "server_phase_seconds_count{phase=\"%s\"} %llu\n", kPhaseNames[p],
+               static_cast<unsigned long long>(cumulative));
+    }
+
+    out += "# HELP server_phase_quantile_seconds Квантили длительности фаз по внутренним корзинам\n"
+           "# TYPE server_phase_quantile_seconds gauge\n";
+    for (size_t p = 0; p < kPhases; p++) {
+        uint64_t count = 0;
+        for (size_t b = 0; b < kBuckets; b++) count += snap->buckets[p][b];
+        if (count == 0) continue;
+        for (double q : {0.5, 0.99, 0.999}) {
+            append(out, "server_phase_quantile_seconds{phase=\"%s\",quantile=\"%g\"} %.9g\n", kPhaseNames[p], q,
+                   static_cast<double>(quantile(snap->buckets[p], count, q)) / 1e9);
+        }
+    }
+    return out;
+}
+
+Endpoint::~Endpoint() {
+    close();
+}
+
+bool Endpoint::open(const std::string& where, int fd) {
+    bool is_port = !where.empty() && where.find_first_not_of("0123456789") == std::string::npos;
+    if (fd >= 0) {
+        listen_fd_ = fd;
+        if (!is_port) unix_path_ = where;
+    } else if (is_port) {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) return false;
+        int opt = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(std::stoi(where)));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            close();
+            return false;
+        }
+    } else {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (where.size() >= sizeof(addr.sun_path)) return false;
+        memcpy(addr.sun_path, where.c_str(), where.size() + 1);
+        listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) return false;
+        unlink(where.c_str());
+        if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            close();
+            return false;
+        }
+        unix_path_ = where;
+    }
+
+    // При передаче сервера сокет какое-то время общий для двух процессов:
+    // соединение, о котором сообщил poll, может забрать другой, и accept
+    // не должен блокировать поток
+    fcntl(listen_fd_, F_SETFL, fcntl(listen_fd_, F_GETFL) | O_NONBLOCK);
+    wake_fd_ = eventfd(0, EFD_CLOEXEC);
+    if (listen(listen_fd_, 16) < 0 || wake_fd_ < 0) {
+        close();
+        return false;
+    }
+    thread_ = std::thread(&Endpoint::serve, this);
+    return true;
+}
+
+void Endpoint::close() {
+    if (thread_.joinable()) {
+        uint64_t one = 1;
+        ssize_t n = write(wake_fd_, &one, sizeof(one));
+        (void)n;
+        thread_.join();
+    }
+    if (listen_fd_ != -1) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+    if (wake_fd_ != -1) {
+        ::close(wake_fd_);
+        wake_fd_ = -1;
+    }
+    if (!unix_path_.empty()) {
+        unlink(unix_path_.c_str());
+        unix_path_.clear();
+    }
+}
+
+void Endpoint::handOff() {
+    unix_path_.clear();
+    close();
+}
+
+void Endpoint::serve() {
+    pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[1].revents) return;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        int client = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) continue;
+
+        // Запрос читается, если он приходит сразу; клиенты вроде nc -U
+        // ничего не присылают и получают текст без заголовков
+        char request[1024];
+        ssize_t len = 0;
+        pollfd in = {client, POLLIN, 0};
+        if (poll(&in, 1, 100) > 0) {
+            len = recv(client, request, sizeof(request), MSG_DONTWAIT);
+        }
+        timeval timeout = {1, 0};
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        std::string body = render();
+        if (len >= 3 && memcmp(request, "GET", 3) == 0) {
+            std::string header = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                 "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+            sendAll(client, header.data(), header.size());
+        }
+        sendAll(client, body.data(), body.size());
+        ::close(client);
+    }
+}
+
+}
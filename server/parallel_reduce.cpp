@@ -0,0 +1,99 @@
+#include "parallel_reduce.h"
+
+#include <algorithm>
+
+ParallelReducer::ParallelReducer(WorkerPool& pool) : pool_(pool) {}
+
+ParallelReducer::~ParallelReducer() {
+    waitAll();
+}
+
+void ParallelReducer::begin(Kind kind, uint64_t size) {
+    // Сессия может закрыться посреди вектора: его блоки должны досчитаться
+    // до того, как результаты будут переразмечены
+    waitAll();
+    kind_ = kind;
+    partials_.assign(static_cast<size_t>((size + kBlockElements - 1) / kBlockElements), Partial());
+    next_index_ = 0;
+    fill_ = 0;
+    if (!current_) current_ = acquire();
+}
+
+void ParallelReducer::commit(size_t n) {
+    fill_ += n;
+    if (fill_ == kBlockElements) submit();
+}
+
+void ParallelReducer::finish(int64_t& wrapped, reduce::Sum& sum, reduce::Stats& stats) {
+    if (fill_ > 0) submit();
+    waitAll();
+
+    // Попарное объединение: на каждом уровне блок i поглощает блок
+    // i + stride, и порядок не зависит от того, какой поток закончил первым
+    size_t count = partials_.size();
+    for (size_t stride = 1; stride < count; stride *= 2) {
+        for (size_t i = 0; i + stride < count; i += 2 * stride) {
+            Partial& left = partials_[i];
+            const Partial& right = partials_[i + stride];
+            left.wrapped = static_cast<int64_t>(static_cast<uint64_t>(left.wrapped) +
+                                                static_cast<uint64_t>(right.wrapped));
+            left.sum.merge(right.sum);
+            left.stats.merge(right.stats);
+        }
+    }
+    Partial total = count ? partials_[0] : Partial();
+    wrapped = total.wrapped;
+    sum = total.sum;
+    stats = total.stats;
+}
+
+void ParallelReducer::submit() {
+    Block* block = current_;
+    block->index = next_index_++;
+    block->n = fill_;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        outstanding_++;
+    }
+    pool_.submit([this, block] { reduceBlock(block); });
+    current_ = acquire();
+    fill_ = 0;
+}
+
+void ParallelReducer::reduceBlock(Block* block) {
+    Partial partial;
+    const int64_t* data = block->data.get();
+    switch (kind_) {
+    case Kind::Wrapped:       partial.wrapped = reduce::sumWrapped(data, block->n); break;
+    case Kind::Exact:         reduce::accumulate(partial.sum, data, block->n); break;
+    case Kind::Stats:         reduce::accumulateStats(partial.stats, data, block->n, false); break;
+    case Kind::StatsVariance: reduce::accumulateStats(partial.stats, data, block->n, true); break;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        partials_[block->index] = partial;
+        free_.push_back(block);
+        outstanding_--;
+    }
+    done_.notify_one();
+}
+
+ParallelReducer::Block* ParallelReducer::acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    size_t limit = std::min(pool_.size() + 1, kMaxBlocks);
+    if (free_.empty() && blocks_.size() < limit) {
+        blocks_.push_back(std::make_unique<Block>());
+        blocks_.back()->data.reset(new int64_t[kBlockElements]);
+        return blocks_.back().get();
+    }
+    // Блокирует поток сессии (без -t — реактор) до свёртки одного блока
+    done_.wait(lock, [this] { return !free_.empty(); });
+    Block* block = free_.back();
+    free_.pop_back();
+    return block;
+}
+
+void ParallelReducer::waitAll() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return outstanding_ == 0; });
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "reduce.h"
+#include "worker_pool.h"
+
+// Параллельная свёртка одного большого вектора.
+//
+// Сессия копирует принятые элементы в блоки фиксированного размера (блок
+// помещается в L2) и отдаёт каждый заполненный блок пулу, а сама тем
+// временем принимает следующие. Границы блоков отсчитываются от начала
+// вектора и не зависят от того, какими порциями пришли данные; частичные
+// результаты блоков объединяются попарно по фиксированному дереву. Поэтому
+// результат не зависит ни от сети, ни от числа потоков: целочисленные
+// поля совпадают с последовательной свёрткой, а дисперсия для одного и
+// того же вектора всегда одна и та же.
+//
+// Блоков в работе не больше, чем потоков пула плюс заполняемый; когда все
+// заняты, сессия ждёт освобождения — так память на сессию ограничена.
+//
+// Ожидание (commit при занятых блоках, begin и finish) блокирует поток,
+// обслуживающий сессию: без -t, а также с -R и -U это поток реактора, и
+// остальные его сессии стоят — в commit до свёртки одного блока пулом, в
+// finish до конца свёртки хвоста вектора. С -t ждёт рабочий поток.
+class ParallelReducer {
+public:
+    static constexpr size_t kBlockElements = 32 * 1024;   // 256 КиБ
+    static constexpr size_t kMaxBlocks = 16;
+
+    enum class Kind { Wrapped, Exact, Stats, StatsVariance };
+
+    explicit ParallelReducer(WorkerPool& pool);
+    // Дожидается блоков, ещё находящихся в пуле
+    ~ParallelReducer();
+    ParallelReducer(const ParallelReducer&) = delete;
+    ParallelReducer& operator=(const ParallelReducer&) = delete;
+
+    // Начинает вектор из size элементов
+    void begin(Kind kind, uint64_t size);
+    // Место под следующие элементы (little-endian): не больше room() штук
+    char* fillPtr() { return reinterpret_cast<char*>(current_->data.get()) + fill_ * sizeof(int64_t); }
+    size_t room() const { return kBlockElements - fill_; }
+    // Принимает n записанных элементов; заполненный блок уходит в пул
+    void commit(size_t n);
+    // Отправляет неполный блок, дожидается всех и объединяет результаты;
+    // заполняется поле, соответствующее виду свёртки
+    void finish(int64_t& wrapped, reduce::Sum& sum, reduce::Stats& stats);
+
+private:
+    struct Block {
+        std::unique_ptr<int64_t[]> data;
+        size_t index = 0;
+        size_t n = 0;
+    };
+    // Частичный результат блока; используется поле вида свёртки
+    struct Partial {
+        int64_t wrapped = 0;
+        reduce::Sum sum;
+        reduce::Stats stats;
+    };
+
+    WorkerPool& pool_;
+    Kind kind_ = Kind::Wrapped;
+    std::vector<std::unique_ptr<Block>> blocks_;
+    std::vector<Partial> partials_;
+    size_t next_index_ = 0;
+    Block* current_ = nullptr;
+    size_t fill_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable done_;
+    std::vector<Block*> free_;
+    size_t outstanding_ = 0;
+
+    void submit();
+    void reduceBlock(Block* block);
+    Block* acquire();
+    void waitAll();
+};
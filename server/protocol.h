@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Константы протокола обмена с клиентом (общие для сервера и клиентов).
+//
+// Пакет векторов начинается со слова количества (uint32 little-endian):
+// младшие 24 бита — число векторов, старшие 8 бит — флаги пакета.
+// Клиенты, не знающие о флагах, присылают их нулевыми.
+namespace proto {
+
+constexpr uint32_t kCountMask = 0x00FFFFFF;
+constexpr uint32_t kFlagsMask = 0xFF000000;
+
+// Все результаты пакета отправляются одним кадром:
+// uint32 количество + по результату (8 байт или запись kFlagOps) на вектор
+constexpr uint32_t kFlagFramedReply = 0x80000000;
+
+// За словом количества следует uint32 (LE) — маска операций kOp* для всех
+// векторов пакета. Вместо среднего на каждый вектор отправляется запись
+// с запрошенными полями в порядке возрастания битов маски.
+constexpr uint32_t kFlagOps = 0x40000000;
+
+// После пакета сессия остаётся открытой для следующего (keep-alive).
+// Следующие пакеты можно отправлять, не дожидаясь результатов: ответы
+// приходят в порядке пакетов. Пакет без флага — последний в сессии;
+// слово количества 0 после пакета с флагом завершает сессию без ответа.
+constexpr uint32_t kFlagKeepAlive = 0x20000000;
+
+constexpr uint32_t kKnownFlags = kFlagFramedReply | kFlagOps | kFlagKeepAlive;
+
+// Операции и поля записи ответа (все little-endian):
+constexpr uint32_t kOpSum       = 0x01;  // int128, 16 байт: точная сумма
+constexpr uint32_t kOpMean      = 0x02;  // int64: среднее, как в обычном ответе
+constexpr uint32_t kOpMin       = 0x04;  // int64
+constexpr uint32_t kOpMax       = 0x08;  // int64
+constexpr uint32_t kOpVariance  = 0x10;  // double: дисперсия генеральной совокупности
+constexpr uint32_t kOpStddev    = 0x20;  // double: стандартное отклонение
+constexpr uint32_t kOpNegatives = 0x40;  // uint64: число отрицательных элементов
+
+constexpr uint32_t kKnownOps = 0x7F;
+
+// Для пустого вектора все поля записи нулевые
+constexpr size_t recordSize(uint32_t ops) {
+    return (ops & kOpSum ? 16 : 0) + 8 * __builtin_popcount(ops & kKnownOps & ~kOpSum);
+}
+
+// Компактное кодирование данных векторов. Клиент запрашивает его суффиксом
+// 'Z' сообщения аутентификации; сервер без поддержки отвечает на такое
+// сообщение "ERR", и клиент может переподключиться без суффикса.
+//
+// В такой сессии за размером вектора вместо size * 8 байт идут блоки по
+// kBlockSize элементов (последний короче). Первый байт блока — способ:
+//   0..64             FOR: zigzag-varint base, затем (x - base) по w бит;
+//   kBlockDelta | w   то же для разностей соседних элементов;
+//   kBlockVarint      каждый элемент — zigzag-varint;
+//   kBlockDeltaVarint каждая разность — zigzag-varint.
+// Разность первого элемента вектора берётся от 0. Биты упаковываются от
+// младших к старшим, вся арифметика — по модулю 2^64.
+constexpr uint32_t kBlockSize = 128;
+constexpr uint8_t kBlockDelta = 0x80;
+constexpr uint8_t kBlockDeltaVarint = 0xFE;
+constexpr uint8_t kBlockVarint = 0xFF;
+constexpr uint8_t kMaxBlockWidth = 64;
+
+}
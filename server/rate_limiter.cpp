@@ -0,0 +1,48 @@
+#include "rate_limiter.h"
+
+#include <algorithm>
+#include <cmath>
+
+void RateLimiter::configure(double vectors_per_sec, double bytes_per_sec) {
+    vectors_per_sec_ = vectors_per_sec;
+    bytes_per_sec_ = bytes_per_sec;
+}
+
+RateLimiter::Bucket* RateLimiter::bucket(std::string_view login) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = buckets_.find(std::string(login));
+    if (it != buckets_.end()) return it->second.get();
+
+    // Новый логин начинает с полным ведром
+    auto bucket = std::make_unique<Bucket>();
+    bucket->vectors = vectors_per_sec_;
+    bucket->bytes = bytes_per_sec_;
+    Bucket* result = bucket.get();
+    buckets_.emplace(std::string(login), std::move(bucket));
+    return result;
+}
+
+uint64_t RateLimiter::take(Bucket& bucket, uint64_t vectors, uint64_t bytes, uint64_t now_ns) const {
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    if (bucket.refilled_ns == 0) bucket.refilled_ns = now_ns;
+    if (now_ns > bucket.refilled_ns) {
+        double elapsed = static_cast<double>(now_ns - bucket.refilled_ns) / 1e9;
+        bucket.vectors = std::min(vectors_per_sec_, bucket.vectors + elapsed * vectors_per_sec_);
+        bucket.bytes = std::min(bytes_per_sec_, bucket.bytes + elapsed * bytes_per_sec_);
+        bucket.refilled_ns = now_ns;
+    }
+
+    double need_vectors = std::min(static_cast<double>(vectors), vectors_per_sec_);
+    double need_bytes = std::min(static_cast<double>(bytes), bytes_per_sec_);
+    double wait = 0;
+    if (vectors_per_sec_ > 0 && bucket.vectors < need_vectors) {
+        wait = (need_vectors - bucket.vectors) / vectors_per_sec_;
+    }
+    if (bytes_per_sec_ > 0 && bucket.bytes < need_bytes) {
+        wait = std::max(wait, (need_bytes - bucket.bytes) / bytes_per_sec_);
+    }
+    if (wait > 0) return static_cast<uint64_t>(std::ceil(wait * 1e9));
+    if (vectors_per_sec_ > 0) bucket.vectors -= need_vectors;
+    if (bytes_per_sec_ > 0) bucket.bytes -= need_bytes;
+    return 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Ограничение скорости по логину: два ведра токенов — векторы и байты
+// данных векторов в секунду. Ёмкость ведра — секунда лимита, поэтому
+// кратковременный всплеск до этого объёма проходит без задержки, а сверх
+// него сессия приостанавливает чтение до пополнения ведра.
+//
+// Ведро логина создаётся при первой аутентификации и живёт до конца
+// работы сервера; сессия получает указатель на него один раз и дальше
+// обращается к нему без поиска. У каждого ведра своя блокировка, так что
+// разные логины не конкурируют друг с другом.
+class RateLimiter {
+public:
+    struct Bucket {
+        std::mutex mutex;
+        double vectors = 0;
+        double bytes = 0;
+        uint64_t refilled_ns = 0;
+    };
+
+    // 0 — без ограничения по соответствующей величине
+    void configure(double vectors_per_sec, double bytes_per_sec);
+    bool enabled() const { return vectors_per_sec_ > 0 || bytes_per_sec_ > 0; }
+
+    // Ведро логина (создаётся при первом обращении)
+    Bucket* bucket(std::string_view login);
+
+    // Списывает токены, если их хватает, и возвращает 0; иначе ничего не
+    // меняет и возвращает, сколько наносекунд ждать пополнения. Запрос
+    // больше ёмкости ведра стоит целое ведро, иначе он не прошёл бы никогда
+    uint64_t take(Bucket& bucket, uint64_t vectors, uint64_t bytes, uint64_t now_ns) const;
+
+private:
+    double vectors_per_sec_ = 0;
+    double bytes_per_sec_ = 0;
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::unique_ptr<Bucket>> buckets_;
+};
@@ -0,0 +1,414 @@
+#include "reduce.h"
+
+#include <atomic>
+#include <cstring>
+#include <endian.h>
+
+#if defined(__x86_64__) && __BYTE_ORDER == __LITTLE_ENDIAN
+#include <immintrin.h>
+#define REDUCE_HAVE_X86 1
+#endif
+
+namespace reduce {
+
+namespace {
+
+// Половины 32-битных частей суммируются в uint64 без переполнения,
+// пока в блоке не больше 2^32 - 1 элементов
+constexpr size_t kMaxBlock = 0xFFFFFFFFu;
+
+inline int64_t loadLE(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return static_cast<int64_t>(le64toh(v));
+}
+
+// Сборка точной суммы из сумм младших и старших 32-битных половин:
+// x = lo + hi * 2^32 - (x < 0 ? 2^64 : 0)
+inline int128_t combine(uint64_t lo, uint64_t hi, uint64_t neg) {
+    return static_cast<int128_t>(lo) + (static_cast<int128_t>(hi) << 32) - (static_cast<int128_t>(neg) << 64);
+}
+
+int64_t sumWrappedPortable(const unsigned char* p, size_t n) {
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += static_cast<uint64_t>(loadLE(p + 8 * i));
+        s1 += static_cast<uint64_t>(loadLE(p + 8 * i + 8));
+        s2 += static_cast<uint64_t>(loadLE(p + 8 * i + 16));
+        s3 += static_cast<uint64_t>(loadLE(p + 8 * i + 24));
+    }
+    for (; i < n; i++) {
+        s0 += static_cast<uint64_t>(loadLE(p + 8 * i));
+    }
+    return static_cast<int64_t>(s0 + s1 + s2 + s3);
+}
+
+void accumulatePortable(Sum& acc, const unsigned char* p, size_t n) {
+    acc.count += n;
+    while (n > 0) {
+        size_t block = n < kMaxBlock ? n : kMaxBlock;
+        uint64_t lo = 0, hi = 0, neg = 0;
+        for (size_t i = 0; i < block; i++) {
+            uint64_t v = static_cast<uint64_t>(loadLE(p + 8 * i));
+            lo += v & 0xFFFFFFFFu;
+            hi += v >> 32;
+            neg += v >> 63;
+        }
+        acc.total += combine(lo, hi, neg);
+        acc.negatives += neg;
+        p += 8 * block;
+        n -= block;
+    }
+}
+
+// Точная сумма вместе с минимумом и максимумом за один проход
+void statsPortable(Stats& acc, const unsigned char* p, size_t n) {
+    acc.sum.count += n;
+    while (n > 0) {
+        size_t block = n < kMaxBlock ? n : kMaxBlock;
+        uint64_t lo = 0, hi = 0, neg = 0;
+        int64_t mn = acc.min, mx = acc.max;
+        for (size_t i = 0; i < block; i++) {
+            int64_t x = loadLE(p + 8 * i);
+            uint64_t v = static_cast<uint64_t>(x);
+            lo += v & 0xFFFFFFFFu;
+            hi += v >> 32;
+            neg += v >> 63;
+            mn = x < mn ? x : mn;
+            mx = x > mx ? x : mx;
+        }
+        acc.sum.total += combine(lo, hi, neg);
+        acc.sum.negatives += neg;
+        acc.min = mn;
+        acc.max = mx;
+        p += 8 * block;
+        n -= block;
+    }
+}
+
+// Сумма квадратов отклонений от mean
+double sqDevPortable(const unsigned char* p, size_t n, double mean) {
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        double d0 = static_cast<double>(loadLE(p + 8 * i)) - mean;
+        double d1 = static_cast<double>(loadLE(p + 8 * i + 8)) - mean;
+        double d2 = static_cast<double>(loadLE(p + 8 * i + 16)) - mean;
+        double d3 = static_cast<double>(loadLE(p + 8 * i + 24)) - mean;
+        s0 += d0 * d0;
+        s1 += d1 * d1;
+        s2 += d2 * d2;
+        s3 += d3 * d3;
+    }
+    for (; i < n; i++) {
+        double d = static_cast<double>(loadLE(p + 8 * i)) - mean;
+        s0 += d * d;
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+#ifdef REDUCE_HAVE_X86
+
+__attribute__((target("avx2")))
+uint64_t hsum256(__m256i v) {
+    __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(s)) + static_cast<uint64_t>(_mm_extract_epi64(s, 1));
+}
+
+__attribute__((target("avx2")))
+int64_t sumWrappedAvx2(const unsigned char* p, size_t n) {
+    __m256i a0 = _mm256_setzero_si256(), a1 = a0, a2 = a0, a3 = a0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        a0 = _mm256_add_epi64(a0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 8 * i)));
+        a1 = _mm256_add_epi64(a1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 8 * i + 32)));
+        a2 = _mm256_add_epi64(a2, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 8 * i + 64)));
+        a3 = _mm256_add_epi64(a3, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 8 * i + 96)));
+    }
+    a0 = _mm256_add_epi64(_mm256_add_epi64(a0, a1), _mm256_add_epi64(a2, a3));
+    return static_cast<int64_t>(hsum256(a0) + static_cast<uint64_t>(sumWrappedPortable(p + 8 * i, n - i)));
+}
+
+__attribute__((target("avx2")))
+void accumulateAvx2(Sum& acc, const unsigned char* p, size_t n) {
+    const __m256i mask = _mm256_set1_epi64x(0xFFFFFFFF);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t vec_n = n & ~static_cast<size_t>(7);
+    size_t done = 0;
+    while (done < vec_n) {
+        // 4 полосы по kMaxBlock / 4 элементов каждая не переполняются
+        size_t block = vec_n - done < (kMaxBlock & ~static_cast<size_t>(7)) 
+            ? vec_n - done : (kMaxBlock & ~static_cast<size_t>(7));
+        __m256i lo0 = zero, lo1 = zero, hi0 = zero, hi1 = zero, ng0 = zero, ng1 = zero;
+        const unsigned char* q = p + 8 * done;
+        for (size_t i = 0; i < block; i += 8) {
+            __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q + 8 * i));
+            __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q + 8 * i + 32));
+            lo0 = _mm256_add_epi64(lo0, _mm256_and_si256(v0, mask));
+            lo1 = _mm256_add_epi64(lo1, _mm256_and_si256(v1, mask));
+            hi0 = _mm256_add_epi64(hi0, _mm256_srli_epi64(v0, 32));
+            hi1 = _mm256_add_epi64(hi1, _mm256_srli_epi64(v1, 32));
+            ng0 = _mm256_add_epi64(ng0, _mm256_srli_epi64(v0, 63));
+            ng1 = _mm256_add_epi64(ng1, _mm256_srli_epi64(v1, 63));
+        }
+        uint64_t neg = hsum256(_mm256_add_epi64(ng0, ng1));
+        acc.total += combine(hsum256(_mm256_add_epi64(lo0, lo1)), hsum256(_mm256_add_epi64(hi0, hi1)), neg);
+        acc.negatives += neg;
+        acc.count += block;
+        done += block;
+    }
+    accumulatePortable(acc, p + 8 * done, n - done);
+}
+
+__attribute__((target("avx2")))
+void statsAvx2(Stats& acc, const unsigned char* p, size_t n) {
+    const __m256i mask = _mm256_set1_epi64x(0xFFFFFFFF);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t vec_n = n & ~static_cast<size_t>(7);
+    size_t done = 0;
+    while (done < vec_n) {
+        size_t block = vec_n - done < (kMaxBlock & ~static_cast<size_t>(7)) 
+            ? vec_n - done : (kMaxBlock & ~static_cast<size_t>(7));
+        __m256i lo0 = zero, lo1 = zero, hi0 = zero, hi1 = zero, ng0 = zero, ng1 = zero;
+        __m256i mn0 = _mm256_set1_epi64x(acc.min), mn1 = mn0;
+        __m256i mx0 = _mm256_set1_epi64x(acc.max), mx1 = mx0;
+        const unsigned char* q = p + 8 * done;
+        for (size_t i = 0; i < block; i += 8) {
+            __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q + 8 * i));
+            __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q + 8 * i + 32));
+            lo0 = _mm256_add_epi64(lo0, _mm256_and_si256(v0, mask));
+            lo1 = _mm256_add_epi64(lo1, _mm256_and_si256(v1, mask));
+            hi0 = _mm256_add_epi64(hi0, _mm256_srli_epi64(v0, 32));
+            hi1 = _mm256_add_epi64(hi1, _mm256_srli_epi64(v1, 32));
+            ng0 = _mm256_add_epi64(ng0, _mm256_srli_epi64(v0, 63));
+            ng1 = _mm256_add_epi64(ng1, _mm256_srli_epi64(v1, 63));
+            // В AVX2 нет min/max для int64: выбор по результату сравнения
+            mn0 = _mm256_blendv_epi8(mn0, v0, _mm256_cmpgt_epi64(mn0, v0));
+            mn1 = _mm256_blendv_epi8(mn1, v1, _mm256_cmpgt_epi64(mn1, v1));
+            mx0 = _mm256_blendv_epi8(mx0, v0, _mm256_cmpgt_epi64(v0, mx0));
+            mx1 = _mm256_blendv_epi8(mx1, v1, _mm256_cmpgt_epi64(v1, mx1));
+        }
+        uint64_t neg = hsum256(_mm256_add_epi64(ng0, ng1));
+        acc.sum.total += combine(hsum256(_mm256_add_epi64(lo0, lo1)), hsum256(_mm256_add_epi64(hi0, hi1)), neg);
+        acc.sum.negatives += neg;
+        acc.sum.count += block;
+        alignas(32) int64_t lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), mn0);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes + 4), mn1);
+        for (int64_t v : lanes) acc.min = v < acc.min ? v : acc.min;
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), mx0);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes + 4), mx1);
+        for (int64_t v : lanes) acc.max = v > acc.max ? v : acc.max;
+        done += block;
+    }
+    statsPortable(acc, p + 8 * done, n - done);
+}
+
+// Горизонтальная сумма через память: _mm512_reduce_add_epi64, сдвиги и min/max без
+// маски в GCC 12 дают ложные предупреждения -Wmaybe-uninitialized
+__attribute__((target("avx512f")))
+uint64_t hsum512(__m512i v) {
+    alignas(64) uint64_t lanes[8];
+    _mm512_store_si512(lanes, v);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+}
+
+__attribute__((target("avx512f")))
+int64_t sumWrappedAvx512(const unsigned char* p, size_t n) {
+    __m512i a0 = _mm512_setzero_si512(), a1 = a0, a2 = a0, a3 = a0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        a0 = _mm512_add_epi64(a0, _mm512_loadu_si512(p + 8 * i));
+        a1 = _mm512_add_epi64(a1, _mm512_loadu_si512(p + 8 * i + 64));
+        a2 = _mm512_add_epi64(a2, _mm512_loadu_si512(p + 8 * i + 128));
+        a3 = _mm512_add_epi64(a3, _mm512_loadu_si512(p + 8 * i + 192));
+    }
+    a0 = _mm512_add_epi64(_mm512_add_epi64(a0, a1), _mm512_add_epi64(a2, a3));
+    return static_cast<int64_t>(hsum512(a0) + static_cast<uint64_t>(sumWrappedPortable(p + 8 * i, n - i)));
+}
+
+__attribute__((target("avx512f")))
+void accumulateAvx512(Sum& acc, const unsigned char* p, size_t n) {
+    const __m512i mask = _mm512_set1_epi64(0xFFFFFFFF);
+    const __m512i zero = _mm512_setzero_si512();
+    size_t vec_n = n & ~static_cast<size_t>(15);
+    size_t done = 0;
+    while (done < vec_n) {
+        size_t block = vec_n - done < (kMaxBlock & ~static_cast<size_t>(15)) 
+            ? vec_n - done : (kMaxBlock & ~static_cast<size_t>(15));
+        __m512i lo0 = zero, lo1 = zero, hi0 = zero, hi1 = zero;
+        uint64_t neg = 0;
+        const unsigned char* q = p + 8 * done;
+        for (size_t i = 0; i < block; i += 16) {
+            __m512i v0 = _mm512_loadu_si512(q + 8 * i);
+            __m512i v1 = _mm512_loadu_si512(q + 8 * i + 64);
+            lo0 = _mm512_add_epi64(lo0, _mm512_and_si512(v0, mask));
+            lo1 = _mm512_add_epi64(lo1, _mm512_and_si512(v1, mask));
+            hi0 = _mm512_add_epi64(hi0, _mm512_maskz_srli_epi64(0xFF, v0, 32));
+            hi1 = _mm512_add_epi64(hi1, _mm512_maskz_srli_epi64(0xFF, v1, 32));
+            neg += __builtin_popcount(_mm512_cmplt_epi64_mask(v0, zero)) +
+                   __builtin_popcount(_mm512_cmplt_epi64_mask(v1, zero));
+        }
+        uint64_t lo = hsum512(_mm512_add_epi64(lo0, lo1));
+        uint64_t hi = hsum512(_mm512_add_epi64(hi0, hi1));
+        acc.total += combine(lo, hi, neg);
+        acc.negatives += neg;
+        acc.count += block;
+        done += block;
+    }
+    accumulatePortable(acc, p + 8 * done, n - done);
+}
+
+__attribute__((target("avx512f")))
+void statsAvx512(Stats& acc, const unsigned char* p, size_t n) {
+    const __m512i mask = _mm512_set1_epi64(0xFFFFFFFF);
+    const __m512i zero = _mm512_setzero_si512();
+    size_t vec_n = n & ~static_cast<size_t>(15);
+    size_t done = 0;
+    while (done < vec_n) {
+        size_t block = vec_n - done < (kMaxBlock & ~static_cast<size_t>(15)) 
+            ? vec_n - done : (kMaxBlock & ~static_cast<size_t>(15));
+        __m512i lo0 = zero, lo1 = zero, hi0 = zero, hi1 = zero;
+        __m512i mn0 = _mm512_set1_epi64(acc.min), mn1 = mn0;
+        __m512i mx0 = _mm512_set1_epi64(acc.max), mx1 = mx0;
+        uint64_t neg = 0;
+        const unsigned char* q = p + 8 * done;
+        for (size_t i = 0; i < block; i += 16) {
+            __m512i v0 = _mm512_loadu_si512(q + 8 * i);
+            __m512i v1 = _mm512_loadu_si512(q + 8 * i + 64);
+            lo0 = _mm512_add_epi64(lo0, _mm512_and_si512(v0, mask));
+            lo1 = _mm512_add_epi64(lo1, _mm512_and_si512(v1, mask));
+            hi0 = _mm512_add_epi64(hi0, _mm512_maskz_srli_epi64(0xFF, v0, 32));
+            hi1 = _mm512_add_epi64(hi1, _mm512_maskz_srli_epi64(0xFF, v1, 32));
+            neg += __builtin_popcount(_mm512_cmplt_epi64_mask(v0, zero)) +
+                   __builtin_popcount(_mm512_cmplt_epi64_mask(v1, zero));
+            mn0 = _mm512_maskz_min_epi64(0xFF, mn0, v0);
+            mn1 = _mm512_maskz_min_epi64(0xFF, mn1, v1);
+            mx0 = _mm512_maskz_max_epi64(0xFF, mx0, v0);
+            mx1 = _mm512_maskz_max_epi64(0xFF, mx1, v1);
+        }
+        uint64_t lo = hsum512(_mm512_add_epi64(lo0, lo1));
+        uint64_t hi = hsum512(_mm512_add_epi64(hi0, hi1));
+        acc.sum.total += combine(lo, hi, neg);
+        acc.sum.negatives += neg;
+        acc.sum.count += block;
+        alignas(64) int64_t lanes[8];
+        _mm512_store_si512(lanes, _mm512_maskz_min_epi64(0xFF, mn0, mn1));
+        for (int64_t v : lanes) acc.min = v < acc.min ? v : acc.min;
+        _mm512_store_si512(lanes, _mm512_maskz_max_epi64(0xFF, mx0, mx1));
+        for (int64_t v : lanes) acc.max = v > acc.max ? v : acc.max;
+        done += block;
+    }
+    statsPortable(acc, p + 8 * done, n - done);
+}
+
+// Преобразование int64 -> double есть только в AVX-512DQ
+__attribute__((target("avx512f,avx512dq")))
+double sqDevAvx512(const unsigned char* p, size_t n, double mean) {
+    const __m512d m = _mm512_set1_pd(mean);
+    __m512d s0 = _mm512_setzero_pd(), s1 = s0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512d d0 = _mm512_sub_pd(_mm512_cvtepi64_pd(_mm512_loadu_si512(p + 8 * i)), m);
+        __m512d d1 = _mm512_sub_pd(_mm512_cvtepi64_pd(_mm512_loadu_si512(p + 8 * i + 64)), m);
+        s0 = _mm512_fmadd_pd(d0, d0, s0);
+        s1 = _mm512_fmadd_pd(d1, d1, s1);
+    }
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, _mm512_add_pd(s0, s1));
+    double total = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    return total + sqDevPortable(p + 8 * i, n - i, mean);
+}
+
+#endif
+
+struct Kernel {
+    const char* name;
+    int64_t (*sum_wrapped)(const unsigned char*, size_t);
+    void (*accumulate)(Sum&, const unsigned char*, size_t);
+    void (*stats)(Stats&, const unsigned char*, size_t);
+    double (*sq_dev)(const unsigned char*, size_t, double);
+};
+
+const Kernel kPortable = {"scalar", sumWrappedPortable, accumulatePortable, statsPortable, sqDevPortable};
+#ifdef REDUCE_HAVE_X86
+const Kernel kAvx2 = {"avx2", sumWrappedAvx2, accumulateAvx2, statsAvx2, sqDevPortable};
+const Kernel kAvx512 = {"avx512", sumWrappedAvx512, accumulateAvx512, statsAvx512, sqDevAvx512};
+#endif
+
+const Kernel* detect() {
+#ifdef REDUCE_HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) return &kAvx512;
+    if (__builtin_cpu_supports("avx2")) return &kAvx2;
+#endif
+    return &kPortable;
+}
+
+void accumulateStatsWith(const Kernel& k, Stats& acc, const unsigned char* p, size_t n, bool with_variance) {
+    if (n == 0) return;
+    Stats part;
+    k.stats(part, p, n);
+    if (with_variance) {
+        part.mean = static_cast<double>(part.sum.total) / static_cast<double>(n);
+        part.m2 = k.sq_dev(p, n, part.mean);
+    }
+    acc.merge(part);
+}
+
+std::atomic<const Kernel*> g_kernel{nullptr};
+
+const Kernel& kernel() {
+    const Kernel* k = g_kernel.load(std::memory_order_acquire);
+    if (!k) {
+        k = detect();
+        g_kernel.store(k, std::memory_order_release);
+    }
+    return *k;
+}
+
+}
+
+int64_t sumWrapped(const void* data, size_t n) {
+    return kernel().sum_wrapped(static_cast<const unsigned char*>(data), n);
+}
+
+void accumulate(Sum& acc, const void* data, size_t n) {
+    kernel().accumulate(acc, static_cast<const unsigned char*>(data), n);
+}
+
+void accumulateStats(Stats& acc, const void* data, size_t n, bool with_variance) {
+    accumulateStatsWith(kernel(), acc, static_cast<const unsigned char*>(data), n, with_variance);
+}
+
+int64_t sumWrappedScalar(const void* data, size_t n) {
+    return sumWrappedPortable(static_cast<const unsigned char*>(data), n);
+}
+
+void accumulateScalar(Sum& acc, const void* data, size_t n) {
+    accumulatePortable(acc, static_cast<const unsigned char*>(data), n);
+}
+
+void accumulateStatsScalar(Stats& acc, const void* data, size_t n, bool with_variance) {
+    accumulateStatsWith(kPortable, acc, static_cast<const unsigned char*>(data), n, with_variance);
+}
+
+const char* implementation() {
+    return kernel().name;
+}
+
+bool forceImplementation(const char* name) {
+    const Kernel* best = detect();
+    const Kernel* wanted = nullptr;
+    if (strcmp(name, "scalar") == 0) wanted = &kPortable;
+#ifdef REDUCE_HAVE_X86
+    if (strcmp(name, "avx2") == 0 && best != &kPortable) wanted = &kAvx2;
+    if (strcmp(name, "avx512") == 0 && best == &kAvx512) wanted = &kAvx512;
+#endif
+    if (!wanted) return false;
+    g_kernel.store(wanted, std::memory_order_release);
+    return true;
+}
+
+}
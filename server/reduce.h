@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Свёртка векторов int64, пришедших по сети в little-endian.
+// Перестановка байтов (на big-endian хостах) и суммирование выполняются
+// за один проход. Реализация (AVX-512, AVX2 или переносимая) выбирается
+// один раз при первом вызове по возможностям процессора.
+namespace reduce {
+
+__extension__ typedef __int128 int128_t;
+
+// Режим суммирования:
+//   Wrap    — сумма по модулю 2^64 (прежнее поведение);
+//   Checked — переполнение int64 считается ошибкой;
+//   Wide    — точная 128-битная сумма, среднее всегда корректно.
+enum class SumMode { Wrap, Checked, Wide };
+
+// Точная сумма произвольного числа элементов
+struct Sum {
+    int128_t total = 0;
+    uint64_t count = 0;
+    uint64_t negatives = 0;
+
+    void merge(const Sum& other) {
+        total += other.total;
+        count += other.count;
+        negatives += other.negatives;
+    }
+    bool fitsInt64() const {
+        return total >= INT64_MIN && total <= INT64_MAX;
+    }
+};
+
+// Статистики вектора: точная сумма, минимум, максимум, среднее и сумма
+// квадратов отклонений от него. Части вектора считаются независимо и
+// объединяются формулой Чана, поэтому данные читаются из сети один раз.
+struct Stats {
+    Sum sum;
+    int64_t min = INT64_MAX;
+    int64_t max = INT64_MIN;
+    double mean = 0;
+    double m2 = 0;
+
+    void merge(const Stats& other) {
+        if (other.sum.count == 0) return;
+        if (sum.count == 0) {
+            *this = other;
+            return;
+        }
+        double n1 = static_cast<double>(sum.count);
+        double n2 = static_cast<double>(other.sum.count);
+        double delta = other.mean - mean;
+        mean += delta * n2 / (n1 + n2);
+        m2 += other.m2 + delta * delta * n1 * n2 / (n1 + n2);
+        sum.merge(other.sum);
+        if (other.min < min) min = other.min;
+        if (other.max > max) max = other.max;
+    }
+    // Дисперсия генеральной совокупности
+    double variance() const { return sum.count ? m2 / static_cast<double>(sum.count) : 0; }
+    double stddev() const { return std::sqrt(variance()); }
+};
+
+// Сумма n элементов по модулю 2^64; data может быть не выровнен
+int64_t sumWrapped(const void* data, size_t n);
+// Добавляет n элементов к точной сумме
+void accumulate(Sum& acc, const void* data, size_t n);
+
+// Добавляет n элементов к статистикам за один проход по сумме, минимуму
+// и максимуму; with_variance добавляет второй проход по тем же (уже
+// находящимся в кэше) данным для суммы квадратов отклонений
+void accumulateStats(Stats& acc, const void* data, size_t n, bool with_variance);
+
+// Переносимые эталонные реализации
+int64_t sumWrappedScalar(const void* data, size_t n);
+void accumulateScalar(Sum& acc, const void* data, size_t n);
+void accumulateStatsScalar(Stats& acc, const void* data, size_t n, bool with_variance);
+
+// Имя выбранной реализации: "avx512", "avx2" или "scalar"
+const char* implementation();
+// Принудительный выбор реализации (для сравнения в бенчмарках);
+// false, если процессор её не поддерживает
+bool forceImplementation(const char* name);
+
+}
@@ -7,6 +7,10 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
+    if (server.snapshotOnly()) {
+        return 0;
+    }
+    
     if (!server.start()) {
         return 1;
     }
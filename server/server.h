@@ -7,71 +7,427 @@
 #include <ctime>
 #include <cstdint>
 #include <cstring>
-#include <unordered_map>
 #include <algorithm>
+#include <utility>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
-#include <openssl/sha.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <sched.h>
+#include <pthread.h>
+#include <signal.h>
+#include <cerrno>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <string_view>
 #include <iomanip>
+#include "alloc_stats.h"
+#include "auth.h"
+#include "capture.h"
+#include "client_db.h"
+#include "codec.h"
+#include "handoff.h"
+#include "logger.h"
+#include "metrics.h"
+#include "parallel_reduce.h"
+#include "protocol.h"
+#include "rate_limiter.h"
+#include "reduce.h"
+#include "shm_ring.h"
+#include "trace.h"
+#include "uring.h"
+#include "worker_pool.h"
 
-class Logger {
-    std::string log_file_;
-public:
-    Logger(const std::string& log_file = "") : log_file_(log_file) {}
-    void log(const std::string& msg, bool critical = false) const;
+// Фазы сессии со сроком: аутентификация (от приёма соединения), заголовок
+// (слово количества пакета или размер вектора, от первого его байта или
+// конца предыдущего вектора) и данные одного вектора
+enum class Deadline : uint8_t { Auth, Header, Payload, Count };
+
+struct Reactor;
+
+// Параметры обработки, общие для всех сессий сервера
+struct SessionConfig {
+    reduce::SumMode sum_mode = reduce::SumMode::Wrap;
+    uint32_t max_vector_size = 100000;     // 0 — без ограничения
+    uint32_t max_batch_vectors = 100;      // 0 — без ограничения
+    // Сроки фаз, нс; 0 — без срока
+    uint64_t deadline_ns[static_cast<size_t>(Deadline::Count)] = {
+        10ull * 1000000000, 10ull * 1000000000, 30ull * 1000000000};
+    RateLimiter* rate_limiter = nullptr;   // nullptr — без ограничения скорости
+    size_t ring_size = 1024 * 1024;        // кольцо для клиентов Unix-сокета, 0 — отключено
+    // Векторы от стольких элементов сворачиваются блоками в пуле reduce_pool
+    uint32_t parallel_threshold = 1u << 20;  // 0 — всегда последовательно
+    WorkerPool* reduce_pool = nullptr;
+    capture::Writer* capture = nullptr;    // nullptr — сессии не записываются
 };
 
-class ClientDB {
-    std::unordered_map<std::string, std::string> clients_;
+// Сессия клиента — возобновляемый автомат, управляемый событиями epoll.
+// Сокет неблокирующий: данные накапливаются во входном буфере, ответы —
+// в выходном, и каждая фаза протокола продолжается с того места, где
+// закончились доступные байты.
+class ClientSession {
+public:
+    enum class State { Auth, Count, Size, Payload, Closing, Closed };
+
+private:
+    // Входной буфер фиксированного размера: данные векторов сворачиваются
+    // прямо из него, поэтому память на сессию не зависит от размера векторов
+    static constexpr size_t kInBufSize = 64 * 1024;
+    // Ответы накапливаются и отправляются пачкой; при таком объёме
+    // неотправленных данных сессия перестаёт читать вход до EPOLLOUT
+    static constexpr size_t kOutBufSize = 16 * 1024;
+    static constexpr size_t kMaxAuthMsg = 1023;
+    static constexpr size_t kMinAuthMsg = AuthEngine::kMinMessage;
+    static_assert(kInBufSize >= codec::kMaxBlockBytes, "блок сжатых данных должен помещаться во входной буфер");
+
+    int sock_ = -1;
+    const AuthEngine& auth_;
+    Logger& logger_;
+    const SessionConfig& config_;
+    State state_ = State::Auth;
+
+    std::vector<char> in_;
+    // Начало входных данных: in_ или, после передачи кольца клиенту,
+    // позиция чтения в кольце; in_start_ и in_end_ отсчитываются от него
+    char* in_base_ = nullptr;
+    size_t in_start_ = 0;
+    size_t in_end_ = 0;
+    bool input_drained_ = false;
+    bool peer_closed_ = false;
+    bool external_io_ = false;
+    std::string out_;
+    size_t out_pos_ = 0;
+    bool frame_open_ = false;
+    size_t frame_start_ = 0;
+    bool output_blocked_ = false;
+    uint32_t pending_events_ = 0;
+
+    uint32_t num_vectors_ = 0;
+    uint32_t batch_flags_ = 0;
+    uint32_t vector_idx_ = 0;
+    uint32_t size_ = 0;
+    uint64_t remaining_ = 0;
+    bool compact_ = false;         // данные векторов в компактном кодировании
+    uint64_t prev_element_ = 0;    // опорный элемент разностного кодирования
+    int64_t wrapped_sum_ = 0;
+    reduce::Sum sum_;
+    bool parallel_vector_ = false; // текущий вектор сворачивается блоками в пуле
+    std::unique_ptr<ParallelReducer> parallel_;
+    uint32_t ops_ = 0;             // маска операций пакета (proto::kOp*)
+    bool keep_alive_ = false;      // после пакета ожидается следующий
+    // Время последней активности читает поток реактора (тайм-аут простоя)
+    std::atomic<uint64_t> last_active_ns_{0};
+    std::atomic<uint64_t> deadline_ns_{0};       // 0 — срока нет
+    std::atomic<Deadline> deadline_phase_{Deadline::Auth};
+    std::atomic<bool> expired_{false};
+    RateLimiter::Bucket* rate_bucket_ = nullptr;
+    // Пауза чтения по лимиту скорости: до этого момента вход не
+    // разбирается; 0 — паузы нет. Снимает её обход сессий реактора
+    std::atomic<uint64_t> paused_until_ns_{0};
+    std::atomic<bool> parked_{false};
+    reduce::Stats stats_;
+    // Отметки времени фаз для метрик, нс
+    uint64_t accepted_ns_ = 0;
+    uint64_t receive_start_ns_ = 0;
+    uint64_t compute_ns_ = 0;
+    uint64_t reply_start_ns_ = 0;
+    uint64_t allocations_ = 0;
+    Reactor* reactor_ = nullptr;
+    char login_[AuthEngine::kMaxLogin];
+    size_t login_len_ = 0;
+    char ticket_[AuthEngine::kMaxTicketHex];
+    std::unique_ptr<ShmRing> ring_;
+    uint64_t ring_tail_ = 0;       // прочитано из кольца (абсолютная позиция)
+    uint64_t ring_head_ = 0;       // последняя увиденная позиция записи клиента
+    uint32_t capture_id_ = 0;      // номер сессии в трассе, 0 — не записывается
+    bool capture_lost_ = false;
+
+    bool recvAvailable();
+    bool ringAvailable();
+    bool shareRing();
+    bool sendPending(bool more = false);
+    void outputFlushed();
+    size_t sendLimit() const { return frame_open_ ? frame_start_ : out_.size(); }
+    void queue(const void* buf, size_t len);
+    void captureBytes(capture::Kind kind, const char* data, size_t len) {
+        if (capture_id_ && !capture_lost_ && len > 0) {
+            capture_lost_ = !config_.capture->data(capture_id_, kind, data, len);
+        }
+    }
+    void fail(const std::string& msg);
+    void failOnEof();
+
+    bool auth(std::string_view message, AuthEngine::Request& request);
+    bool handleAuth();
+    bool handleCount();
+    bool handleSize();
+    bool handlePayload();
+    bool decodeAvailable();
+    void reduceChunk(const char* chunk, size_t n);
+    bool computeMean(int64_t& avg);
+    void finishVector(int64_t avg);
+    void finishStats(int64_t avg);
+    void nextVector();
+    void step();
+    void setDeadline(Deadline phase, uint64_t now);
+    void pause(uint64_t until);
+    bool resumeIfDue(uint64_t now);
+    void clearDeadline() { deadline_ns_.store(0, std::memory_order_relaxed); }
+
 public:
-    bool load(const std::string& filename);
-    bool auth(const std::string& login, const std::string& password) const;
-    bool authWithHash(const std::string& login, const std::string& received_hash, const std::string& salt) const;
-    size_t getClientCount() const { return clients_.size(); }
+    ClientSession(const AuthEngine& auth, Logger& logger, const SessionConfig& config);
+    ~ClientSession();
+    ClientSession(const ClientSession&) = delete;
+    ClientSession& operator=(const ClientSession&) = delete;
+
+    // Начало новой сессии на сокете, принятом реактором, и её завершение
+    // (закрытие сокета)
+    void open(int sock, Reactor& reactor);
+    void close();
+
+    // Обработка событий готовности сокета; false — сессия завершена
+    bool onEvent(uint32_t events);
+    int fd() const { return sock_; }
+    Reactor& reactor() const { return *reactor_; }
+    uint64_t lastActive() const { return last_active_ns_.load(std::memory_order_relaxed); }
+    uint64_t deadline() const { return deadline_ns_.load(std::memory_order_relaxed); }
+    Deadline deadlinePhase() const { return deadline_phase_.load(std::memory_order_relaxed); }
+    // Отмечает истечение тайм-аута или срока; true — только при первом вызове
+    bool expire() { return !expired_.exchange(true, std::memory_order_relaxed); }
+    bool wantsWrite() const { return out_pos_ < sendLimit(); }
+
+    // Пауза по лимиту скорости. Обработчик, оставивший сессию на паузе,
+    // отдаёт её обходу реактора (park) и больше её не взводит; обход
+    // забирает её (unpark — true только у одного вызывающего) и
+    // возобновляет, когда пауза истекла
+    bool paused() const { return pausedUntil() != 0; }
+    uint64_t pausedUntil() const { return paused_until_ns_.load(std::memory_order_relaxed); }
+    void park() { parked_.store(true, std::memory_order_release); }
+    bool parked() const { return parked_.load(std::memory_order_acquire); }
+    bool unpark() { return parked_.exchange(false, std::memory_order_acq_rel); }
+
+    // События, переданные реактором рабочему потоку (EPOLLONESHOT
+    // гарантирует, что сессию обрабатывает только один поток)
+    void setPendingEvents(uint32_t events) { pending_events_ = events; }
+    uint32_t pendingEvents() const { return pending_events_; }
+
+    // Ввод-вывод под управлением реактора (бэкенд io_uring): принятые
+    // данные передаются порциями через feed, а отправку диапазона
+    // pendingOutput выполняет реактор и подтверждает через outputSent.
+    // Пока отправка не подтверждена, новые данные не передаются — выходной
+    // буфер не должен перемещаться в памяти.
+    struct UringOps {
+        int pending_bid = -1;          // непоглощённый буфер приёма
+        uint32_t pending_offset = 0;
+        uint32_t pending_len = 0;
+        bool recv_armed = false;
+        bool send_inflight = false;
+        bool closing = false;
+        unsigned inflight = 0;         // операций в ядре, ссылающихся на сессию
+    };
+
+    void setExternalIo(bool external) { external_io_ = external; }
+    UringOps& uringOps() { return uring_ops_; }
+    // Поглощает данные, пока есть место во входном буфере и ответы не
+    // упираются в лимит; возвращает число поглощённых байт
+    size_t feed(const char* data, size_t len);
+    // Клиент закрыл соединение на запись
+    void endOfInput();
+    // Продолжает разбор входа после паузы по лимиту скорости
+    void resume();
+    std::string_view pendingOutput() const {
+        return std::string_view(out_.data() + out_pos_, sendLimit() - out_pos_);
+    }
+    void outputSent(size_t n);
+    bool wantsInput() const {
+        return state_ != State::Closing && state_ != State::Closed && !output_blocked_ && !peer_closed_ &&
+               !paused();
+    }
+    State state() const { return state_; }
+    // Дескриптор уже закрыт операцией io_uring
+    void forgetSocket() { sock_ = -1; }
+
+private:
+    UringOps uring_ops_;
 };
 
-class ClientSession {
-    int sock_;
-    ClientDB& db_;
+// Пул объектов сессий: закрытая сессия со своими буферами возвращается в
+// пул и переиспользуется следующим клиентом, поэтому в установившемся
+// режиме приём соединений не выделяет память
+class SessionPool {
+    const AuthEngine& auth_;
     Logger& logger_;
-    
-    bool sendAll(const void* buf, size_t len);
-    bool recvAll(void* buf, size_t len);
-    bool auth();
-    bool processVectors();
+    const SessionConfig& config_;
+    Reactor& reactor_;
+    std::mutex mutex_;
+    std::vector<ClientSession*> free_;
+    size_t max_idle_;
 
 public:
-    ClientSession(int sock, ClientDB& db, Logger& logger);
-    void run();
+    SessionPool(const AuthEngine& auth, Logger& logger, const SessionConfig& config, Reactor& reactor,
+                size_t max_idle = 1024);
+    ~SessionPool();
+    SessionPool(const SessionPool&) = delete;
+    SessionPool& operator=(const SessionPool&) = delete;
+
+    ClientSession* acquire(int sock);
+    void release(ClientSession* session);
+};
+
+// Реактор: слушающий сокет, epoll и сессии, принятые через этот сокет.
+// Обычно реактор один; в режиме шардов (-R) у каждого потока свой
+// реактор со своим сокетом SO_REUSEPORT, и соединение от приёма до
+// закрытия обслуживается одним потоком на одном ядре.
+struct Reactor {
+    int listen_fd = -1;
+    int unix_fd = -1;                          // Unix-сокет (только первый реактор)
+    int epoll_fd = -1;
+    int notify_fd = -1;                        // будит реактор после передачи сокетов
+    int cpu = -1;                              // -1 — без привязки
+    bool signals = false;                      // принимает сигналы
+    SessionPool session_pool;
+    std::vector<ClientSession*> sessions;      // по номеру дескриптора
+    std::mutex sessions_mutex;
+    std::vector<ClientSession*> resumed;       // сессии, снятые обходом с паузы
+    std::thread thread;
+
+    Reactor(const AuthEngine& auth, Logger& logger, const SessionConfig& config)
+        : session_pool(auth, logger, config, *this) {}
 };
 
 class Server {
+    static constexpr size_t kMaxEvents = 256;
+    static constexpr unsigned kUringEntries = 4096;
+    static constexpr unsigned kUringBuffers = 128;         // степень двойки
+    static constexpr size_t kUringBufferSize = 64 * 1024;
+
     std::string client_db_file_;
     std::string log_file_;
+    std::string snapshot_file_;
+    std::string metrics_endpoint_;
+    std::string capture_file_;
     std::string address_ = "127.0.0.1";
     int port_ = 33333;
+    std::string unix_path_;
+    int backlog_ = SOMAXCONN;
+    size_t threads_ = 1;
+    size_t shards_ = 0;
+    bool incoming_cpu_ = false;
+    bool io_uring_ = false;
+    uint64_t idle_timeout_ns_ = 60ull * 1000000000;   // 0 — без тайм-аута
+    size_t max_sessions_ = 0;                          // 0 — без ограничения
+    std::atomic<size_t> active_sessions_{0};
+    RateLimiter rate_limiter_;
+    Logger::Overflow log_overflow_ = Logger::Overflow::Block;
+    SessionConfig session_config_;
+    uint32_t ticket_lifetime_ = 300;
+    std::string handoff_path_;
+    uint64_t drain_timeout_ns_ = 30ull * 1000000000;   // 0 — ждать без ограничения
+    int handoff_fd_ = -1;                              // управляющий сокет для нового процесса
+    int handoff_conn_ = -1;                            // соединение с прежним процессом до подтверждения
+    handoff::Sockets inherited_;
+    std::thread handoff_thread_;
+    std::atomic<bool> handed_off_{false};
     ClientDB db_;
+    AuthEngine auth_{db_};
     Logger logger_;
-    int server_sock_ = -1;
-    bool running_ = false;
+    capture::Writer capture_;
+    int signal_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> running_{false};
+    bool stopped_ = false;
+    std::vector<std::unique_ptr<Reactor>> reactors_;
+    std::unique_ptr<WorkerPool> pool_;
+    std::unique_ptr<WorkerPool> reduce_pool_;
+    size_t reduce_threads_ = 0;                        // 0 — по числу ядер
+    std::thread reload_thread_;
+    std::atomic<bool> reloading_{false};
+    metrics::Endpoint metrics_;
 
     bool parseArgs(int argc, char* argv[]);
+    bool takeOver();
+    void serveHandoff();
+    void stopAccepting(Reactor& reactor, Uring* ring);
+    bool openListener(Reactor& reactor);
+    bool openUnixListener(Reactor& reactor);
+    bool setupReactor(Reactor& reactor, bool with_signals);
+    bool runReactor(Reactor& reactor);
+    bool runUringReactor(Reactor& reactor, Uring& ring);
+    void driveUring(Reactor& reactor, Uring& ring, ClientSession* session);
+    void teardownUring(Reactor& reactor, Uring& ring, ClientSession* session);
+    void releaseUring(Reactor& reactor, ClientSession* session);
+    uint64_t sweepPeriodNs() const;
+    bool admit(int fd);
+    void sweepSessions(Reactor& reactor, Uring* ring);
+    uint32_t sessionEvents(const ClientSession& session) const;
+    bool prepareClient(int fd, const sockaddr_storage& addr);
+    void acceptClients(Reactor& reactor, int listen_fd);
+    void handleSignals();
+    void reloadClients();
+    void handleSession(Reactor& reactor, ClientSession* session, uint32_t events);
+    void closeSession(Reactor& reactor, ClientSession* session);
 
     void printHelp() const {
-        std::cout << "Использование: ./server -d db.txt -LU log.txt -a 127.0.0.1 -p 33333" << std::endl;
+        std::cout << "Использование: ./server -d db.txt -LU log.txt -a 127.0.0.1 -p 33333 -t 4" << std::endl;
         std::cout << "Параметры:" << std::endl;
-        std::cout << "  -d <file>    Файл базы клиентов (обязательный)" << std::endl;
-        std::cout << "  -LU <file>   Файл логов (обязательный)" << std::endl;
+        std::cout << "  -d <file>    Файл базы клиентов или снимок KDB1 (обязательный)" << std::endl;
+        std::cout << "  -LU <file>   Файл логов (обязательный, кроме режима -S)" << std::endl;
+        std::cout << "  -LP <policy> При переполнении буфера логов: block (ждать) или drop (отбросить)" << std::endl;
         std::cout << "  -a <addr>    IP-адрес для привязки" << std::endl;
         std::cout << "  -p <port>    Порт для прослушивания" << std::endl;
+        std::cout << "  -u <path>    Дополнительно принимать соединения через Unix-сокет" << std::endl;
+        std::cout << "  -r <KiB>     Кольцо в разделяемой памяти для клиентов Unix-сокета, запросивших его" << std::endl;
+        std::cout << "               (по умолчанию 1024, степень двойки не меньше 64; 0 — отключить)" << std::endl;
+        std::cout << "  -s <mode>    Суммирование: wrap (по модулю 2^64), check (ошибка при переполнении)," << std::endl;
+        std::cout << "               wide (точная 128-битная сумма)" << std::endl;
+        std::cout << "  -n <size>    Максимальный размер вектора (по умолчанию 100000, 0 — без ограничения)" << std::endl;
+        std::cout << "  -m <count>   Максимальное число векторов в пакете (по умолчанию 100, 0 — без ограничения)" << std::endl;
+        std::cout << "  -k <sec>     Закрывать соединения без активности дольше заданного времени" << std::endl;
+        std::cout << "               (по умолчанию 60, 0 — не закрывать)" << std::endl;
+        std::cout << "  -D <a,h,p>   Сроки фаз сессии в секундах: аутентификация, заголовок, данные вектора" << std::endl;
+        std::cout << "               (по умолчанию 10,10,30; 0 — без срока)" << std::endl;
+        std::cout << "  -C <count>   Максимум одновременных сессий; сверх него соединение сразу" << std::endl;
+        std::cout << "               получает ERR и закрывается (по умолчанию 0 — без ограничения)" << std::endl;
+        std::cout << "  -q <v[,b]>   Лимит на логин: векторов и байт данных в секунду (0 — без ограничения);" << std::endl;
+        std::cout << "               сверх лимита сессия приостанавливает чтение" << std::endl;
+        std::cout << "  -t <threads> Количество рабочих потоков (по умолчанию 1)" << std::endl;
+        std::cout << "  -P <n[,thr]> Векторы от n элементов сворачивать параллельно блоками в пуле из thr" << std::endl;
+        std::cout << "               потоков (по умолчанию 1048576, потоков по числу ядер; 0 — отключить)" << std::endl;
+        std::cout << "               Ожидание пула занимает поток сессии: без -t это поток реактора" << std::endl;
+        std::cout << "  -R <shards>  Шарды: столько слушающих сокетов SO_REUSEPORT, каждый в своём потоке," << std::endl;
+        std::cout << "               привязанном к ядру (вместо -t)" << std::endl;
+        std::cout << "  -I           В режиме шардов выбирать сокет по ядру приёма пакетов (SO_INCOMING_CPU)" << std::endl;
+        std::cout << "  -B <backlog> Длина очереди ожидающих соединений (по умолчанию SOMAXCONN)" << std::endl;
+        std::cout << "  -U           Ввод-вывод через io_uring (при недоступности — epoll; -t не используется)" << std::endl;
+        std::cout << "  -T <sec>     Срок действия билетов возобновления (по умолчанию 300, 0 — отключить)" << std::endl;
+        std::cout << "  -v <level>   Уровень трассировки: trace, debug, info, warn, crit, off" << std::endl;
+        std::cout << "  -S <file>    Записать двоичный снимок базы клиентов и завершиться" << std::endl;
+        std::cout << "  -M <port|path> Метрики в формате Prometheus: TCP-порт на 127.0.0.1 или Unix-сокет" << std::endl;
+        std::cout << "  -H <path>    Управляющий сокет для обновления без простоя: новый процесс с тем же путём" << std::endl;
+        std::cout << "               забирает слушающие сокеты, а прежний дообслуживает сессии и завершается" << std::endl;
+        std::cout << "  -W <sec>     Срок дообслуживания сессий после передачи сокетов (по умолчанию 30," << std::endl;
+        std::cout << "               0 — без ограничения)" << std::endl;
+        std::cout << "  -o <file>    Записывать сессии (данные клиентов и ответы) в двоичную трассу для" << std::endl;
+        std::cout << "               bench/replay; при обновлении (-H) новому процессу нужен другой файл." << std::endl;
+        std::cout << "               Трасса содержит сообщения аутентификации: храните её как базу клиентов" << std::endl;
         std::cout << "  -h           Показать эту справку" << std::endl;
+        std::cout << "SIGHUP перезагружает базу клиентов без остановки сервера, SIGUSR1 выводит метрики" << std::endl;
     }
 
 public:
     ~Server();
     bool init(int argc, char* argv[]);
+    // Режим -S: база преобразована в снимок, сервер не запускается
+    bool snapshotOnly() const { return !snapshot_file_.empty(); }
     bool start();
     void stop();
 };
@@ -2,355 +2,853 @@
 #include <endian.h>
 #include <cctype>
 
-void Logger::log(const std::string& msg, bool critical) const {
-    if (log_file_.empty()) {
-        std::cout << msg << std::endl;
-        return;
+ClientSession::ClientSession(const AuthEngine& auth, Logger& logger, const SessionConfig& config) 
+    : auth_(auth), logger_(logger), config_(config), in_(kInBufSize) {
+    out_.reserve(kOutBufSize);
+}
+
+ClientSession::~ClientSession() {
+    close();
+}
+
+void ClientSession::open(int sock, Reactor& reactor) {
+    // Сбрасываем состояние; буферы сохраняют выделенную ранее память
+    sock_ = sock;
+    reactor_ = &reactor;
+    state_ = State::Auth;
+    in_base_ = in_.data();
+    in_start_ = in_end_ = 0;
+    ring_tail_ = ring_head_ = 0;
+    input_drained_ = peer_closed_ = external_io_ = false;
+    uring_ops_ = UringOps();
+    out_.clear();
+    out_pos_ = 0;
+    frame_open_ = output_blocked_ = false;
+    num_vectors_ = batch_flags_ = vector_idx_ = size_ = ops_ = 0;
+    keep_alive_ = compact_ = false;
+    allocations_ = 0;
+    login_len_ = 0;
+    accepted_ns_ = metrics::now();
+    reply_start_ns_ = 0;
+    rate_bucket_ = nullptr;
+    paused_until_ns_.store(0, std::memory_order_relaxed);
+    parked_.store(false, std::memory_order_relaxed);
+    capture_id_ = config_.capture ? config_.capture->begin() : 0;
+    capture_lost_ = false;
+    last_active_ns_.store(accepted_ns_, std::memory_order_relaxed);
+    expired_.store(false, std::memory_order_relaxed);
+    setDeadline(Deadline::Auth, accepted_ns_);
+    trace::print<trace::Level::Debug>("=== ЗАПУСК СЕССИИ ДЛЯ КЛИЕНТА ===");
+}
+
+void ClientSession::setDeadline(Deadline phase, uint64_t now) {
+    uint64_t timeout = config_.deadline_ns[static_cast<size_t>(phase)];
+    deadline_phase_.store(phase, std::memory_order_relaxed);
+    deadline_ns_.store(timeout ? now + timeout : 0, std::memory_order_relaxed);
+}
+
+void ClientSession::pause(uint64_t until) {
+    metrics::add(metrics::Counter::RateLimited);
+    trace::print<trace::Level::Debug>("Лимит скорости для ", std::string_view(login_, login_len_), ": пауза ",
+                                      (until - metrics::now()) / 1000, " мкс");
+    // Пока сессия ждёт сервер, сроки фаз клиента не идут
+    clearDeadline();
+    paused_until_ns_.store(until, std::memory_order_relaxed);
+}
+
+bool ClientSession::resumeIfDue(uint64_t now) {
+    uint64_t until = pausedUntil();
+    if (until == 0) return true;
+    if (now < until) return false;
+    paused_until_ns_.store(0, std::memory_order_relaxed);
+    return true;
+}
+
+void ClientSession::close() {
+    if (capture_id_) {
+        config_.capture->end(capture_id_, capture_lost_);
+        capture_id_ = 0;
     }
-    
-    std::ofstream file(log_file_, std::ios::app);
-    if (!file.is_open()) return;
+    ring_.reset();
+    // Блоки памяти параллельной свёртки не держим в простаивающих сессиях
+    parallel_.reset();
+    if (sock_ < 0) return;
+    ::close(sock_);
+    sock_ = -1;
+    if (alloc_stats::kEnabled) {
+        trace::print<trace::Level::Debug>("Выделений памяти в куче за сессию: ", allocations_);
+    }
+}
 
-    auto now = std::chrono::system_clock::now();
-    std::time_t t = std::chrono::system_clock::to_time_t(now);
-    char timestamp[20];
-    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", std::localtime(&t));
-    
-    file << "[" << timestamp << "] " << (critical ? "CRITICAL" : "INFO") 
-         << ": " << msg << std::endl;
+SessionPool::SessionPool(const AuthEngine& auth, Logger& logger, const SessionConfig& config, Reactor& reactor,
+                         size_t max_idle)
+    : auth_(auth), logger_(logger), config_(config), reactor_(reactor), max_idle_(max_idle) {
+    free_.reserve(max_idle_);
+}
+
+SessionPool::~SessionPool() {
+    for (ClientSession* session : free_) {
+        delete session;
+    }
+}
+
+ClientSession* SessionPool::acquire(int sock) {
+    ClientSession* session = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            session = free_.back();
+            free_.pop_back();
+        }
+    }
+    if (!session) {
+        session = new ClientSession(auth_, logger_, config_);
+    }
+    session->open(sock, reactor_);
+    return session;
+}
+
+void SessionPool::release(ClientSession* session) {
+    session->close();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.size() < max_idle_) {
+            free_.push_back(session);
+            return;
+        }
+    }
+    delete session;
 }
 
-bool ClientDB::load(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Ошибка открытия файла базы данных: " << filename << std::endl;
+bool ClientSession::recvAvailable() {
+    // Сдвигаем необработанный хвост в начало буфера
+    if (in_start_ > 0) {
+        memmove(in_.data(), in_.data() + in_start_, in_end_ - in_start_);
+        in_end_ -= in_start_;
+        in_start_ = 0;
+    }
+
+    // В режиме edge-triggered читаем до EAGAIN или до заполнения буфера
+    input_drained_ = false;
+    size_t start = in_end_;
+    while (in_end_ < in_.size() && !peer_closed_) {
+        ssize_t received = recv(sock_, in_.data() + in_end_, in_.size() - in_end_, 0);
+        if (received > 0) {
+            in_end_ += received;
+            continue;
+        }
+        if (received == 0) {
+            peer_closed_ = true;
+            break;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            input_drained_ = true;
+            break;
+        }
+        logger_.log("Ошибка приема данных", false);
         return false;
     }
+    captureBytes(capture::Kind::In, in_.data() + start, in_end_ - start);
+    metrics::add(metrics::Counter::BytesIn, in_end_ - start);
+    return true;
+}
 
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty() || line[0] == '#') continue;
-        std::istringstream iss(line);
-        std::string login, password;
-        if (iss >> login >> password) {
-            clients_[login] = password;
-            std::cout << "Загружен клиент: " << login << std::endl;
+bool ClientSession::ringAvailable() {
+    // В сокете от клиента теперь только звонки; их содержимое не важно
+    char doorbells[64];
+    while (!peer_closed_) {
+        ssize_t received = recv(sock_, doorbells, sizeof(doorbells), 0);
+        if (received > 0) continue;
+        if (received == 0) {
+            peer_closed_ = true;
+            break;
         }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        logger_.log("Ошибка приема данных", false);
+        return false;
+    }
+
+    // Обработанная часть возвращается клиенту; двойное отображение кольца
+    // позволяет читать дальше от новой позиции без разрыва
+    if (in_start_ > 0) {
+        ring_tail_ += in_start_;
+        in_end_ -= in_start_;
+        in_start_ = 0;
+        in_base_ = ring_->data() + (ring_tail_ & (ring_->size() - 1));
+        ring_->release(ring_tail_);
+    }
+
+    // Новых данных нет — засыпаем до звонка, если клиент не успел записать
+    // что-то после установки флага ожидания
+    uint64_t head = ring_->head();
+    if (head == ring_head_ && !peer_closed_ && ring_->idle(head)) {
+        input_drained_ = true;
+        return true;
     }
+    head = ring_->head();
+    if (head - ring_tail_ > ring_->size() || head < ring_head_) {
+        logger_.log("Неверная позиция записи в кольце клиента", false);
+        return false;
+    }
+    metrics::add(metrics::Counter::BytesIn, head - ring_head_);
+    captureBytes(capture::Kind::In, in_base_ + (ring_head_ - ring_tail_), head - ring_head_);
+    ring_head_ = head;
+    in_end_ = static_cast<size_t>(head - ring_tail_);
+    input_drained_ = false;
     return true;
 }
 
-bool ClientDB::auth(const std::string& login, const std::string& password) const {
-    auto it = clients_.find(login);
-    if (it == clients_.end()) {
-        std::cout << "Клиент не найден: " << login << std::endl;
+bool ClientSession::shareRing() {
+    // Кольцо передаётся только через Unix-сокет и только когда сессия сама
+    // ведёт ввод-вывод; иначе ответ уходит без дескриптора, и клиент
+    // продолжает через сокет
+    int domain = 0;
+    socklen_t len = sizeof(domain);
+    if (config_.ring_size == 0 || external_io_ || getsockopt(sock_, SOL_SOCKET, SO_DOMAIN, &domain, &len) < 0 ||
+        domain != AF_UNIX) {
+        return true;
+    }
+    // Данные до получения кольца клиент присылать не должен
+    if (in_start_ != in_end_) {
+        fail("Данные векторов отправлены до получения кольца");
+        return false;
+    }
+    auto ring = std::make_unique<ShmRing>();
+    if (!ring->create(config_.ring_size)) {
+        logger_.log("Ошибка создания кольца в разделяемой памяти", false);
+        return true;
+    }
+
+    // Дескриптор уходит вместе с первым байтом ответа "OK"
+    iovec iov;
+    iov.iov_base = out_.data() + out_pos_;
+    iov.iov_len = out_.size() - out_pos_;
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    int fd = ring->fd();
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+    ssize_t sent = sendmsg(sock_, &msg, MSG_NOSIGNAL);
+    if (sent <= 0) {
+        fail("Ошибка передачи кольца клиенту");
         return false;
     }
-    
-    bool result = (it->second == password);
-    std::cout << "Аутентификация " << login << ": " << (result ? "УСПЕХ" : "НЕУДАЧА") << std::endl;
-    return result;
+    captureBytes(capture::Kind::Out, out_.data() + out_pos_, static_cast<size_t>(sent));
+    out_pos_ += static_cast<size_t>(sent);
+    metrics::add(metrics::Counter::BytesOut, static_cast<size_t>(sent));
+    if (out_pos_ == out_.size()) outputFlushed();
+
+    ring->closeFd();
+    ring_ = std::move(ring);
+    in_base_ = ring_->data();
+    in_start_ = in_end_ = 0;
+    metrics::add(metrics::Counter::SharedRings);
+    trace::print<trace::Level::Debug>("Клиенту передано кольцо ", config_.ring_size / 1024, " КиБ");
+    return true;
 }
 
-bool ClientDB::authWithHash(const std::string& login, const std::string& received_hash, const std::string& salt) const {
-    auto it = clients_.find(login);
-    if (it == clients_.end()) {
-        std::cout << "Клиент не найден в базе: '" << login << "'" << std::endl;
-        std::cout << "Доступные логины в базе:" << std::endl;
-        for (const auto& client : clients_) {
-            std::cout << "  '" << client.first << "'" << std::endl;
+bool ClientSession::sendPending(bool more) {
+    // Открытый кадр ответа не отправляется, пока пакет не обработан целиком;
+    // MSG_MORE просит ядро не выталкивать неполный сегмент, пока
+    // следом ожидаются новые результаты того же пакета
+    size_t limit = sendLimit();
+    if (external_io_) {
+        output_blocked_ = limit - out_pos_ >= kOutBufSize;
+        return true;
+    }
+    size_t start = out_pos_;
+    int flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+    while (out_pos_ < limit) {
+        ssize_t sent = send(sock_, out_.data() + out_pos_, limit - out_pos_, flags);
+        if (sent > 0) {
+            out_pos_ += sent;
+            continue;
         }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        logger_.log("Ошибка отправки данных", false);
         return false;
     }
-    
-    std::string password = it->second;
-    std::cout << "Найден пароль для логина '" << login << "': '" << password << "'" << std::endl;
-    
-    // Вычисляем ожидаемый хеш: SHA256(salt + password)
-    std::string data = salt + password;
-    
-    std::cout << "Соль (hex): ";
-    for (char c : salt) {
-        printf("%02x", (unsigned char)c);
+    captureBytes(capture::Kind::Out, out_.data() + start, out_pos_ - start);
+    metrics::add(metrics::Counter::BytesOut, out_pos_ - start);
+    output_blocked_ = limit - out_pos_ >= kOutBufSize;
+    if (out_pos_ == out_.size()) outputFlushed();
+    return true;
+}
+
+void ClientSession::outputFlushed() {
+    out_.clear();
+    out_pos_ = 0;
+    // Ответ — от конца пакета до отправки последнего байта результатов
+    if (reply_start_ns_ != 0) {
+        metrics::record(metrics::Phase::Reply, metrics::now() - reply_start_ns_);
+        reply_start_ns_ = 0;
     }
-    std::cout << std::endl;
-    
-    std::cout << "Данные для хеширования (соль+пароль): '";
-    for (char c : data) {
-        if (std::isprint((unsigned char)c)) {
-            std::cout << c;
-        } else {
-            printf("\\x%02x", (unsigned char)c);
+}
+
+void ClientSession::queue(const void* buf, size_t len) {
+    out_.append(static_cast<const char*>(buf), len);
+}
+
+void ClientSession::fail(const std::string& msg) {
+    metrics::add(metrics::Counter::SessionErrors);
+    logger_.log(msg, false);
+    if (state_ == State::Auth) {
+        logger_.log("Ошибка аутентификации", false);
+    } else {
+        logger_.log("Ошибка обработки векторов", false);
+        trace::print<trace::Level::Debug>("=== СЕССИЯ ЗАВЕРШЕНА С ОШИБКАМИ ===");
+    }
+    // Результаты векторов, обработанных до ошибки, досылаются перед
+    // закрытием, как и без ошибки; незаконченный кадр ответа отбрасывается
+    out_.resize(sendLimit());
+    frame_open_ = false;
+    state_ = out_pos_ < out_.size() ? State::Closing : State::Closed;
+}
+
+void ClientSession::failOnEof() {
+    switch (state_) {
+    case State::Auth:
+        fail("Ошибка приема данных аутентификации");
+        break;
+    case State::Count:
+        if (keep_alive_ && in_start_ == in_end_) {
+            // Конец данных на границе пакетов — обычное завершение сессии
+            trace::print<trace::Level::Debug>("Клиент закрыл соединение между пакетами");
+            state_ = State::Closing;
+            break;
         }
+        fail("Ошибка приема количества векторов");
+        break;
+    case State::Size:
+        fail("Ошибка приема размера вектора " + std::to_string(vector_idx_ + 1));
+        break;
+    case State::Payload:
+        if (compact_) {
+            fail("Ошибка приема данных вектора " + std::to_string(vector_idx_ + 1) +
+                 ", не получено " + std::to_string(remaining_) + " из " + std::to_string(size_) + " элементов");
+            break;
+        }
+        fail("Ошибка приема данных вектора " + std::to_string(vector_idx_ + 1) +
+             ", ожидалось " + std::to_string(size_ * sizeof(int64_t)) + " байт");
+        break;
+    default:
+        state_ = State::Closed;
+        break;
     }
-    std::cout << "'" << std::endl;
-    std::cout << "Длина данных: " << data.length() << std::endl;
-    
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256((unsigned char*)data.c_str(), data.length(), hash);
+}
+
+bool ClientSession::auth(std::string_view message, AuthEngine::Request& request) {
+    trace::print<trace::Level::Trace>("Получено сообщение аутентификации: ", message);
+    trace::print<trace::Level::Debug>("Длина сообщения: ", message.length());
     
-    // Конвертируем в hex строку
-    std::stringstream ss;
-    for(int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
+    if (!AuthEngine::parse(message, request)) {
+        logger_.logf("Неверный формат сообщения аутентификации (длина %zu)", message.length());
+        return false;
     }
-    std::string expected_hash = ss.str();
-    
-    // Приводим к нижнему регистру для сравнения
-    std::transform(expected_hash.begin(), expected_hash.end(), expected_hash.begin(), ::tolower);
-    std::string received_hash_lower = received_hash;
-    std::transform(received_hash_lower.begin(), received_hash_lower.end(), received_hash_lower.begin(), ::tolower);
     
-    std::cout << "Ожидаемый хеш:  " << expected_hash << std::endl;
-    std::cout << "Полученный хеш: " << received_hash_lower << std::endl;
-    std::cout << "Длина ожидаемого хеша: " << expected_hash.length() << std::endl;
-    std::cout << "Длина полученного хеша: " << received_hash_lower.length() << std::endl;
-    
-    bool result = (expected_hash == received_hash_lower);
-    std::cout << "Аутентификация '" << login << "': " << (result ? "УСПЕХ" : "НЕУДАЧА") << std::endl;
-    
-    if (!result) {
-        std::cout << "Хеши не совпадают!" << std::endl;
-        // Выводим различия
-        for (size_t i = 0; i < std::min(expected_hash.length(), received_hash_lower.length()); i++) {
-            if (expected_hash[i] != received_hash_lower[i]) {
-                std::cout << "Первое отличие на позиции " << i << ": ожидалось '" << expected_hash[i] 
-                         << "', получено '" << received_hash_lower[i] << "'" << std::endl;
-                break;
-            }
-        }
+    AuthEngine::Result result = auth_.verify(request, login_, login_len_);
+    if (result != AuthEngine::Result::Ok) {
+        std::string_view login = request.resume ? std::string_view("#R") : request.login;
+        logger_.logf("Аутентификация не удалась для: %.*s (%s)", static_cast<int>(login.size()), login.data(),
+                     AuthEngine::describe(result));
+        return false;
     }
     
-    return result;
+    logger_.logf("Клиент %s: %.*s", request.resume ? "возобновил сессию" : "аутентифицирован",
+                 static_cast<int>(login_len_), login_);
+    return true;
 }
 
-ClientSession::ClientSession(int sock, ClientDB& db, Logger& logger) 
-    : sock_(sock), db_(db), logger_(logger) {}
+bool ClientSession::handleAuth() {
+    // Сообщение аутентификации завершается '\n'; без него ждём, пока клиент
+    // не перестанет присылать данные (как и раньше — одна порция из recv)
+    size_t available = in_end_ - in_start_;
+    if (available == 0) return false;
+    const char* begin = in_base_ + in_start_;
+    const char* newline = static_cast<const char*>(memchr(begin, '\n', std::min(available, kMaxAuthMsg)));
+    size_t len;
+    if (newline) {
+        len = newline - begin + 1;
+    } else {
+        if (available < kMinAuthMsg && !peer_closed_) return false;
+        if (!input_drained_ && !peer_closed_ && available < kMaxAuthMsg) return false;
+        len = std::min(available, kMaxAuthMsg);
+    }
+    std::string_view message(begin, newline ? len - 1 : len);
+    in_start_ += len;
 
-bool ClientSession::sendAll(const void* buf, size_t len) {
-    const char* ptr = static_cast<const char*>(buf);
-    while (len > 0) {
-        ssize_t sent = send(sock_, ptr, len, 0);
-        if (sent <= 0) {
-            logger_.log("Ошибка отправки данных", false);
-            return false;
-        }
-        ptr += sent;
-        len -= sent;
+    uint64_t auth_start = metrics::now();
+    metrics::record(metrics::Phase::AcceptToAuth, auth_start - accepted_ns_);
+    AuthEngine::Request request;
+    bool ok = auth(message, request);
+    metrics::record(metrics::Phase::Auth, metrics::now() - auth_start);
+    metrics::add(ok ? metrics::Counter::AuthOk : metrics::Counter::AuthFailures);
+    clearDeadline();
+    if (!ok) {
+        queue("ERR", 3);
+        reply_start_ns_ = metrics::now();
+        logger_.log("Ошибка аутентификации", false);
+        state_ = State::Closing;
+        return true;
     }
-    return true;
-}
+    if (config_.rate_limiter) rate_bucket_ = config_.rate_limiter->bucket(std::string_view(login_, login_len_));
 
-bool ClientSession::recvAll(void* buf, size_t len) {
-    char* ptr = static_cast<char*>(buf);
-    while (len > 0) {
-        ssize_t received = recv(sock_, ptr, len, 0);
-        if (received <= 0) {
-            logger_.log("Ошибка приема данных", false);
-            return false;
-        }
-        ptr += received;
-        len -= received;
+    compact_ = request.compact;
+    queue("OK", 2);
+    if (request.want_ticket) {
+        // Пустой билет означает, что выдача билетов отключена
+        queue(ticket_, auth_.issueTicket(std::string_view(login_, login_len_), ticket_));
+        queue("\n", 1);
     }
+    if (request.shared_ring && !shareRing()) return false;
+    trace::print<trace::Level::Debug>("Аутентификация успешна, обработка векторов...");
+    state_ = State::Count;
     return true;
 }
 
-bool ClientSession::auth() {
-    char buf[1024];
-    ssize_t received = recv(sock_, buf, sizeof(buf) - 1, 0);
-    if (received <= 0) {
-        logger_.log("Ошибка приема данных аутентификации", false);
-        return false;
+bool ClientSession::handleCount() {
+    // Принимаем количество векторов (4 байта) и, если есть, маску операций
+    size_t available = in_end_ - in_start_;
+    // Срок заголовка идёт с первого байта: ожидание следующего пакета
+    // ограничено только тайм-аутом простоя
+    if (available > 0 && deadline() == 0) setDeadline(Deadline::Header, metrics::now());
+    if (available < sizeof(uint32_t)) return false;
+    size_t header_start = in_start_;
+    uint32_t num_vectors;
+    memcpy(&num_vectors, in_base_ + in_start_, sizeof(uint32_t));
+    
+    // Конвертируем из little-endian и отделяем флаги пакета
+    num_vectors = le32toh(num_vectors);
+    uint32_t flags = num_vectors & proto::kFlagsMask;
+    num_vectors &= proto::kCountMask;
+
+    uint32_t ops = 0;
+    if (flags & proto::kFlagOps) {
+        if (available < 2 * sizeof(uint32_t)) return false;
+        memcpy(&ops, in_base_ + in_start_ + sizeof(uint32_t), sizeof(uint32_t));
+        ops = le32toh(ops);
+        in_start_ += sizeof(uint32_t);
     }
-    buf[received] = '\0';
+    in_start_ += sizeof(uint32_t);
     
-    std::string message(buf, received);
-    std::cout << "Получено сообщение аутентификации: " << message << std::endl;
-    std::cout << "Длина сообщения: " << message.length() << std::endl;
+    trace::print<trace::Level::Debug>("Обработка ", num_vectors, " векторов");
+
+    if (flags & ~proto::kKnownFlags) {
+        fail("Неизвестные флаги пакета векторов: " + std::to_string(flags >> 24));
+        return false;
+    }
+
+    if ((flags & proto::kFlagOps) && (ops == 0 || (ops & ~proto::kKnownOps))) {
+        fail("Неверная маска операций: " + std::to_string(ops));
+        return false;
+    }
     
-    // Проверяем минимальную длину (user + соль 16 + хеш 64 = 84 байта)
-    if (message.length() < 84) {
-        logger_.log("Неверная длина сообщения аутентификации: " + std::to_string(message.length()), false);
-        send(sock_, "ERR", 3, 0);
+    if (num_vectors == 0) {
+        if (keep_alive_ && flags == 0) {
+            trace::print<trace::Level::Debug>("=== СЕССИЯ ЗАВЕРШЕНА КЛИЕНТОМ ===");
+            clearDeadline();
+            state_ = State::Closing;
+            return true;
+        }
+        fail("Получено 0 векторов");
         return false;
     }
     
-    // Проверяем, что сообщение начинается с "user"
-    if (message.substr(0, 4) != "user") {
-        logger_.log("Сообщение не начинается с 'user'", false);
-        send(sock_, "ERR", 3, 0);
+    if (config_.max_batch_vectors != 0 && num_vectors > config_.max_batch_vectors) {
+        metrics::add(metrics::Counter::RejectedOversize);
+        fail("Слишком большое количество векторов: " + std::to_string(num_vectors));
+        return false;
+    }
+
+    uint64_t now = metrics::now();
+    if (uint64_t wait = rate_bucket_ ? config_.rate_limiter->take(*rate_bucket_, num_vectors, 0, now) : 0) {
+        // Заголовок разбирается заново после паузы
+        in_start_ = header_start;
+        pause(now + wait);
         return false;
     }
+
+    metrics::add(metrics::Counter::Batches);
+    setDeadline(Deadline::Header, now);
+    num_vectors_ = num_vectors;
+    batch_flags_ = flags;
+    ops_ = ops;
+    vector_idx_ = 0;
+    state_ = State::Size;
+
+    if (batch_flags_ & proto::kFlagFramedReply) {
+        // Резервируем заголовок кадра; он заполняется в конце пакета
+        frame_start_ = out_.size();
+        frame_open_ = true;
+        uint32_t count = htole32(num_vectors_);
+        queue(&count, sizeof(count));
+    }
+    return true;
+}
+
+bool ClientSession::handleSize() {
+    // Принимаем размер вектора (4 байта)
+    if (in_end_ - in_start_ < sizeof(uint32_t)) return false;
+    uint32_t size;
+    memcpy(&size, in_base_ + in_start_, sizeof(uint32_t));
+    in_start_ += sizeof(uint32_t);
+
+    trace::print<trace::Level::Trace>("=== Обработка вектора ", vector_idx_ + 1, " ===");
     
-    // Извлекаем логин, соль и хеш
-    std::string login = "user";  // фиксированный логин
-    std::string salt = message.substr(4, 16);
-    std::string received_hash = message.substr(20, 64);
+    // Конвертируем размер вектора из little-endian
+    size = le32toh(size);
     
-    std::cout << "Логин: '" << login << "', Длина логина: " << login.length() << std::endl;
-    std::cout << "Соль: " << salt << ", Длина соли: " << salt.length() << std::endl;
-    std::cout << "Полученный хеш: " << received_hash << ", Длина хеша: " << received_hash.length() << std::endl;
+    trace::print<trace::Level::Trace>("Размер вектора ", vector_idx_ + 1, ": ", size);
     
-    // Проверяем что соль и хеш содержат только hex символы
-    auto is_hex = [](const std::string& str) {
-        for (char c : str) {
-            if (!std::isxdigit(c)) return false;
+    if (size == 0) {
+        // Для пустого вектора отправляем 0 (8 байт)
+        trace::print<trace::Level::Trace>("Пустой вектор ", vector_idx_ + 1, ", результат: 0");
+        if (ops_) {
+            stats_ = reduce::Stats();
+            finishStats(0);
+        } else {
+            finishVector(0);
         }
         return true;
-    };
-    
-    if (!is_hex(salt) || salt.length() != 16) {
-        logger_.log("Неверный формат соли", false);
-        send(sock_, "ERR", 3, 0);
-        return false;
     }
     
-    if (!is_hex(received_hash) || received_hash.length() != 64) {
-        logger_.log("Неверный формат хеша", false);
-        send(sock_, "ERR", 3, 0);
+    if (config_.max_vector_size != 0 && size > config_.max_vector_size) {
+        metrics::add(metrics::Counter::RejectedOversize);
+        fail("Слишком большой размер вектора: " + std::to_string(size));
         return false;
     }
     
-    // Используем метод для аутентификации с хешем
-    if (!db_.authWithHash(login, received_hash, salt)) {
-        logger_.log("Аутентификация не удалась для: " + login, false);
-        send(sock_, "ERR", 3, 0);
+    receive_start_ns_ = metrics::now();
+    if (uint64_t wait = rate_bucket_ ? config_.rate_limiter->take(*rate_bucket_, 0, uint64_t(size) * sizeof(int64_t),
+                                                                  receive_start_ns_) : 0) {
+        // Размер вектора разбирается заново после паузы
+        in_start_ -= sizeof(uint32_t);
+        pause(receive_start_ns_ + wait);
         return false;
     }
-    
-    send(sock_, "OK", 2, 0);
-    logger_.log("Клиент аутентифицирован: " + login);
+
+    // Вектор не буферизуется целиком: данные сворачиваются по мере приёма
+    size_ = size;
+    remaining_ = size;
+    prev_element_ = 0;
+    wrapped_sum_ = 0;
+    sum_ = reduce::Sum();
+    stats_ = reduce::Stats();
+    parallel_vector_ = config_.reduce_pool && config_.parallel_threshold && size >= config_.parallel_threshold;
+    if (parallel_vector_) {
+        using Kind = ParallelReducer::Kind;
+        Kind kind = ops_ ? ((ops_ & (proto::kOpVariance | proto::kOpStddev)) ? Kind::StatsVariance : Kind::Stats)
+                         : (config_.sum_mode == reduce::SumMode::Wrap ? Kind::Wrapped : Kind::Exact);
+        if (!parallel_) parallel_ = std::make_unique<ParallelReducer>(*config_.reduce_pool);
+        parallel_->begin(kind, size);
+    }
+    setDeadline(Deadline::Payload, receive_start_ns_);
+    compute_ns_ = 0;
+    trace::print<trace::Level::Trace>("Ожидается ", size * sizeof(int64_t), " байт данных для вектора ", 
+                                      vector_idx_ + 1, compact_ ? " (компактно)" : "");
+    state_ = State::Payload;
     return true;
 }
 
-bool ClientSession::processVectors() {
-    // Принимаем количество векторов (4 байта)
-    uint32_t num_vectors;
-    if (!recvAll(&num_vectors, sizeof(uint32_t))) {
-        logger_.log("Ошибка приема количества векторов", false);
-        return false;
+void ClientSession::reduceChunk(const char* chunk, size_t n) {
+    if (parallel_vector_) {
+        // Элементы копируются в блоки пула; заполненный блок сворачивается,
+        // пока принимаются следующие
+        for (size_t done = 0; done < n;) {
+            size_t k = std::min(n - done, parallel_->room());
+            memcpy(parallel_->fillPtr(), chunk + done * sizeof(int64_t), k * sizeof(int64_t));
+            parallel_->commit(k);
+            done += k;
+        }
+    } else if (ops_) {
+        // Все статистики считаются одним проходом по принятой порции
+        reduce::accumulateStats(stats_, chunk, n, ops_ & (proto::kOpVariance | proto::kOpStddev));
+    } else if (config_.sum_mode == reduce::SumMode::Wrap) {
+        wrapped_sum_ = static_cast<int64_t>(static_cast<uint64_t>(wrapped_sum_) + 
+                                            static_cast<uint64_t>(reduce::sumWrapped(chunk, n)));
+    } else {
+        reduce::accumulate(sum_, chunk, n);
     }
     
-    // Конвертируем из little-endian
-    num_vectors = le32toh(num_vectors);
-    
-    std::cout << "Обработка " << num_vectors << " векторов" << std::endl;
-    
-    if (num_vectors == 0) {
-        logger_.log("Получено 0 векторов", false);
-        return false;
+    // Детальный вывод для отладки (только на уровне TRACE)
+    if (trace::enabled<trace::Level::Trace>()) {
+        std::ostringstream dump;
+        for (size_t j = 0; j < n; j++) {
+            uint64_t val;
+            memcpy(&val, chunk + j * sizeof(int64_t), sizeof(val));
+            dump << static_cast<int64_t>(le64toh(val));
+            if (j < n - 1) dump << ", ";
+        }
+        trace::print<trace::Level::Trace>("Вектор ", vector_idx_ + 1, " данные (часть): ", dump.str());
     }
-    
-    if (num_vectors > 100) {
-        logger_.log("Слишком большое количество векторов: " + std::to_string(num_vectors), false);
+}
+
+bool ClientSession::handlePayload() {
+    uint64_t compute_start = metrics::now();
+    if (compact_) {
+        if (!decodeAvailable()) return false;
+    } else {
+        // Сворачиваем все целиком принятые элементы прямо из входного буфера;
+        // неполный элемент остаётся в буфере до следующей порции данных
+        size_t available = (in_end_ - in_start_) / sizeof(int64_t);
+        size_t n = static_cast<size_t>(std::min<uint64_t>(available, remaining_));
+        if (n == 0) return false;
+        reduceChunk(in_base_ + in_start_, n);
+        in_start_ += n * sizeof(int64_t);
+        remaining_ -= n;
+    }
+    if (remaining_ == 0 && parallel_vector_) parallel_->finish(wrapped_sum_, sum_, stats_);
+    uint64_t compute_end = metrics::now();
+    compute_ns_ += compute_end - compute_start;
+    if (remaining_ > 0) return true;
+
+    // Приём — от заголовка размера до последнего элемента, включая свёртку
+    metrics::record(metrics::Phase::Receive, compute_end - receive_start_ns_);
+    metrics::record(metrics::Phase::Compute, compute_ns_);
+
+    // Вычисляем среднее арифметическое
+    int64_t avg = 0;
+    if ((!ops_ || (ops_ & proto::kOpMean)) && !computeMean(avg)) {
+        fail("Переполнение суммы вектора " + std::to_string(vector_idx_ + 1));
         return false;
     }
+    trace::print<trace::Level::Trace>("Среднее арифметическое: ", avg);
     
-   
-    
-    for (uint32_t i = 0; i < num_vectors; i++) {
-        std::cout << "=== Обработка вектора " << i + 1 << " ===" << std::endl;
-        
-        // Принимаем размер вектора (4 байта)
-        uint32_t size;
-        if (!recvAll(&size, sizeof(uint32_t))) {
-            logger_.log("Ошибка приема размера вектора " + std::to_string(i + 1), false);
+    if (ops_) {
+        finishStats(avg);
+    } else {
+        finishVector(avg);
+    }
+    return true;
+}
+
+bool ClientSession::decodeAvailable() {
+    // Каждый целиком принятый блок распаковывается в массив на стеке и
+    // сразу сворачивается, пока он в L1; неполный блок ждёт следующей порции
+    // (при параллельной свёртке — сразу в блок пула, без копирования)
+    static_assert(ParallelReducer::kBlockElements % codec::kBlockSize == 0,
+                  "блок кодирования не должен пересекать границу блока пула");
+    int64_t block[codec::kBlockSize];
+    bool progress = false;
+    while (remaining_ > 0) {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(codec::kBlockSize, remaining_));
+        size_t used = 0;
+        int64_t* out = parallel_vector_ ? reinterpret_cast<int64_t*>(parallel_->fillPtr()) : block;
+        codec::Status status = codec::decodeBlock(in_base_ + in_start_, in_end_ - in_start_, n, prev_element_,
+                                                  out, used);
+        if (status == codec::Status::NeedMore) break;
+        if (status == codec::Status::Invalid) {
+            fail("Неверный блок данных вектора " + std::to_string(vector_idx_ + 1) + ", элемент " +
+                 std::to_string(size_ - remaining_ + 1));
             return false;
         }
-        
-        // Конвертируем размер вектора из little-endian
-        size = le32toh(size);
-        
-        std::cout << "Размер вектора " << i + 1 << ": " << size << std::endl;
-        
-        if (size == 0) {
-            // Для пустого вектора отправляем 0 (8 байт)
-            int64_t result = 0;
-            result = htole64(result);
-            if (!sendAll(&result, sizeof(int64_t))) {
-                logger_.log("Ошибка отправки результата для пустого вектора", false);
-                return false;
-            }
-            std::cout << "Пустой вектор " << i + 1 << ", результат: 0" << std::endl;
-            continue;
-        }
-        
-        if (size > 100000) {
-            logger_.log("Слишком большой размер вектора: " + std::to_string(size), false);
-            return false;
+        if (parallel_vector_) {
+            parallel_->commit(n);
+        } else {
+            reduceChunk(reinterpret_cast<const char*>(block), n);
         }
-        
-        // Выделяем память для данных вектора
-        std::vector<int64_t> data(size);
-        
-        // Принимаем данные вектора (size * 8 байт)
-        size_t total_bytes = size * sizeof(int64_t);
-        std::cout << "Ожидается " << total_bytes << " байт данных для вектора " << i + 1 << std::endl;
-        
-        if (!recvAll(data.data(), total_bytes)) {
-            logger_.log("Ошибка приема данных вектора " + std::to_string(i + 1) + 
-                       ", ожидалось " + std::to_string(total_bytes) + " байт", false);
-            return false;
+        in_start_ += used;
+        remaining_ -= n;
+        progress = true;
+    }
+    return progress;
+}
+
+bool ClientSession::computeMean(int64_t& avg) {
+    // В режиме статистик сумма по модулю 2^64 — младшие биты точной суммы
+    const reduce::Sum& sum = ops_ ? stats_.sum : sum_;
+    if (config_.sum_mode == reduce::SumMode::Wrap) {
+        int64_t wrapped = ops_ ? static_cast<int64_t>(static_cast<uint64_t>(sum.total)) : wrapped_sum_;
+        avg = wrapped / static_cast<int64_t>(size_);
+        return true;
+    }
+    if (config_.sum_mode == reduce::SumMode::Checked && !sum.fitsInt64()) {
+        return false;
+    }
+    avg = static_cast<int64_t>(sum.total / static_cast<int64_t>(size_));
+    return true;
+}
+
+void ClientSession::finishVector(int64_t avg) {
+    // ОТПРАВЛЯЕМ 8 БАЙТ (int64_t) - СРЕДНЕЕ АРИФМЕТИЧЕСКОЕ
+    int64_t result_to_send = htole64(avg);
+    trace::print<trace::Level::Trace>("Отправка среднего арифметического для вектора ", vector_idx_ + 1, ": ", 
+                                      avg, " (8 байт)");
+    queue(&result_to_send, sizeof(int64_t));
+    nextVector();
+}
+
+void ClientSession::finishStats(int64_t avg) {
+    // Поля записи идут в порядке битов маски операций
+    char record[proto::recordSize(proto::kKnownOps)];
+    char* p = record;
+    auto put = [&p](uint64_t v) {
+        v = htole64(v);
+        memcpy(p, &v, sizeof(v));
+        p += sizeof(v);
+    };
+    auto putDouble = [&put](double d) {
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        put(bits);
+    };
+    bool empty = stats_.sum.count == 0;
+    if (ops_ & proto::kOpSum) {
+        put(static_cast<uint64_t>(stats_.sum.total));
+        put(static_cast<uint64_t>(stats_.sum.total >> 64));
+    }
+    if (ops_ & proto::kOpMean) put(static_cast<uint64_t>(avg));
+    if (ops_ & proto::kOpMin) put(empty ? 0 : static_cast<uint64_t>(stats_.min));
+    if (ops_ & proto::kOpMax) put(empty ? 0 : static_cast<uint64_t>(stats_.max));
+    if (ops_ & proto::kOpVariance) putDouble(stats_.variance());
+    if (ops_ & proto::kOpStddev) putDouble(stats_.stddev());
+    if (ops_ & proto::kOpNegatives) put(stats_.sum.negatives);
+    trace::print<trace::Level::Trace>("Отправка статистик вектора ", vector_idx_ + 1, " (", p - record, " байт)");
+    queue(record, p - record);
+    nextVector();
+}
+
+void ClientSession::nextVector() {
+    trace::print<trace::Level::Trace>("Успешно обработан вектор ", vector_idx_ + 1);
+    metrics::add(metrics::Counter::Vectors);
+
+    if (++vector_idx_ < num_vectors_) {
+        state_ = State::Size;
+        setDeadline(Deadline::Header, metrics::now());
+        // Выходной буфер заполнен — отправляем накопленное, не дожидаясь конца пакета
+        if (!frame_open_ && out_.size() - out_pos_ >= kOutBufSize && !sendPending(true)) {
+            state_ = State::Closed;
         }
-        
-        // Конвертируем все элементы из little-endian
-        for (auto& val : data) {
-            val = le64toh(val);
+        return;
+    }
+
+    frame_open_ = false;
+
+    trace::print<trace::Level::Debug>("Обработка всех ", num_vectors_, " векторов завершена успешно");
+    logger_.logf("Обработка векторов завершена успешно");
+    reply_start_ns_ = metrics::now();
+    clearDeadline();
+    keep_alive_ = batch_flags_ & proto::kFlagKeepAlive;
+    if (keep_alive_) {
+        state_ = State::Count;
+        return;
+    }
+    trace::print<trace::Level::Debug>("=== СЕССИЯ ЗАВЕРШЕНА УСПЕШНО ===");
+    state_ = State::Closing;
+}
+
+void ClientSession::step() {
+    bool progress = true;
+    while (progress && !output_blocked_) {
+        switch (state_) {
+        case State::Auth:    progress = handleAuth(); break;
+        case State::Count:   progress = handleCount(); break;
+        case State::Size:    progress = handleSize(); break;
+        case State::Payload: progress = handlePayload(); break;
+        default:             progress = false; break;
         }
-        
-        // Вычисляем сумму
-        int64_t sum = 0;
-        for (const auto& val : data) {
-            sum += val;
+    }
+}
+
+bool ClientSession::onEvent(uint32_t events) {
+    alloc_stats::Scope allocations(allocations_);
+    last_active_ns_.store(metrics::now(), std::memory_order_relaxed);
+    if (events & EPOLLERR) {
+        logger_.log("Ошибка сокета клиента", false);
+        return false;
+    }
+    if (!resumeIfDue(metrics::now())) return true;
+
+    for (;;) {
+        // Клиент не забирает ответы: сначала освобождаем выходной буфер
+        if (output_blocked_) {
+            if (!sendPending(true)) return false;
+            if (output_blocked_) return true;
         }
-        
-        // Вычисляем среднее арифметическое
-        int64_t avg = sum / static_cast<int64_t>(size);
-        
-        // Детальный вывод для отладки
-        std::cout << "Вектор " << i + 1 << " данные: ";
-        for (size_t j = 0; j < size; j++) {
-            std::cout << data[j];
-            if (j < size - 1) std::cout << ", ";
-        }
-        std::cout << std::endl;
-        std::cout << "Сумма: " << sum << ", Среднее арифметическое: " << avg << std::endl;
-        
-        // ОТПРАВЛЯЕМ 8 БАЙТ (int64_t) - СРЕДНЕЕ АРИФМЕТИЧЕСКОЕ
-        int64_t result_to_send = htole64(avg);
-        std::cout << "Отправка среднего арифметического для вектора " << i + 1 << ": " << avg << " (8 байт)" << std::endl;
-        
-        if (!sendAll(&result_to_send, sizeof(int64_t))) {
-            logger_.log("Ошибка отправки результата вектора " + std::to_string(i + 1), false);
+
+        if (state_ != State::Closing && !(ring_ ? ringAvailable() : recvAvailable())) return false;
+        step();
+        if (state_ == State::Closed) return false;
+
+        // Пока пакет не закончен и во входном буфере есть данные (в том
+        // числе следующие пакеты сессии), ответы придерживаются; перед
+        // ожиданием новых данных всё выталкивается
+        bool in_batch = state_ == State::Size || state_ == State::Payload ||
+                        (state_ == State::Count && keep_alive_);
+        if (!sendPending(in_batch && !input_drained_ && !peer_closed_ && !paused())) return false;
+
+        // После ответа закрываем сессию, как только выходной буфер опустеет
+        if (state_ == State::Closing) return out_pos_ < out_.size();
+        if (output_blocked_) return true;
+        // На паузе вход не читается: клиента сдерживает окно TCP
+        if (paused()) return true;
+
+        if (peer_closed_) {
+            failOnEof();
+            // Клиент закрыл соединение между пакетами: досылаем результаты
+            if (state_ == State::Closing) continue;
             return false;
         }
-        
-        std::cout << "Успешно обработан вектор " << i + 1 << std::endl;
+        if (input_drained_) return true;
     }
-    
-    std::cout << "Обработка всех " << num_vectors << " векторов завершена успешно" << std::endl;
-    return true;
 }
-void ClientSession::run() {
-    std::cout << "=== ЗАПУСК СЕССИИ ДЛЯ КЛИЕНТА ===" << std::endl;
-    
-    if (!auth()) {
-        logger_.log("Ошибка аутентификации", false);
-        close(sock_);
-        return;
-    }
-    
-    std::cout << "Аутентификация успешна, обработка векторов..." << std::endl;
-    
-    if (processVectors()) {
-        logger_.log("Обработка векторов завершена успешно");
-        std::cout << "=== СЕССИЯ ЗАВЕРШЕНА УСПЕШНО ===" << std::endl;
-    } else {
-        logger_.log("Ошибка обработки векторов", false);
-        std::cout << "=== СЕССИЯ ЗАВЕРШЕНА С ОШИБКАМИ ===" << std::endl;
+
+
+size_t ClientSession::feed(const char* data, size_t len) {
+    alloc_stats::Scope allocations(allocations_);
+    last_active_ns_.store(metrics::now(), std::memory_order_relaxed);
+    size_t consumed = 0;
+    while (consumed < len && wantsInput()) {
+        if (in_start_ > 0) {
+            memmove(in_.data(), in_.data() + in_start_, in_end_ - in_start_);
+            in_end_ -= in_start_;
+            in_start_ = 0;
+        }
+        size_t n = std::min(len - consumed, in_.size() - in_end_);
+        memcpy(in_.data() + in_end_, data + consumed, n);
+        captureBytes(capture::Kind::In, data + consumed, n);
+        in_end_ += n;
+        consumed += n;
+        // Как после EAGAIN: больше данных пока нет
+        input_drained_ = consumed == len;
+        step();
+        if (n == 0 && in_end_ == in_.size()) break;
     }
-    
-    close(sock_);
+    metrics::add(metrics::Counter::BytesIn, consumed);
+    return consumed;
+}
+
+void ClientSession::endOfInput() {
+    alloc_stats::Scope allocations(allocations_);
+    peer_closed_ = input_drained_ = true;
+    step();
+    if (state_ != State::Closing && state_ != State::Closed && !paused()) failOnEof();
+}
+
+void ClientSession::resume() {
+    alloc_stats::Scope allocations(allocations_);
+    if (!resumeIfDue(metrics::now())) return;
+    step();
+    if (peer_closed_ && state_ != State::Closing && state_ != State::Closed && !paused()) failOnEof();
+}
+
+void ClientSession::outputSent(size_t n) {
+    captureBytes(capture::Kind::Out, out_.data() + out_pos_, n);
+    out_pos_ += n;
+    metrics::add(metrics::Counter::BytesOut, n);
+    output_blocked_ = sendLimit() - out_pos_ >= kOutBufSize;
+    if (out_pos_ == out_.size()) outputFlushed();
 }
 
 Server::~Server() { stop(); }
@@ -366,54 +864,313 @@ bool Server::parseArgs(int argc, char* argv[]) {
             client_db_file_ = argv[++i];
         } else if (strcmp(argv[i], "-LU") == 0 && i + 1 < argc) {
             log_file_ = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            capture_file_ = argv[++i];
         } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
             address_ = argv[++i];
         } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
             port_ = std::stoi(argv[++i]);
-        }
-    }
-    
-    if (client_db_file_.empty()) {
-        std::cerr << "Ошибка: не указан файл базы клиентов" << std::endl;
-        printHelp();
-        return false;
-    }
-    
-    if (log_file_.empty()) {
-        std::cerr << "Ошибка: не указан файл логов" << std::endl;
-        printHelp();
-        return false;
-    }
-    
-    return true;
-}
-
-bool Server::init(int argc, char* argv[]) {
-    if (!parseArgs(argc, argv)) return false;
-    
-    logger_ = Logger(log_file_);
-    
-    if (!db_.load(client_db_file_)) {
-        logger_.log("Ошибка загрузки базы клиентов: " + client_db_file_, true);
-        return false;
+        } else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+            unix_path_ = argv[++i];
+            if (unix_path_.size() >= sizeof(sockaddr_un::sun_path)) {
+                std::cerr << "Ошибка: слишком длинный путь Unix-сокета" << std::endl;
+                return false;
+            }
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            size_t size = std::stoul(argv[++i]) * 1024;
+            if (size != 0 && (size < ShmRing::kMinSize || (size & (size - 1)) != 0)) {
+                std::cerr << "Ошибка: размер кольца — степень двойки не меньше " << ShmRing::kMinSize / 1024
+                          << " КиБ" << std::endl;
+                return false;
+            }
+            session_config_.ring_size = size;
+        } else if (strcmp(argv[i], "-LP") == 0 && i + 1 < argc) {
+            std::string policy = argv[++i];
+            if (policy == "block") {
+                log_overflow_ = Logger::Overflow::Block;
+            } else if (policy == "drop") {
+                log_overflow_ = Logger::Overflow::Drop;
+            } else {
+                std::cerr << "Ошибка: неизвестная политика буфера логов: " << policy << std::endl;
+                return false;
+            }
+        } else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+            trace::Level level;
+            if (!trace::parseLevel(argv[++i], level)) {
+                std::cerr << "Ошибка: неизвестный уровень трассировки: " << argv[i] << std::endl;
+                return false;
+            }
+            if (static_cast<int>(level) < static_cast<int>(trace::kCompiledLevel)) {
+                std::cerr << "Предупреждение: уровень трассировки ниже собранного (TRACE_LEVEL=" 
+                          << TRACE_LEVEL << ")" << std::endl;
+            }
+            trace::setLevel(level);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "wrap") {
+                session_config_.sum_mode = reduce::SumMode::Wrap;
+            } else if (mode == "check") {
+                session_config_.sum_mode = reduce::SumMode::Checked;
+            } else if (mode == "wide") {
+                session_config_.sum_mode = reduce::SumMode::Wide;
+            } else {
+                std::cerr << "Ошибка: неизвестный режим суммирования: " << mode << std::endl;
+                return false;
+            }
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            unsigned long size = std::stoul(argv[++i]);
+            if (size > UINT32_MAX) {
+                std::cerr << "Ошибка: размер вектора не может превышать " << UINT32_MAX << std::endl;
+                return false;
+            }
+            session_config_.max_vector_size = static_cast<uint32_t>(size);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            unsigned long count = std::stoul(argv[++i]);
+            if (count > proto::kCountMask) {
+                std::cerr << "Ошибка: число векторов в пакете не может превышать " << proto::kCountMask << std::endl;
+                return false;
+            }
+            session_config_.max_batch_vectors = static_cast<uint32_t>(count);
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            double seconds = std::stod(argv[++i]);
+            if (seconds < 0) {
+                std::cerr << "Ошибка: тайм-аут простоя не может быть отрицательным" << std::endl;
+                return false;
+            }
+            idle_timeout_ns_ = static_cast<uint64_t>(seconds * 1e9);
+        } else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            handoff_path_ = argv[++i];
+            if (handoff_path_.size() >= sizeof(sockaddr_un::sun_path)) {
+                std::cerr << "Ошибка: слишком длинный путь управляющего сокета" << std::endl;
+                return false;
+            }
+        } else if (strcmp(argv[i], "-W") == 0 && i + 1 < argc) {
+            double seconds = std::stod(argv[++i]);
+            if (seconds < 0) {
+                std::cerr << "Ошибка: срок дообслуживания не может быть отрицательным" << std::endl;
+                return false;
+            }
+            drain_timeout_ns_ = static_cast<uint64_t>(seconds * 1e9);
+        } else if (strcmp(argv[i], "-D") == 0 && i + 1 < argc) {
+            double seconds[3];
+            if (sscanf(argv[++i], "%lf,%lf,%lf", &seconds[0], &seconds[1], &seconds[2]) != 3 ||
+                seconds[0] < 0 || seconds[1] < 0 || seconds[2] < 0) {
+                std::cerr << "Ошибка: сроки фаз задаются как <аутентификация>,<заголовок>,<данные>" << std::endl;
+                return false;
+            }
+            for (size_t phase = 0; phase < 3; phase++) {
+                session_config_.deadline_ns[phase] = static_cast<uint64_t>(seconds[phase] * 1e9);
+            }
+        } else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc) {
+            max_sessions_ = std::stoul(argv[++i]);
+        } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            double vectors = 0, bytes = 0;
+            int n = sscanf(argv[++i], "%lf,%lf", &vectors, &bytes);
+            if (n < 1 || vectors < 0 || bytes < 0) {
+                std::cerr << "Ошибка: лимит задаётся как <векторов/с>[,<байт/с>]" << std::endl;
+                return false;
+            }
+            rate_limiter_.configure(vectors, bytes);
+            session_config_.rate_limiter = rate_limiter_.enabled() ? &rate_limiter_ : nullptr;
+        } else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) {
+            unsigned long threshold = 0, threads = 0;
+            int n = sscanf(argv[++i], "%lu,%lu", &threshold, &threads);
+            if (n < 1 || threshold > UINT32_MAX) {
+                std::cerr << "Ошибка: параллельная свёртка задаётся как <элементов>[,<потоков>]" << std::endl;
+                return false;
+            }
+            session_config_.parallel_threshold = static_cast<uint32_t>(threshold);
+            reduce_threads_ = threads;
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            int threads = std::stoi(argv[++i]);
+            if (threads < 1) {
+                std::cerr << "Ошибка: количество потоков должно быть положительным" << std::endl;
+                return false;
+            }
+            threads_ = static_cast<size_t>(threads);
+        } else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            ticket_lifetime_ = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+            snapshot_file_ = argv[++i];
+        } else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc) {
+            metrics_endpoint_ = argv[++i];
+        } else if (strcmp(argv[i], "-R") == 0 && i + 1 < argc) {
+            int shards = std::stoi(argv[++i]);
+            if (shards < 1) {
+                std::cerr << "Ошибка: количество шардов должно быть положительным" << std::endl;
+                return false;
+            }
+            shards_ = static_cast<size_t>(shards);
+        } else if (strcmp(argv[i], "-I") == 0) {
+            incoming_cpu_ = true;
+        } else if (strcmp(argv[i], "-U") == 0) {
+            io_uring_ = true;
+        } else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc) {
+            backlog_ = std::stoi(argv[++i]);
+            if (backlog_ < 1) {
+                std::cerr << "Ошибка: длина очереди соединений должна быть положительной" << std::endl;
+                return false;
+            }
+        }
+    }
+    
+    if (client_db_file_.empty()) {
+        std::cerr << "Ошибка: не указан файл базы клиентов" << std::endl;
+        printHelp();
+        return false;
+    }
+    
+    if (log_file_.empty() && snapshot_file_.empty()) {
+        std::cerr << "Ошибка: не указан файл логов" << std::endl;
+        printHelp();
+        return false;
+    }
+    
+    if (shards_ > 0 && threads_ > 1) {
+        std::cerr << "Предупреждение: в режиме шардов -t не используется" << std::endl;
+        threads_ = 1;
+    }
+    if (io_uring_ && threads_ > 1) {
+        std::cerr << "Предупреждение: в режиме io_uring -t не используется" << std::endl;
+        threads_ = 1;
+    }
+    
+    return true;
+}
+
+bool Server::init(int argc, char* argv[]) {
+    if (!parseArgs(argc, argv)) return false;
+
+    // Сигналы завершения и перезагрузки блокируются до запуска любых
+    // потоков и принимаются реактором через signalfd
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    sigaddset(&mask, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+    
+    logger_.setOverflowPolicy(log_overflow_);
+    if (!logger_.open(log_file_)) {
+        std::cerr << "Ошибка открытия файла логов: " << log_file_ << std::endl;
+        return false;
+    }
+    
+    if (!db_.load(client_db_file_)) {
+        logger_.log("Ошибка загрузки базы клиентов: " + client_db_file_, true);
+        return false;
+    }
+    
+    if (snapshotOnly()) {
+        if (!db_.writeSnapshot(snapshot_file_)) {
+            std::cerr << "Ошибка записи снимка базы клиентов: " << snapshot_file_ << std::endl;
+            return false;
+        }
+        std::cout << "Снимок базы клиентов записан: " << snapshot_file_ 
+                  << " (клиентов: " << db_.getClientCount() << ")" << std::endl;
+        return true;
+    }
+    
+    if (!auth_.init(ticket_lifetime_)) {
+        logger_.log("Ошибка создания ключа билетов возобновления", true);
+        return false;
     }
     
     std::cout << "Загружено клиентов: " << db_.getClientCount() << std::endl;
+    std::cout << "Реализация свёртки векторов: " << reduce::implementation() << std::endl;
+
+    // Сокеты забираются у работающего сервера только теперь, когда всё
+    // долгое (загрузка базы) позади: до этого момента он принимает клиентов
+    if (!handoff_path_.empty() && !takeOver()) return false;
+
+    if (!metrics_endpoint_.empty()) {
+        if (!metrics_.open(metrics_endpoint_, std::exchange(inherited_.metrics_fd, -1))) {
+            logger_.log("Ошибка открытия конечной точки метрик: " + metrics_endpoint_, true);
+            return false;
+        }
+        std::cout << "Метрики: " << metrics_endpoint_ << std::endl;
+    }
+
+    if (!capture_file_.empty()) {
+        if (!capture_.open(capture_file_)) {
+            logger_.log("Ошибка открытия файла трассы сессий: " + capture_file_, true);
+            return false;
+        }
+        session_config_.capture = &capture_;
+        std::cout << "Запись сессий: " << capture_file_ << std::endl;
+    }
     
     return true;
 }
 
-bool Server::start() {
-    server_sock_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_sock_ < 0) {
+bool Server::takeOver() {
+    int conn = handoff::connect(handoff_path_);
+    if (conn < 0) return true;   // на управляющем сокете никто не слушает — обычный запуск
+    if (!handoff::receive(conn, inherited_)) {
+        close(conn);
+        logger_.log("Ошибка получения сокетов от работающего сервера", true);
+        return false;
+    }
+    handoff_conn_ = conn;
+
+    // Сокет с другим адресом (настройки изменились) не нужен: его очередь
+    // дообслужит прежний процесс, а новый сокет откроется как обычно
+    std::string tcp_name = address_ + ":" + std::to_string(port_);
+    size_t wanted = shards_ > 0 ? shards_ : 1;
+    size_t kept = 0;
+    for (int fd : inherited_.tcp) {
+        if (kept < wanted && handoff::socketName(fd) == tcp_name) {
+            inherited_.tcp[kept++] = fd;
+        } else {
+            close(fd);
+        }
+    }
+    if (kept < inherited_.tcp.size()) {
+        logger_.logf("Не использовано полученных TCP-сокетов: %zu", inherited_.tcp.size() - kept);
+    }
+    inherited_.tcp.resize(kept);
+    if (inherited_.unix_fd >= 0 && handoff::socketName(inherited_.unix_fd) != unix_path_) {
+        close(inherited_.unix_fd);
+        inherited_.unix_fd = -1;
+    }
+    bool metrics_port = metrics_endpoint_.find_first_not_of("0123456789") == std::string::npos;
+    std::string metrics_name = metrics_port ? "127.0.0.1:" + metrics_endpoint_ : metrics_endpoint_;
+    if (inherited_.metrics_fd >= 0 &&
+        (metrics_endpoint_.empty() || handoff::socketName(inherited_.metrics_fd) != metrics_name)) {
+        close(inherited_.metrics_fd);
+        inherited_.metrics_fd = -1;
+    }
+
+    std::cout << "Получены сокеты работающего сервера: TCP " << inherited_.tcp.size()
+              << (inherited_.unix_fd >= 0 ? ", Unix-сокет" : "") << (inherited_.metrics_fd >= 0 ? ", метрики" : "")
+              << std::endl;
+    logger_.logf("Получены сокеты работающего сервера через %s: TCP %zu", handoff_path_.c_str(),
+                 inherited_.tcp.size());
+    return true;
+}
+
+bool Server::openListener(Reactor& reactor) {
+    reactor.listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (reactor.listen_fd < 0) {
         logger_.log("Ошибка создания сокета", true);
         return false;
     }
     
     int opt = 1;
-    if (setsockopt(server_sock_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+    if (setsockopt(reactor.listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
         logger_.log("Ошибка установки SO_REUSEADDR", false);
     }
+    // Шарды слушают один порт: ядро распределяет соединения между сокетами
+    if (shards_ > 0 && setsockopt(reactor.listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        logger_.log("Ошибка установки SO_REUSEPORT", true);
+        return false;
+    }
+    // Предпочитать сокет шарда, чьё ядро обрабатывает пакеты соединения
+    if (incoming_cpu_ && reactor.cpu >= 0 &&
+        setsockopt(reactor.listen_fd, SOL_SOCKET, SO_INCOMING_CPU, &reactor.cpu, sizeof(reactor.cpu)) < 0) {
+        logger_.log("Ошибка установки SO_INCOMING_CPU", false);
+    }
     
     sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
@@ -422,66 +1179,951 @@ bool Server::start() {
     
     if (inet_pton(AF_INET, address_.c_str(), &addr.sin_addr) <= 0) {
         logger_.log("Ошибка преобразования адреса: " + address_, true);
-        close(server_sock_);
         return false;
     }
     
-    if (bind(server_sock_, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    if (bind(reactor.listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
         logger_.log("Ошибка привязки сокета к адресу " + address_ + ":" + std::to_string(port_), true);
-        close(server_sock_);
         return false;
     }
     
-    if (listen(server_sock_, 10) < 0) {
+    if (listen(reactor.listen_fd, backlog_) < 0) {
         logger_.log("Ошибка прослушивания", true);
-        close(server_sock_);
         return false;
     }
+    return true;
+}
+
+bool Server::openUnixListener(Reactor& reactor) {
+    reactor.unix_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (reactor.unix_fd < 0) {
+        logger_.log("Ошибка создания Unix-сокета", true);
+        return false;
+    }
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, unix_path_.c_str(), unix_path_.size() + 1);
+    // Файл сокета от прежнего запуска мешает привязке
+    unlink(unix_path_.c_str());
+    if (bind(reactor.unix_fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        logger_.log("Ошибка привязки Unix-сокета " + unix_path_, true);
+        return false;
+    }
+
+    if (listen(reactor.unix_fd, backlog_) < 0) {
+        logger_.log("Ошибка прослушивания Unix-сокета", true);
+        return false;
+    }
+    return true;
+}
+
+bool Server::setupReactor(Reactor& reactor, bool with_signals) {
+    reactor.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (reactor.epoll_fd < 0) {
+        logger_.log("Ошибка создания epoll", true);
+        return false;
+    }
+
+    // Служебные дескрипторы помечаются адресами своих полей, сессии — своим
+    // адресом. Событие wake_fd_ не сбрасывается и будит все реакторы.
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &reactor.listen_fd;
+    if (epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, reactor.listen_fd, &ev) < 0) {
+        logger_.log("Ошибка регистрации сокета в epoll", true);
+        return false;
+    }
+    ev.data.ptr = &reactor.unix_fd;
+    if (reactor.unix_fd >= 0 && epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, reactor.unix_fd, &ev) < 0) {
+        logger_.log("Ошибка регистрации Unix-сокета в epoll", true);
+        return false;
+    }
+    ev.data.ptr = &wake_fd_;
+    if (epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, wake_fd_, &ev) < 0) {
+        logger_.log("Ошибка регистрации eventfd в epoll", true);
+        return false;
+    }
+    reactor.notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ev.data.ptr = &reactor.notify_fd;
+    if (reactor.notify_fd < 0 || epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, reactor.notify_fd, &ev) < 0) {
+        logger_.log("Ошибка регистрации eventfd реактора в epoll", true);
+        return false;
+    }
+    reactor.signals = with_signals;
+    ev.data.ptr = &signal_fd_;
+    if (with_signals && epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, signal_fd_, &ev) < 0) {
+        logger_.log("Ошибка регистрации signalfd в epoll", true);
+        return false;
+    }
+    return true;
+}
+
+bool Server::start() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    sigaddset(&mask, SIGUSR1);
+    signal_fd_ = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (signal_fd_ < 0 || wake_fd_ < 0) {
+        logger_.log("Ошибка создания signalfd/eventfd", true);
+        return false;
+    }
+
+    // Шарды привязываются по кругу к ядрам, доступным процессу
+    std::vector<int> cpus;
+    cpu_set_t allowed;
+    if (shards_ > 0 && sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+        }
+    }
+
+    size_t count = shards_ > 0 ? shards_ : 1;
+    for (size_t i = 0; i < count; i++) {
+        reactors_.push_back(std::make_unique<Reactor>(auth_, logger_, session_config_));
+        Reactor& reactor = *reactors_.back();
+        if (!cpus.empty()) reactor.cpu = cpus[i % cpus.size()];
+        // Сокеты, полученные от прежнего процесса, уже привязаны и слушают
+        if (i < inherited_.tcp.size()) {
+            reactor.listen_fd = std::exchange(inherited_.tcp[i], -1);
+        } else if (!openListener(reactor)) {
+            return false;
+        }
+        // Сигналы и Unix-сокет (он не поддерживает SO_REUSEPORT) достаются
+        // реактору главного потока
+        if (i == 0 && inherited_.unix_fd >= 0) {
+            reactor.unix_fd = std::exchange(inherited_.unix_fd, -1);
+        } else if (i == 0 && !unix_path_.empty() && !openUnixListener(reactor)) {
+            return false;
+        }
+        if (!setupReactor(reactor, i == 0)) return false;
+    }
+    inherited_.tcp.clear();
+
+    // Управляющий сокет занимается до подтверждения: следующее обновление
+    // уже пойдёт к этому процессу. Прежний, получив подтверждение, перестаёт
+    // принимать соединения
+    if (!handoff_path_.empty()) {
+        handoff_fd_ = handoff::listen(handoff_path_);
+        if (handoff_fd_ < 0) {
+            logger_.log("Ошибка открытия управляющего сокета " + handoff_path_, true);
+            return false;
+        }
+    }
+    if (handoff_conn_ >= 0) {
+        if (!handoff::confirm(handoff_conn_)) logger_.log("Прежний процесс не получил подтверждение");
+        close(handoff_conn_);
+        handoff_conn_ = -1;
+    }
+    
+    // При одном потоке сессии обслуживаются прямо в цикле реактора
+    if (threads_ > 1) {
+        pool_ = std::make_unique<WorkerPool>(threads_);
+    }
+    // Пул параллельной свёртки нужен, только если векторы такого размера
+    // вообще допустимы; на одном ядре без явного числа потоков он лишь
+    // добавил бы копирование
+    size_t reduce_threads = reduce_threads_ ? reduce_threads_ : std::thread::hardware_concurrency();
+    uint32_t threshold = session_config_.parallel_threshold;
+    if (threshold != 0 && (session_config_.max_vector_size == 0 || session_config_.max_vector_size >= threshold) &&
+        (reduce_threads_ != 0 || reduce_threads > 1)) {
+        reduce_pool_ = std::make_unique<WorkerPool>(reduce_threads);
+        session_config_.reduce_pool = reduce_pool_.get();
+    }
     
     running_ = true;
     
-    std::cout << "Сервер запущен на " << address_ << ":" << port_ << std::endl;
+    std::cout << "Сервер запущен на " << address_ << ":" << port_;
+    if (!unix_path_.empty()) std::cout << " и " << unix_path_;
+    if (shards_ > 0) std::cout << ", шардов: " << shards_;
+    std::cout << std::endl;
     std::cout << "Ожидание подключений..." << std::endl;
     
-    logger_.log("Сервер запущен на " + address_ + ":" + std::to_string(port_));
+    logger_.log("Сервер запущен на " + address_ + ":" + std::to_string(port_) +
+                (unix_path_.empty() ? "" : " и " + unix_path_));
     
+    for (size_t i = 1; i < reactors_.size(); i++) {
+        Reactor& reactor = *reactors_[i];
+        reactor.thread = std::thread([this, &reactor] { runReactor(reactor); });
+    }
+    if (handoff_fd_ >= 0) handoff_thread_ = std::thread(&Server::serveHandoff, this);
+    bool ok = runReactor(*reactors_[0]);
+    
+    // Остальные реакторы просыпаются по wake_fd_ и видят running_ == false
+    running_ = false;
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd_, &one, sizeof(one));
+    (void)written;
+    for (auto& reactor : reactors_) {
+        if (reactor->thread.joinable()) reactor->thread.join();
+    }
+    if (handoff_thread_.joinable()) handoff_thread_.join();
+    return ok;
+}
+
+namespace {
+
+// Выделения памяти потоком реактора или рабочим потоком попадают в метрики
+// перед ожиданием следующих событий (сборка ALLOC_STATS=1, make check)
+void publishAllocations() {
+    if (alloc_stats::kEnabled) {
+        metrics::add(metrics::Counter::HeapAllocations, alloc_stats::takeThreadAllocations());
+    }
+}
+
+}
+
+bool Server::runReactor(Reactor& reactor) {
+    if (reactor.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(reactor.cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+            logger_.logf("Ошибка привязки реактора к ядру %d", reactor.cpu);
+        }
+    }
+
+    // Кольцо создаётся в потоке реактора: с IORING_SETUP_SINGLE_ISSUER
+    // отправлять запросы может только создавший его поток
+    if (io_uring_) {
+        Uring ring;
+        if (ring.init(kUringEntries, kUringBuffers, kUringBufferSize)) {
+            return runUringReactor(reactor, ring);
+        }
+        logger_.log("io_uring недоступен, используется epoll");
+    }
+
+    std::vector<epoll_event> events(kMaxEvents);
+    uint64_t sweep_period = sweepPeriodNs();
+    int wait_ms = sweep_period ? static_cast<int>(sweep_period / 1000000) : -1;
+    uint64_t next_sweep = metrics::now() + sweep_period;
     while (running_) {
-        sockaddr_in client_addr;
-        socklen_t len = sizeof(client_addr);
-        int client_sock = accept(server_sock_, (sockaddr*)&client_addr, &len);
+        int n = epoll_wait(reactor.epoll_fd, events.data(), static_cast<int>(events.size()), wait_ms);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            logger_.log("Ошибка ожидания событий epoll", true);
+            running_ = false;
+            return false;
+        }
+        if (sweep_period && metrics::now() >= next_sweep) {
+            sweepSessions(reactor, nullptr);
+            next_sweep = metrics::now() + sweep_period;
+        }
         
-        if (client_sock < 0) {
-            if (running_) {
-                logger_.log("Ошибка принятия соединения", false);
+        for (int i = 0; i < n; i++) {
+            void* tag = events[i].data.ptr;
+            if (tag == &reactor.listen_fd || tag == &reactor.unix_fd) {
+                acceptClients(reactor, *static_cast<int*>(tag));
+                continue;
+            }
+            if (tag == &signal_fd_) {
+                handleSignals();
+                continue;
+            }
+            if (tag == &wake_fd_) {
+                continue;
+            }
+            if (tag == &reactor.notify_fd) {
+                uint64_t value;
+                ssize_t drained = read(reactor.notify_fd, &value, sizeof(value));
+                (void)drained;
+                if (handed_off_) stopAccepting(reactor, nullptr);
+                continue;
             }
+            auto* session = static_cast<ClientSession*>(tag);
+            if (!pool_) {
+                handleSession(reactor, session, events[i].events);
+                continue;
+            }
+            // Два указателя помещаются во встроенный буфер std::function:
+            // передача события рабочему потоку не выделяет память
+            session->setPendingEvents(events[i].events);
+            pool_->submit([this, session] {
+                handleSession(session->reactor(), session, session->pendingEvents());
+                publishAllocations();
+            });
+        }
+        publishAllocations();
+    }
+    
+    return true;
+}
+
+namespace {
+
+// user_data операций io_uring: адрес сессии (выровнен на 8) и тип операции
+// в младших битах; у служебных операций реактора адреса нет
+enum UringOp : uint64_t {
+    kOpRecv = 1, kOpSend = 2, kOpClose = 3, kOpAccept = 4, kOpSignal = 5, kOpWake = 6, kOpSweep = 7
+};
+
+constexpr uint64_t kOpMask = 7;
+
+uint64_t tag(ClientSession* session, UringOp op) {
+    return reinterpret_cast<uint64_t>(session) | op;
+}
+
+void prepPoll(io_uring_sqe* sqe, int fd, UringOp op) {
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = op;
+}
+
+// Таймер обхода сессий; timespec читается ядром при отправке SQE
+void prepSweep(io_uring_sqe* sqe, const __kernel_timespec* period) {
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(period);
+    sqe->len = 1;
+    sqe->user_data = kOpSweep;
+}
+
+// Один запрос принимает все последующие соединения (multishot); вместо
+// адреса сессии в user_data — слушающий сокет, чтобы перевзвести приём
+void prepAccept(io_uring_sqe* sqe, int fd) {
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = static_cast<uint64_t>(fd) << 3 | kOpAccept;
+}
+
+// Отмена приёма на слушающем сокете; ошибка отмены придёт с user_data 0
+// и будет пропущена
+void prepCancelAccept(io_uring_sqe* sqe, int fd) {
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+    sqe->addr = static_cast<uint64_t>(fd) << 3 | kOpAccept;
+}
+
+}
+
+bool Server::runUringReactor(Reactor& reactor, Uring& ring) {
+    logger_.log("Ввод-вывод через io_uring");
+    prepAccept(ring.sqe(), reactor.listen_fd);
+    if (reactor.unix_fd >= 0) prepAccept(ring.sqe(), reactor.unix_fd);
+    prepPoll(ring.sqe(), wake_fd_, kOpWake);
+    // Событие реактора отличается от общего wake_fd_ дескриптором в user_data
+    io_uring_sqe* notify = ring.sqe();
+    prepPoll(notify, reactor.notify_fd, kOpWake);
+    notify->user_data |= static_cast<uint64_t>(reactor.notify_fd) << 3;
+    if (reactor.signals) prepPoll(ring.sqe(), signal_fd_, kOpSignal);
+    uint64_t sweep_period = sweepPeriodNs();
+    __kernel_timespec sweep_ts;
+    sweep_ts.tv_sec = static_cast<int64_t>(sweep_period / 1000000000);
+    sweep_ts.tv_nsec = static_cast<long long>(sweep_period % 1000000000);
+    if (sweep_period) prepSweep(ring.sqe(), &sweep_ts);
+
+    // Сессии, которым не хватило буферов приёма (ENOBUFS). Операций в ядре
+    // у них нет, и закрыться сами они не могут; приём повторяется, когда
+    // какой-нибудь буфер вернётся в кольцо
+    std::vector<ClientSession*> starved;
+    while (running_) {
+        if (ring.submit(1) < 0 && errno != EBUSY) {
+            logger_.log("Ошибка io_uring_enter", true);
+            running_ = false;
+            return false;
+        }
+
+        uint64_t recycled = ring.recycled();
+        while (io_uring_cqe* cqe = ring.peek()) {
+            int res = cqe->res;
+            uint32_t flags = cqe->flags;
+            uint64_t data = cqe->user_data;
+            ring.advance();
+
+            auto* session = reinterpret_cast<ClientSession*>(data & ~kOpMask);
+            switch (static_cast<UringOp>(data & kOpMask)) {
+            case kOpAccept: {
+                int listen_fd = static_cast<int>(data >> 3);
+                bool listening = listen_fd == reactor.listen_fd || listen_fd == reactor.unix_fd;
+                if (!(flags & IORING_CQE_F_MORE) && running_ && listening) prepAccept(ring.sqe(), listen_fd);
+                if (res < 0) {
+                    if (res != -EAGAIN && res != -EINTR && res != -ECANCELED) {
+                        logger_.log("Ошибка принятия соединения");
+                    }
+                    break;
+                }
+                sockaddr_storage client_addr;
+                socklen_t len = sizeof(client_addr);
+                if (getpeername(res, (sockaddr*)&client_addr, &len) < 0) client_addr.ss_family = AF_UNSPEC;
+                if (!prepareClient(res, client_addr)) break;
+
+                ClientSession* accepted = reactor.session_pool.acquire(res);
+                accepted->setExternalIo(true);
+                {
+                    std::lock_guard<std::mutex> lock(reactor.sessions_mutex);
+                    if (static_cast<size_t>(res) >= reactor.sessions.size()) {
+                        reactor.sessions.resize(static_cast<size_t>(res) * 2 + 1, nullptr);
+                    }
+                    reactor.sessions[res] = accepted;
+                }
+                driveUring(reactor, ring, accepted);
+                break;
+            }
+            case kOpSignal:
+                handleSignals();
+                if (running_) prepPoll(ring.sqe(), signal_fd_, kOpSignal);
+                break;
+            case kOpWake:
+                if (data >> 3 && handed_off_) stopAccepting(reactor, &ring);
+                break;
+            case kOpSweep:
+                sweepSessions(reactor, &ring);
+                if (running_) prepSweep(ring.sqe(), &sweep_ts);
+                break;
+            case kOpRecv: {
+                ClientSession::UringOps& ops = session->uringOps();
+                ops.inflight--;
+                ops.recv_armed = false;
+                if (flags & IORING_CQE_F_BUFFER) {
+                    uint16_t bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+                    if (res > 0 && !ops.closing) {
+                        ops.pending_bid = bid;
+                        ops.pending_offset = 0;
+                        ops.pending_len = static_cast<uint32_t>(res);
+                    } else {
+                        ring.recycle(bid);
+                    }
+                }
+                if (ops.closing) {
+                    releaseUring(reactor, session);
+                } else if (res == -ENOBUFS) {
+                    starved.push_back(session);
+                } else if (res == 0) {
+                    session->endOfInput();
+                    driveUring(reactor, ring, session);
+                } else if (res < 0) {
+                    logger_.log("Ошибка приема данных");
+                    teardownUring(reactor, ring, session);
+                } else {
+                    driveUring(reactor, ring, session);
+                }
+                break;
+            }
+            case kOpSend: {
+                ClientSession::UringOps& ops = session->uringOps();
+                ops.inflight--;
+                ops.send_inflight = false;
+                if (res > 0) session->outputSent(static_cast<size_t>(res));
+                if (ops.closing) {
+                    releaseUring(reactor, session);
+                } else if (res < 0) {
+                    logger_.log("Ошибка отправки данных");
+                    teardownUring(reactor, ring, session);
+                } else {
+                    driveUring(reactor, ring, session);
+                }
+                break;
+            }
+            case kOpClose: {
+                // Закрытие, связанное с последней отправкой; если отправка не
+                // удалась, оно отменяется и сокет закрывается обычным путём
+                ClientSession::UringOps& ops = session->uringOps();
+                ops.inflight--;
+                if (res == 0) {
+                    std::lock_guard<std::mutex> lock(reactor.sessions_mutex);
+                    reactor.sessions[session->fd()] = nullptr;
+                    session->forgetSocket();
+                }
+                releaseUring(reactor, session);
+                break;
+            }
+            }
+        }
+
+        if (!starved.empty() && ring.recycled() != recycled) {
+            std::vector<ClientSession*> retry;
+            retry.swap(starved);
+            for (ClientSession* session : retry) driveUring(reactor, ring, session);
+        }
+        publishAllocations();
+    }
+    return true;
+}
+
+void Server::driveUring(Reactor& reactor, Uring& ring, ClientSession* session) {
+    ClientSession::UringOps& ops = session->uringOps();
+    if (ops.closing) return;
+
+    // Принятые данные передаются сессии, только пока её ответ не в пути:
+    // feed() пишет в тот же выходной буфер, из которого идёт отправка
+    if (ops.pending_bid >= 0 && !ops.send_inflight) {
+        uint16_t bid = static_cast<uint16_t>(ops.pending_bid);
+        size_t n = session->feed(ring.buffer(bid) + ops.pending_offset, ops.pending_len);
+        ops.pending_offset += static_cast<uint32_t>(n);
+        ops.pending_len -= static_cast<uint32_t>(n);
+        if (ops.pending_len == 0 || !session->wantsInput()) {
+            ring.recycle(bid);
+            ops.pending_bid = -1;
+        }
+    }
+
+    ClientSession::State state = session->state();
+    if (state == ClientSession::State::Closed) {
+        teardownUring(reactor, ring, session);
+        return;
+    }
+    if (ops.send_inflight) return;
+
+    std::string_view out = session->pendingOutput();
+    if (!out.empty()) {
+        io_uring_sqe* send = ring.sqe();
+        send->opcode = IORING_OP_SEND;
+        send->fd = session->fd();
+        send->addr = reinterpret_cast<uint64_t>(out.data());
+        send->len = static_cast<uint32_t>(out.size());
+        send->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        send->user_data = tag(session, kOpSend);
+        ops.send_inflight = true;
+        ops.inflight++;
+        if (state == ClientSession::State::Closing) {
+            // Последний ответ: закрытие сокета связано с отправкой и
+            // выполняется ядром сразу после неё, без лишнего прохода цикла
+            send->flags |= IOSQE_IO_LINK;
+            io_uring_sqe* close_sqe = ring.sqe();
+            close_sqe->opcode = IORING_OP_CLOSE;
+            close_sqe->fd = session->fd();
+            close_sqe->user_data = tag(session, kOpClose);
+            ops.inflight++;
+            ops.closing = true;
+        }
+        return;
+    }
+    if (state == ClientSession::State::Closing) {
+        teardownUring(reactor, ring, session);
+        return;
+    }
+    // Сессию на паузе возобновит обход реактора
+    if (session->paused()) {
+        session->park();
+        return;
+    }
+
+    // Следующий приём — только когда прежний буфер поглощён и ответ
+    // отправлен: медленный клиент не занимает буферы кольца
+    if (ops.pending_bid < 0 && !ops.recv_armed && session->wantsInput()) {
+        io_uring_sqe* recv = ring.sqe();
+        recv->opcode = IORING_OP_RECV;
+        recv->fd = session->fd();
+        recv->flags = IOSQE_BUFFER_SELECT;
+        recv->buf_group = Uring::kBufGroup;
+        recv->user_data = tag(session, kOpRecv);
+        ops.recv_armed = true;
+        ops.inflight++;
+    }
+}
+
+void Server::teardownUring(Reactor& reactor, Uring& ring, ClientSession* session) {
+    ClientSession::UringOps& ops = session->uringOps();
+    ops.closing = true;
+    if (ops.pending_bid >= 0) {
+        ring.recycle(static_cast<uint16_t>(ops.pending_bid));
+        ops.pending_bid = -1;
+    }
+    // Незавершённые операции прерываются; сессия освобождается после
+    // завершения всех операций, ссылающихся на неё
+    if (ops.inflight > 0) shutdown(session->fd(), SHUT_RDWR);
+    releaseUring(reactor, session);
+}
+
+void Server::releaseUring(Reactor& reactor, ClientSession* session) {
+    ClientSession::UringOps& ops = session->uringOps();
+    if (!ops.closing || ops.inflight > 0) return;
+    if (session->fd() >= 0) {
+        std::lock_guard<std::mutex> lock(reactor.sessions_mutex);
+        reactor.sessions[session->fd()] = nullptr;
+        session->close();
+    }
+    reactor.session_pool.release(session);
+    active_sessions_.fetch_sub(1, std::memory_order_relaxed);
+    trace::print<trace::Level::Debug>("Соединение закрыто");
+}
+
+void Server::stopAccepting(Reactor& reactor, Uring* ring) {
+    // Слушающие сокеты теперь общие с новым процессом: закрытие здесь лишь
+    // отпускает нашу ссылку, но регистрацию в epoll и приём в io_uring
+    // нужно снять явно, иначе они переживут закрытие дескриптора
+    for (int* fd : {&reactor.listen_fd, &reactor.unix_fd}) {
+        if (*fd < 0) continue;
+        if (ring) {
+            prepCancelAccept(ring->sqe(), *fd);
+        } else {
+            epoll_ctl(reactor.epoll_fd, EPOLL_CTL_DEL, *fd, nullptr);
+        }
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+void Server::serveHandoff() {
+    pollfd fds[2] = {{handoff_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[1].revents || !running_) return;
+        if (!(fds[0].revents & POLLIN)) continue;
+        int conn = accept4(handoff_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (conn < 0) continue;
+        if (!handoff::trustedPeer(conn)) {
+            close(conn);
+            logger_.log("Запрос передачи сокетов от процесса другого пользователя отклонён");
             continue;
         }
-        
+
+        handoff::Sockets sockets;
+        for (auto& reactor : reactors_) sockets.tcp.push_back(reactor->listen_fd);
+        sockets.unix_fd = reactors_[0]->unix_fd;
+        sockets.metrics_fd = metrics_.fd();
+        logger_.log("Передача слушающих сокетов новому процессу");
+        bool ok = handoff::send(conn, sockets, 10000);
+        close(conn);
+        if (ok) break;
+        // Новый процесс не запустился: продолжаем работать сами
+        logger_.log("Новый процесс не подтвердил приём сокетов, работа продолжается", true);
+    }
+
+    // Файлы сокетов теперь принадлежат новому процессу
+    handed_off_ = true;
+    close(handoff_fd_);
+    handoff_fd_ = -1;
+    metrics_.handOff();
+    for (auto& reactor : reactors_) {
+        uint64_t one = 1;
+        ssize_t written = write(reactor->notify_fd, &one, sizeof(one));
+        (void)written;
+    }
+    size_t active = active_sessions_.load(std::memory_order_relaxed);
+    std::cout << "Сокеты переданы новому процессу, активных сессий: " << active << std::endl;
+    logger_.logf("Сокеты переданы новому процессу, дообслуживание активных сессий: %zu", active);
+
+    // Дообслуживаем открытые сессии; новые сюда уже не приходят
+    uint64_t deadline = metrics::now() + drain_timeout_ns_;
+    while (running_ && active_sessions_.load(std::memory_order_relaxed) > 0 &&
+           (drain_timeout_ns_ == 0 || metrics::now() < deadline)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    active = active_sessions_.load(std::memory_order_relaxed);
+    if (active > 0) logger_.logf("Срок дообслуживания истёк, незавершённых сессий: %zu", active);
+    running_ = false;
+    uint64_t one = 1;
+    ssize_t written = write(wake_fd_, &one, sizeof(one));
+    (void)written;
+}
+
+uint64_t Server::sweepPeriodNs() const {
+    // Тайм-аут и сроки срабатывают с опозданием не больше четверти
+    // кратчайшего из них
+    uint64_t shortest = idle_timeout_ns_;
+    for (uint64_t timeout : session_config_.deadline_ns) {
+        if (timeout && (shortest == 0 || timeout < shortest)) shortest = timeout;
+    }
+    uint64_t period = shortest ? std::clamp<uint64_t>(shortest / 4, 10000000, 1000000000) : 0;
+    // Паузы по лимиту скорости снимаются с опозданием не больше 10 мс
+    if (session_config_.rate_limiter && (period == 0 || period > 10000000)) period = 10000000;
+    return period;
+}
+
+void Server::sweepSessions(Reactor& reactor, Uring* ring) {
+    static const char* const kDeadlineNames[] = {"аутентификации", "заголовка", "данных вектора"};
+    uint64_t now = metrics::now();
+    std::unique_lock<std::mutex> lock(reactor.sessions_mutex);
+    for (ClientSession* session : reactor.sessions) {
+        if (!session) continue;
+        if (session->parked() && now >= session->pausedUntil() && session->unpark()) {
+            reactor.resumed.push_back(session);
+            continue;
+        }
+        // Сессия на паузе ждёт сервер, а не клиента
+        if (session->paused()) continue;
+        // Время активности обновляют рабочие потоки, оно может оказаться позже now
+        uint64_t last = session->lastActive();
+        uint64_t deadline = session->deadline();
+        bool idle = idle_timeout_ns_ && last < now && now - last >= idle_timeout_ns_;
+        bool late = deadline && now > deadline;
+        if ((!idle && !late) || !session->expire()) continue;
+        // Сессию закрывает её обычный обработчик: после shutdown сокет
+        // сообщает о конце данных, и ожидающий приём завершается
+        shutdown(session->fd(), SHUT_RDWR);
+        if (late) {
+            metrics::add(metrics::Counter::DeadlineExceeded);
+            logger_.logf("Соединение закрыто: истёк срок %s",
+                         kDeadlineNames[static_cast<size_t>(session->deadlinePhase())]);
+        } else {
+            metrics::add(metrics::Counter::IdleTimeouts);
+            logger_.logf("Соединение закрыто по тайм-ауту простоя (%.1f с)", static_cast<double>(now - last) / 1e9);
+        }
+    }
+    lock.unlock();
+
+    // Возобновление может закрыть сессию, что требует sessions_mutex. В
+    // epoll перевзведённая сессия сразу получает EPOLLOUT, и её
+    // обрабатывает обычный обработчик событий
+    for (ClientSession* session : reactor.resumed) {
+        if (ring) {
+            session->resume();
+            driveUring(reactor, *ring, session);
+            continue;
+        }
+        epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = sessionEvents(*session) | EPOLLOUT;
+        ev.data.ptr = session;
+        if (epoll_ctl(reactor.epoll_fd, EPOLL_CTL_MOD, session->fd(), &ev) < 0) {
+            logger_.log("Ошибка перерегистрации клиента в epoll", false);
+            closeSession(reactor, session);
+        }
+    }
+    reactor.resumed.clear();
+}
+
+bool Server::admit(int fd) {
+    // Сверх лимита соединение отклоняется сразу, до создания сессии и
+    // проверки хеша: клиент получает ERR вместо ответа на аутентификацию
+    size_t active = active_sessions_.fetch_add(1, std::memory_order_relaxed);
+    if (max_sessions_ == 0 || active < max_sessions_) return true;
+    active_sessions_.fetch_sub(1, std::memory_order_relaxed);
+    send(fd, "ERR", 3, MSG_DONTWAIT | MSG_NOSIGNAL);
+    close(fd);
+    metrics::add(metrics::Counter::RejectedBusy);
+    logger_.logf("Соединение отклонено: активных сессий %zu из %zu", active, max_sessions_);
+    return false;
+}
+
+bool Server::prepareClient(int fd, const sockaddr_storage& addr) {
+    if (addr.ss_family == AF_INET) {
+        const auto& in = reinterpret_cast<const sockaddr_in&>(addr);
         char client_ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
-        
-        std::cout << "Новое соединение от " 
-                  << client_ip << ":" 
-                  << ntohs(client_addr.sin_port) << std::endl;
+        inet_ntop(AF_INET, &in.sin_addr, client_ip, INET_ADDRSTRLEN);
+        trace::print<trace::Level::Debug>("Новое соединение от ", client_ip, ":", ntohs(in.sin_port));
+        logger_.logf("Новое соединение от %s:%u", client_ip, ntohs(in.sin_port));
+    } else {
+        trace::print<trace::Level::Debug>("Новое соединение через Unix-сокет");
+        logger_.log("Новое соединение через Unix-сокет");
+    }
+    metrics::add(metrics::Counter::Connections);
+    if (!admit(fd)) return false;
+
+    // Ответы собираются в пачки самим сервером, поэтому алгоритм Нейгла
+    // только добавил бы задержку к последнему сегменту
+    if (addr.ss_family == AF_INET) {
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+    return true;
+}
+
+void Server::acceptClients(Reactor& reactor, int listen_fd) {
+    // Принимаем все ожидающие соединения (edge-triggered: до EAGAIN)
+    for (;;) {
+        sockaddr_storage client_addr;
+        socklen_t len = sizeof(client_addr);
+        int client_sock = accept4(listen_fd, (sockaddr*)&client_addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
         
-        logger_.log("Новое соединение от " + 
-                   std::string(client_ip) + ":" +
-                   std::to_string(ntohs(client_addr.sin_port)));
+        if (client_sock < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK && running_) {
+                logger_.log("Ошибка принятия соединения", false);
+            }
+            return;
+        }
+        if (!prepareClient(client_sock, client_addr)) continue;
         
-        ClientSession session(client_sock, db_, logger_);
-        session.run();
+        ClientSession* session = reactor.session_pool.acquire(client_sock);
+        {
+            std::lock_guard<std::mutex> lock(reactor.sessions_mutex);
+            if (static_cast<size_t>(client_sock) >= reactor.sessions.size()) {
+                reactor.sessions.resize(static_cast<size_t>(client_sock) * 2 + 1, nullptr);
+            }
+            reactor.sessions[client_sock] = session;
+        }
         
-        std::cout << "Соединение закрыто" << std::endl;
+        epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = sessionEvents(*session);
+        ev.data.ptr = session;
+        if (epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, client_sock, &ev) < 0) {
+            logger_.log("Ошибка регистрации клиента в epoll", false);
+            closeSession(reactor, session);
+        }
+    }
+}
+
+void Server::handleSignals() {
+    signalfd_siginfo info;
+    while (read(signal_fd_, &info, sizeof(info)) == sizeof(info)) {
+        if (info.ssi_signo == SIGINT || info.ssi_signo == SIGTERM) {
+            logger_.log("Получен сигнал завершения: " + std::to_string(info.ssi_signo));
+            running_ = false;
+            uint64_t one = 1;
+            ssize_t written = write(wake_fd_, &one, sizeof(one));
+            (void)written;
+        } else if (info.ssi_signo == SIGHUP) {
+            // Загрузка идёт в отдельном потоке: реактор продолжает
+            // обслуживать клиентов по старому снимку
+            if (reloading_.exchange(true)) {
+                logger_.log("Перезагрузка базы клиентов уже выполняется");
+                continue;
+            }
+            if (reload_thread_.joinable()) reload_thread_.join();
+            logger_.log("Получен SIGHUP, перезагрузка базы клиентов: " + client_db_file_);
+            reload_thread_ = std::thread(&Server::reloadClients, this);
+        } else if (info.ssi_signo == SIGUSR1) {
+            std::cout << metrics::render() << std::flush;
+        }
+    }
+}
+
+void Server::reloadClients() {
+    if (db_.load(client_db_file_)) {
+        logger_.logf("База клиентов перезагружена, клиентов: %zu", db_.getClientCount());
+    } else {
+        logger_.log("Ошибка перезагрузки базы клиентов, продолжаем со старой: " + client_db_file_, true);
+    }
+    reloading_ = false;
+}
+
+uint32_t Server::sessionEvents(const ClientSession& session) const {
+    if (!pool_) {
+        return EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    }
+    // С пулом каждое событие доставляется один раз и перевзводится после
+    // обработки; EPOLLOUT нужен, только пока есть неотправленные данные
+    uint32_t events = EPOLLIN | EPOLLRDHUP | EPOLLET | EPOLLONESHOT;
+    if (session.wantsWrite()) events |= EPOLLOUT;
+    return events;
+}
+
+void Server::handleSession(Reactor& reactor, ClientSession* session, uint32_t events) {
+    if (!session->onEvent(events)) {
+        closeSession(reactor, session);
+        return;
+    }
+    // Сессию на паузе перевзведёт обход реактора
+    if (session->paused()) {
+        session->park();
+        return;
+    }
+    if (pool_) {
+        epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = sessionEvents(*session);
+        ev.data.ptr = session;
+        if (epoll_ctl(reactor.epoll_fd, EPOLL_CTL_MOD, session->fd(), &ev) < 0) {
+            logger_.log("Ошибка перерегистрации клиента в epoll", false);
+            closeSession(reactor, session);
+        }
     }
-    
-    return true;
+}
+
+void Server::closeSession(Reactor& reactor, ClientSession* session) {
+    int fd = session->fd();
+    epoll_ctl(reactor.epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    {
+        // Дескриптор закрывается внутри критической секции, поэтому новый
+        // клиент с тем же номером не может быть добавлен раньше удаления
+        std::lock_guard<std::mutex> lock(reactor.sessions_mutex);
+        reactor.sessions[fd] = nullptr;
+        session->close();
+    }
+    reactor.session_pool.release(session);
+    active_sessions_.fetch_sub(1, std::memory_order_relaxed);
+    trace::print<trace::Level::Debug>("Соединение закрыто");
 }
 
 void Server::stop() {
+    if (stopped_) return;
+    stopped_ = true;
     running_ = false;
-    if (server_sock_ != -1) {
-        close(server_sock_);
-        server_sock_ = -1;
+    if (pool_) {
+        pool_->stop();
+        pool_.reset();
+    }
+    // Файлы сокетов удаляет только их владелец: не процесс, передавший
+    // их новому, и не процесс, так и не подтвердивший их приём
+    bool owns_paths = !handed_off_ && handoff_conn_ < 0;
+    if (handoff_thread_.joinable()) handoff_thread_.join();
+    if (handoff_fd_ != -1) {
+        close(handoff_fd_);
+        handoff_fd_ = -1;
+        if (owns_paths) unlink(handoff_path_.c_str());
+    }
+    if (handoff_conn_ != -1) {
+        close(handoff_conn_);
+        handoff_conn_ = -1;
+    }
+    inherited_.close();
+    for (auto& reactor : reactors_) {
+        if (reactor->listen_fd != -1) {
+            close(reactor->listen_fd);
+            reactor->listen_fd = -1;
+        }
+        if (reactor->unix_fd != -1) {
+            close(reactor->unix_fd);
+            reactor->unix_fd = -1;
+            if (owns_paths) unlink(unix_path_.c_str());
+        }
+        if (reactor->notify_fd != -1) {
+            close(reactor->notify_fd);
+            reactor->notify_fd = -1;
+        }
+        {
+            std::lock_guard<std::mutex> lock(reactor->sessions_mutex);
+            for (ClientSession*& session : reactor->sessions) {
+                if (session) {
+                    reactor->session_pool.release(session);
+                    session = nullptr;
+                }
+            }
+        }
+        if (reactor->epoll_fd != -1) {
+            close(reactor->epoll_fd);
+            reactor->epoll_fd = -1;
+        }
+    }
+    reactors_.clear();
+    // Все сессии закрыты и дописали в трассу свои последние записи
+    if (session_config_.capture) {
+        capture_.close();
+        if (capture_.dropped()) {
+            logger_.logf("Трасса сессий неполна: отброшено %llu байт",
+                         static_cast<unsigned long long>(capture_.dropped()));
+        }
+    }
+    // Сессии дождались своих блоков при закрытии, теперь пул свёртки свободен
+    if (reduce_pool_) {
+        reduce_pool_->stop();
+        reduce_pool_.reset();
+    }
+    if (signal_fd_ != -1) {
+        close(signal_fd_);
+        signal_fd_ = -1;
+    }
+    if (wake_fd_ != -1) {
+        close(wake_fd_);
+        wake_fd_ = -1;
+    }
+    if (reload_thread_.joinable()) {
+        reload_thread_.join();
+    }
+    if (owns_paths) {
+        metrics_.close();
+    } else {
+        metrics_.handOff();
+    }
+    if (!snapshotOnly()) {
+        logger_.log("Сервер остановлен");
     }
-    logger_.log("Сервер остановлен");
+    // Дописываем накопленные записи журнала
+    logger_.close();
 }
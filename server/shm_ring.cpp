@@ -0,0 +1,142 @@
+#include "shm_ring.h"
+
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+long futex(std::atomic<uint32_t>& word, int op, uint32_t value, const timespec* timeout) {
+    // Без FUTEX_PRIVATE_FLAG: слово находится в памяти, общей для процессов
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), op, value, timeout, nullptr, 0);
+}
+
+bool validSize(size_t size) {
+    return size >= ShmRing::kMinSize && (size & (size - 1)) == 0 &&
+           size % static_cast<size_t>(sysconf(_SC_PAGESIZE)) == 0 &&
+           ShmRing::kHeaderSize % static_cast<size_t>(sysconf(_SC_PAGESIZE)) == 0;
+}
+
+}
+
+ShmRing::~ShmRing() {
+    unmap();
+    closeFd();
+}
+
+bool ShmRing::create(size_t size) {
+    if (!validSize(size)) return false;
+    fd_ = memfd_create("vector-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd_ < 0) return false;
+    // Запечатанный размер не даёт клиенту укоротить файл и вызвать SIGBUS
+    // при обращении сервера к кольцу
+    if (ftruncate(fd_, static_cast<off_t>(kHeaderSize + size)) < 0 ||
+        fcntl(fd_, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        closeFd();
+        return false;
+    }
+    size_ = size;
+    if (!map()) {
+        closeFd();
+        return false;
+    }
+    header_->size = size;
+    header_->magic = kMagic;
+    // Сервер начинает в ожидании: первая запись клиента сопровождается звонком
+    header_->server_waiting.store(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool ShmRing::attach(int fd) {
+    fd_ = fd;
+    struct stat st;
+    if (fstat(fd_, &st) < 0 || st.st_size <= static_cast<off_t>(kHeaderSize)) return false;
+    size_ = static_cast<size_t>(st.st_size) - kHeaderSize;
+    if (!validSize(size_) || !map()) return false;
+    return header_->magic == kMagic && header_->size == size_;
+}
+
+void ShmRing::closeFd() {
+    if (fd_ < 0) return;
+    close(fd_);
+    fd_ = -1;
+}
+
+bool ShmRing::map() {
+    // Резервируем адреса под заголовок и две копии данных, затем
+    // накладываем на них отображения файла
+    size_t total = kHeaderSize + 2 * size_;
+    void* base = mmap(nullptr, total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return false;
+    base_ = static_cast<char*>(base);
+    int prot = PROT_READ | PROT_WRITE;
+    if (mmap(base_, kHeaderSize + size_, prot, MAP_SHARED | MAP_FIXED, fd_, 0) == MAP_FAILED ||
+        mmap(base_ + kHeaderSize + size_, size_, prot, MAP_SHARED | MAP_FIXED, fd_,
+             static_cast<off_t>(kHeaderSize)) == MAP_FAILED) {
+        unmap();
+        return false;
+    }
+    header_ = reinterpret_cast<Header*>(base_);
+    data_ = base_ + kHeaderSize;
+    return true;
+}
+
+void ShmRing::unmap() {
+    if (!base_) return;
+    munmap(base_, kHeaderSize + 2 * size_);
+    base_ = data_ = nullptr;
+    header_ = nullptr;
+}
+
+void ShmRing::release(uint64_t tail) {
+    header_->tail.store(tail, std::memory_order_seq_cst);
+    if (header_->client_waiting.exchange(0, std::memory_order_seq_cst)) {
+        header_->space_seq.fetch_add(1, std::memory_order_release);
+        futex(header_->space_seq, FUTEX_WAKE, INT_MAX, nullptr);
+    }
+}
+
+bool ShmRing::idle(uint64_t seen_head) {
+    header_->server_waiting.store(1, std::memory_order_seq_cst);
+    if (header_->head.load(std::memory_order_seq_cst) == seen_head) return true;
+    header_->server_waiting.store(0, std::memory_order_relaxed);
+    return false;
+}
+
+size_t ShmRing::writable() const {
+    // seq_cst: после установки client_waiting чтение tail не должно
+    // переупорядочиться с ней (см. release)
+    uint64_t used = header_->head.load(std::memory_order_relaxed) - header_->tail.load(std::memory_order_seq_cst);
+    return size_ - static_cast<size_t>(used);
+}
+
+char* ShmRing::writePtr() const {
+    return data_ + (header_->head.load(std::memory_order_relaxed) & (size_ - 1));
+}
+
+bool ShmRing::commit(size_t n) {
+    header_->head.fetch_add(n, std::memory_order_seq_cst);
+    return header_->server_waiting.exchange(0, std::memory_order_seq_cst) != 0;
+}
+
+bool ShmRing::waitForSpace(size_t need, int timeout_ms) {
+    timespec timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+    for (;;) {
+        uint32_t seq = header_->space_seq.load(std::memory_order_acquire);
+        if (writable() >= need) return true;
+        header_->client_waiting.store(1, std::memory_order_seq_cst);
+        if (writable() >= need) {
+            header_->client_waiting.store(0, std::memory_order_relaxed);
+            return true;
+        }
+        if (futex(header_->space_seq, FUTEX_WAIT, seq, &timeout) < 0 && errno == ETIMEDOUT) {
+            return writable() >= need;
+        }
+    }
+}
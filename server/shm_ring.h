@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Кольцо в разделяемой памяти (memfd) для клиентов на том же хосте.
+//
+// Клиент, подключённый через Unix-сокет, запрашивает кольцо суффиксом 'M'
+// сообщения аутентификации. Сервер создаёт memfd, запечатывает его размер
+// и передаёт дескриптор через SCM_RIGHTS вместе с ответом "OK"; ответ без
+// дескриптора означает, что сессия продолжается через сокет. Дальше клиент
+// пишет в кольцо тот же поток байт, что отправлял бы в сокет, а сервер
+// сворачивает векторы прямо из кольца. В сокете остаются ответы сервера,
+// конец сессии и «звонки» клиента — любые байты от клиента будят сервер.
+//
+// Область данных отображается дважды подряд, поэтому любой непрерывный
+// фрагмент длиной до размера кольца доступен без разрыва на его границе.
+//
+// Ожидание без потерянных пробуждений: сервер, обработав всё, ставит
+// server_waiting и перечитывает head; клиент публикует head и снимает
+// server_waiting — если флаг стоял, клиент звонит. Упёршись в заполненное
+// кольцо, клиент ставит client_waiting и ждёт на futex space_seq; сервер,
+// освободив место, увеличивает space_seq и будит клиента.
+class ShmRing {
+public:
+    static constexpr uint32_t kMagic = 0x31474E52;   // "RNG1"
+    static constexpr size_t kHeaderSize = 4096;
+    static constexpr size_t kMinSize = 64 * 1024;
+
+    struct Header {
+        uint32_t magic;
+        uint32_t reserved;
+        uint64_t size;
+        alignas(64) std::atomic<uint64_t> head;           // пишет клиент
+        alignas(64) std::atomic<uint64_t> tail;           // пишет сервер
+        alignas(64) std::atomic<uint32_t> server_waiting;
+        std::atomic<uint32_t> client_waiting;
+        std::atomic<uint32_t> space_seq;                  // слово futex
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "атомики кольца должны работать между процессами");
+    static_assert(sizeof(Header) <= kHeaderSize, "заголовок кольца не помещается в страницу");
+
+    ShmRing() = default;
+    ~ShmRing();
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    // Сервер: новое кольцо из size байт данных (степень двойки, не меньше kMinSize)
+    bool create(size_t size);
+    // Клиент: отображение кольца из полученного дескриптора (дескриптор
+    // переходит во владение кольца)
+    bool attach(int fd);
+    // Дескриптор больше не нужен — отображение остаётся
+    void closeFd();
+    int fd() const { return fd_; }
+    size_t size() const { return size_; }
+    char* data() const { return data_; }
+
+    // Сторона сервера
+    uint64_t head() const { return header_->head.load(std::memory_order_acquire); }
+    // Публикует освобождённое место и будит ожидающего клиента
+    void release(uint64_t tail);
+    // Перед сном: true, если после установки server_waiting head всё ещё
+    // равен seen_head и клиент обязан позвонить
+    bool idle(uint64_t seen_head);
+
+    // Сторона клиента
+    size_t writable() const;
+    char* writePtr() const;
+    // Публикует n записанных байт; true — сервер спит и нужен звонок
+    bool commit(size_t n);
+    // Ждёт, пока освободится need байт; false по истечении timeout_ms
+    bool waitForSpace(size_t need, int timeout_ms);
+
+private:
+    int fd_ = -1;
+    size_t size_ = 0;
+    char* base_ = nullptr;
+    char* data_ = nullptr;
+    Header* header_ = nullptr;
+
+    bool map();
+    void unmap();
+};
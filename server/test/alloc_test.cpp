@@ -0,0 +1,153 @@
+// Проверка отсутствия выделений памяти в установившемся режиме (make check).
+// Сервер собирается с ALLOC_STATS=1 (test/server_alloc) и публикует число
+// выделений в куче своими потоками в метрике server_heap_allocations_total.
+// Для каждого режима клиента после прогрева выполняется серия запросов, и
+// метрика до и после неё должна совпасть. Сервер должен работать в режиме
+// суммирования wrap и знать пользователя user с паролем P@ssW0rd.
+//
+//   ./test/alloc_test -p <port> -M <путь конечной точки метрик>
+
+#include "../codec.h"
+#include "../protocol.h"
+#include "fixture.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace fixture;
+
+namespace {
+
+constexpr int kWarmup = 50;
+// Соединений, одновременно открытых при прогреве: пул сессий сервера растёт
+// до наибольшего числа одновременных сессий, и это не считается
+constexpr int kWarmupSessions = 8;
+constexpr int kRequests = 500;
+constexpr uint32_t kBatchVectors = 10;
+constexpr uint32_t kVectorSize = 1000;
+
+int port = 33333;
+std::string metrics_path;
+
+// Пакет собирается один раз и отправляется каждым запросом
+std::string buildBatch(bool compact, uint32_t flags) {
+    std::string batch;
+    put32(batch, kBatchVectors | flags);
+    std::mt19937_64 rng(42);
+    std::vector<int64_t> values(kVectorSize);
+    for (uint32_t i = 0; i < kBatchVectors; i++) {
+        put32(batch, kVectorSize);
+        for (int64_t& v : values) v = static_cast<int64_t>(rng() % 2000001) - 1000000;
+        if (compact) {
+            codec::encode(values.data(), values.size(), batch);
+            continue;
+        }
+        for (int64_t v : values) batch += le64(v);
+    }
+    return batch;
+}
+
+// Значение server_heap_allocations_total; -1 — метрика недоступна
+int64_t allocations() {
+    // Потоки сервера публикуют выделения, закончив обработку событий
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int fd = connectUnix(metrics_path);
+    if (fd < 0) return -1;
+    std::string text;
+    if (sendAll(fd, "\n")) recvUntilClose(fd, text);
+    close(fd);
+    const std::string name = "\nserver_heap_allocations_total ";
+    size_t pos = text.find(name);
+    return pos == std::string::npos ? -1 : std::atoll(text.c_str() + pos + name.size());
+}
+
+struct Mode {
+    const char* name;
+    bool compact;
+    bool keep_alive;
+};
+
+// Выполняет count запросов: с keep_alive — пакетов в одном соединении,
+// иначе — соединений с одним пакетом
+bool run(const Mode& mode, int count) {
+    const std::string auth = authMessage(mode.compact ? "Z" : "");
+    const std::string batch = buildBatch(mode.compact, mode.keep_alive ? proto::kFlagKeepAlive : 0);
+    const size_t reply = 8 * kBatchVectors;
+    std::string received;
+    if (mode.keep_alive) {
+        int fd = connectTcp(port);
+        bool ok = fd >= 0 && sendAll(fd, auth) && recvExact(fd, 2, received);
+        for (int i = 0; ok && i < count; i++) {
+            received.clear();
+            ok = sendAll(fd, batch) && recvExact(fd, reply, received);
+        }
+        if (fd >= 0) close(fd);
+        return ok;
+    }
+    for (int i = 0; i < count; i++) {
+        int fd = connectTcp(port);
+        // Следующее соединение — после закрытия этого сервером
+        char eof;
+        received.clear();
+        bool ok = fd >= 0 && sendAll(fd, auth + batch) && recvExact(fd, 2 + reply, received) &&
+                  recv(fd, &eof, 1, 0) == 0;
+        if (fd >= 0) close(fd);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// Заполняет пул сессий сервера одновременными соединениями
+bool fillSessionPool() {
+    std::vector<int> fds;
+    std::string received;
+    bool ok = true;
+    for (int i = 0; ok && i < kWarmupSessions; i++) {
+        int fd = connectTcp(port);
+        ok = fd >= 0 && sendAll(fd, authMessage()) && recvExact(fd, 2, received);
+        if (fd >= 0) fds.push_back(fd);
+    }
+    for (int fd : fds) close(fd);
+    return ok;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-p") == 0) port = std::atoi(argv[i + 1]);
+        if (strcmp(argv[i], "-M") == 0) metrics_path = argv[i + 1];
+    }
+    if (allocations() < 0) {
+        printf("FAIL метрика server_heap_allocations_total недоступна\n");
+        return 1;
+    }
+
+    const Mode modes[] = {
+        {"пакет на соединение", false, false},
+        {"keep-alive", false, true},
+        {"компактное кодирование", true, false},
+        {"компактное кодирование, keep-alive", true, true},
+    };
+    for (const Mode& mode : modes) {
+        bool ok = fillSessionPool() && run(mode, kWarmup);
+        int64_t before = allocations();
+        ok = ok && run(mode, kRequests);
+        int64_t after = allocations();
+        std::string what = std::string(mode.name) + ": ";
+        what += ok ? std::to_string(after - before) + " выделений на " + std::to_string(kRequests) + " запросов"
+                   : "ошибка обмена с сервером";
+        check(ok && before >= 0 && after == before, what);
+    }
+
+    return summary();
+}
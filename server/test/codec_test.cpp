@@ -0,0 +1,231 @@
+// Проверка компактного кодирования (make check): блоки каждого способа
+// собираются здесь вручную, независимо от codec::encode, и сверяются с
+// результатом decodeBlock; затем векторы проходят encode и обратно. Ширины
+// полей 0, 1, 57, 59 (поле со сдвигом уже не помещается в 8 байт), 63 и
+// 64, разности с переполнением на границах int64, короткий последний блок;
+// обрезанный блок даёт NeedMore, ширина больше 64 — Invalid. Всё — под
+// каждой реализацией распаковки.
+//
+//   ./test/codec_test
+
+#include "../codec.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <endian.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    printf("%s %s\n", ok ? "ok  " : "FAIL", what.c_str());
+    if (!ok) failures++;
+}
+
+uint64_t zigzag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+void putVarint(std::string& out, uint64_t v) {
+    for (; v >= 0x80; v >>= 7) out += static_cast<char>(v | 0x80);
+    out += static_cast<char>(v);
+}
+
+// Разности соседних элементов, начиная от prev (с переполнением)
+std::vector<int64_t> deltas(const std::vector<int64_t>& values, uint64_t prev) {
+    std::vector<int64_t> out;
+    for (int64_t x : values) {
+        out.push_back(static_cast<int64_t>(static_cast<uint64_t>(x) - prev));
+        prev = static_cast<uint64_t>(x);
+    }
+    return out;
+}
+
+// Блок распаковки битов: поля ширины w от base, бит за битом
+std::string bitBlock(const std::vector<int64_t>& fields, bool delta, unsigned w, int64_t base) {
+    std::string out(1, static_cast<char>((delta ? proto::kBlockDelta : 0) | w));
+    putVarint(out, zigzag(base));
+    std::string packed((fields.size() * w + 7) / 8, '\0');
+    size_t bit = 0;
+    for (int64_t field : fields) {
+        uint64_t v = static_cast<uint64_t>(field) - static_cast<uint64_t>(base);
+        for (unsigned b = 0; b < w; b++, bit++) {
+            if (v >> b & 1) packed[bit / 8] = static_cast<char>(packed[bit / 8] | 1 << (bit % 8));
+        }
+    }
+    return out + packed;
+}
+
+std::string varintBlock(const std::vector<int64_t>& fields, bool delta) {
+    std::string out(1, static_cast<char>(delta ? proto::kBlockDeltaVarint : proto::kBlockVarint));
+    for (int64_t field : fields) putVarint(out, zigzag(field));
+    return out;
+}
+
+// Декодирует n элементов блоками по kBlockSize; false при любой ошибке.
+// В modes отмечаются встреченные способы: биты, разности, varint, разности
+// varint
+bool decodeAll(const std::string& data, size_t n, std::vector<int64_t>& out, bool* modes = nullptr) {
+    out.clear();
+    uint64_t prev = 0;
+    size_t pos = 0;
+    int64_t block[codec::kBlockSize];
+    for (size_t done = 0; done < n;) {
+        size_t count = std::min(n - done, codec::kBlockSize);
+        size_t used = 0;
+        if (modes && pos < data.size()) {
+            uint8_t mode = static_cast<uint8_t>(data[pos]);
+            modes[mode == proto::kBlockVarint ? 2 : mode == proto::kBlockDeltaVarint ? 3 :
+                  mode & proto::kBlockDelta ? 1 : 0] = true;
+        }
+        if (codec::decodeBlock(data.data() + pos, data.size() - pos, count, prev, block, used) != codec::Status::Ok) {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) out.push_back(static_cast<int64_t>(le64toh(static_cast<uint64_t>(block[i]))));
+        pos += used;
+        done += count;
+    }
+    return pos == data.size();
+}
+
+// Каждый обрезанный блок — NeedMore, и prev не меняется
+bool truncatedNeedsMore(const std::string& block, size_t n) {
+    int64_t out[codec::kBlockSize];
+    for (size_t len = 0; len < block.size(); len++) {
+        uint64_t prev = 42;
+        size_t used = 7;
+        if (codec::decodeBlock(block.data(), len, n, prev, out, used) != codec::Status::NeedMore) return false;
+        if (prev != 42 || used != 7) return false;
+    }
+    return true;
+}
+
+// Значения, разброс которых занимает ровно w бит
+std::vector<int64_t> spread(std::mt19937_64& rng, size_t n, unsigned w, int64_t base) {
+    uint64_t mask = w == 64 ? ~uint64_t(0) : (uint64_t(1) << w) - 1;
+    std::vector<int64_t> out;
+    for (size_t i = 0; i < n; i++) out.push_back(static_cast<int64_t>(static_cast<uint64_t>(base) + (rng() & mask)));
+    out[0] = base;
+    if (n > 1) out[n - 1] = static_cast<int64_t>(static_cast<uint64_t>(base) + mask);
+    return out;
+}
+
+// Ручные блоки всех способов; возвращает описание первого расхождения
+std::string checkBlocks() {
+    std::mt19937_64 rng(42);
+    for (unsigned w : {0u, 1u, 57u, 59u, 63u, 64u}) {
+        for (size_t n : {size_t(1), size_t(5), codec::kBlockSize}) {
+            for (int64_t base : {int64_t(-1000), INT64_MIN, INT64_MAX - int64_t(w == 64 ? 0 : 1)}) {
+                if (w == 64 && base != INT64_MIN) continue;
+                std::string where = "ширина " + std::to_string(w) + ", n=" + std::to_string(n) + ", база " +
+                                    std::to_string(base);
+                std::vector<int64_t> values, got;
+                // От базы у верхней границы поля выходят за INT64_MAX
+                values = spread(rng, n, w, base);
+                std::string block = bitBlock(values, false, w, base);
+                if (!decodeAll(block, n, got) || got != values) return "биты, " + where;
+                if (!truncatedNeedsMore(block, n)) return "NeedMore, биты, " + where;
+
+                // Разности той же ширины: сумма переходит через границы int64
+                std::vector<int64_t> steps = spread(rng, n, w, base);
+                values.clear();
+                uint64_t last = 0;
+                for (int64_t d : steps) values.push_back(static_cast<int64_t>(last += static_cast<uint64_t>(d)));
+                block = bitBlock(steps, true, w, base);
+                if (!decodeAll(block, n, got) || got != values) return "разности, " + where;
+                if (!truncatedNeedsMore(block, n)) return "NeedMore, разности, " + where;
+
+                for (bool delta : {false, true}) {
+                    block = varintBlock(delta ? deltas(values, 0) : values, delta);
+                    if (!decodeAll(block, n, got) || got != values) return "varint, " + where;
+                    if (!truncatedNeedsMore(block, n)) return "NeedMore, varint, " + where;
+                }
+            }
+        }
+    }
+    return "";
+}
+
+struct Pattern {
+    const char* name;
+    int64_t (*next)(std::mt19937_64& rng, size_t i);
+};
+
+const Pattern kPatterns[] = {
+    {"постоянные", [](std::mt19937_64&, size_t) { return int64_t(7); }},
+    {"малые", [](std::mt19937_64& rng, size_t) { return static_cast<int64_t>(rng() % 2001) - 1000; }},
+    {"случайные", [](std::mt19937_64& rng, size_t) { return static_cast<int64_t>(rng()); }},
+    {"рост через INT64_MAX", [](std::mt19937_64&, size_t i) {
+        return static_cast<int64_t>(static_cast<uint64_t>(INT64_MAX) - 100 + 3 * i);
+    }},
+    {"INT64_MIN/MAX", [](std::mt19937_64& rng, size_t) { return rng() & 1 ? INT64_MAX : INT64_MIN; }},
+    {"рост с выбросами", [](std::mt19937_64& rng, size_t i) {
+        return i % 97 == 0 ? static_cast<int64_t>(rng()) : static_cast<int64_t>(i);
+    }},
+    {"малые с выбросами", [](std::mt19937_64& rng, size_t i) {
+        return i % 97 == 0 ? static_cast<int64_t>(rng()) : static_cast<int64_t>(rng() % 61);
+    }},
+};
+
+// encode и обратно; возвращает описание первого расхождения
+std::string checkRoundTrip(bool modes_seen[4]) {
+    std::mt19937_64 rng(7);
+    for (const Pattern& pattern : kPatterns) {
+        for (size_t n : {size_t(1), size_t(3), size_t(127), size_t(128), size_t(129), size_t(300), size_t(1000)}) {
+            std::vector<int64_t> values, got;
+            for (size_t i = 0; i < n; i++) values.push_back(pattern.next(rng, i));
+            std::string encoded;
+            codec::encode(values.data(), n, encoded);
+            if (!decodeAll(encoded, n, got, modes_seen) || got != values) {
+                return std::string(pattern.name) + ", n=" + std::to_string(n);
+            }
+        }
+    }
+    return "";
+}
+
+bool checkInvalid() {
+    int64_t out[codec::kBlockSize];
+    for (uint8_t mode : {uint8_t(proto::kMaxBlockWidth + 1), uint8_t(proto::kBlockDelta | (proto::kMaxBlockWidth + 1))}) {
+        std::string block(1, static_cast<char>(mode));
+        block += std::string(codec::kMaxBlockBytes, '\0');
+        uint64_t prev = 0;
+        size_t used = 0;
+        if (codec::decodeBlock(block.data(), block.size(), 1, prev, out, used) != codec::Status::Invalid) return false;
+    }
+    // varint длиннее 64 бит
+    std::string block(1, static_cast<char>(proto::kBlockVarint));
+    block += std::string(10, '\x80') + '\x01';
+    uint64_t prev = 0;
+    size_t used = 0;
+    return codec::decodeBlock(block.data(), block.size(), 1, prev, out, used) == codec::Status::Invalid;
+}
+
+}
+
+int main() {
+    for (const char* name : {"scalar", "avx2"}) {
+        if (!codec::forceImplementation(name)) {
+            printf("---- %s: не поддерживается процессором\n", name);
+            continue;
+        }
+        std::string mismatch = checkBlocks();
+        check(mismatch.empty(), std::string(name) + " блоки всех способов" +
+                                    (mismatch.empty() ? "" : ": расхождение (" + mismatch + ")"));
+        bool modes_seen[4] = {};
+        mismatch = checkRoundTrip(modes_seen);
+        check(mismatch.empty(), std::string(name) + " encode и обратно" +
+                                    (mismatch.empty() ? "" : ": расхождение (" + mismatch + ")"));
+        check(modes_seen[0] && modes_seen[1] && modes_seen[2] && modes_seen[3],
+              std::string(name) + " encode выбирает каждый способ");
+        check(checkInvalid(), std::string(name) + " ширина больше 64 и длинный varint — Invalid");
+    }
+
+    printf("%s\n", failures ? "ЕСТЬ ОШИБКИ" : "Все проверки пройдены");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+// Общие помощники проверок протокола против запущенного сервера: сборка
+// пакетов, аутентификация пользователя user с паролем P@ssW0rd, соединение
+// и обмен. Программа проверки печатает строки ok/FAIL через check и
+// завершается кодом summary().
+
+#include "../auth_message.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <endian.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+namespace fixture {
+
+inline int failures = 0;
+
+inline void check(bool ok, const std::string& what) {
+    printf("%s %s\n", ok ? "ok  " : "FAIL", what.c_str());
+    if (!ok) failures++;
+}
+
+// Итоговая строка и код завершения программы проверки
+inline int summary() {
+    printf("%s\n", failures ? "ЕСТЬ ОШИБКИ" : "Все проверки пройдены");
+    return failures ? 1 : 0;
+}
+
+inline void put32(std::string& out, uint32_t v) {
+    v = htole32(v);
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+inline std::string le64(int64_t v) {
+    uint64_t le = htole64(static_cast<uint64_t>(v));
+    return std::string(reinterpret_cast<const char*>(&le), sizeof(le));
+}
+
+inline void putVector(std::string& out, const std::vector<int64_t>& v) {
+    put32(out, static_cast<uint32_t>(v.size()));
+    for (int64_t x : v) out += le64(x);
+}
+
+// Сообщение аутентификации с постоянной солью; suffix — режимы сессии
+inline std::string authMessage(const std::string& suffix = "") {
+    return proto::authMessage("user", "P@ssW0rd", "0123456789abcdef") + suffix + '\n';
+}
+
+// Таймауты в 5 с на приём и отправку: зависший сервер даёт FAIL, а не
+// зависшую проверку
+inline int withTimeouts(int fd) {
+    timeval timeout{5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+inline int connectTcp(int port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return withTimeouts(fd);
+}
+
+inline int connectUnix(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return withTimeouts(fd);
+}
+
+inline bool sendAll(int fd, const std::string& data) {
+    for (size_t sent = 0; sent < data.size();) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Дописывает в out ровно len байт ответа
+inline bool recvExact(int fd, size_t len, std::string& out) {
+    char buf[4096];
+    while (len > 0) {
+        ssize_t n = recv(fd, buf, std::min(len, sizeof(buf)), 0);
+        if (n <= 0) return false;
+        out.append(buf, static_cast<size_t>(n));
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Дописывает в out всё, что придёт до закрытия соединения (или таймаута)
+inline void recvUntilClose(int fd, std::string& out) {
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) out.append(buf, static_cast<size_t>(n));
+}
+
+}
@@ -0,0 +1,153 @@
+// Сверка параллельной свёртки с последовательной (make check): один и тот
+// же пакет отправляется серверу с малым порогом -P (векторы от тысячи
+// элементов сворачиваются блоками в пуле) и эталонному серверу с -P 0.
+// Пакет — векторы вокруг границ блоков ParallelReducer и длиннее, чем
+// блоков в работе, обычные и компактные данные, порциями разного размера.
+// Средние и целочисленные поля записей должны совпасть с эталоном точно,
+// дисперсия — с точностью до младших битов; ответ параллельного сервера
+// не должен зависеть от порций и кодирования. Оба сервера работают в одном
+// режиме суммирования и знают пользователя user с паролем P@ssW0rd.
+//
+//   ./test/parallel_test -p <port> -r <port эталона>
+
+#include "../codec.h"
+#include "../protocol.h"
+#include "fixture.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace fixture;
+
+namespace {
+
+int port = 33333;
+int reference_port = 33334;
+
+// Размеры вокруг порога (1000) и блока (32768); 200000 элементов — больше
+// блоков, чем потоков пула плюс заполняемый, так что сессия ждёт свободный
+std::vector<std::vector<int64_t>> makeVectors() {
+    std::mt19937_64 rng(42);
+    std::vector<std::vector<int64_t>> vectors;
+    for (size_t n : {0, 999, 1000, 32768, 32769, 200000}) {
+        std::vector<int64_t> v(n);
+        for (size_t i = 0; i < n; i++) {
+            switch (vectors.size() % 3) {
+            case 0: v[i] = static_cast<int64_t>(rng()); break;
+            case 1: v[i] = static_cast<int64_t>(rng() % 2000001) - 1000000; break;
+            default: v[i] = INT64_MAX - static_cast<int64_t>(rng() % 1000); break;
+            }
+        }
+        vectors.push_back(std::move(v));
+    }
+    return vectors;
+}
+
+std::string buildBatch(const std::vector<std::vector<int64_t>>& vectors, uint32_t ops, bool compact) {
+    std::string batch;
+    put32(batch, static_cast<uint32_t>(vectors.size()) | (ops ? proto::kFlagOps : 0));
+    if (ops) put32(batch, ops);
+    for (const auto& v : vectors) {
+        if (!compact) {
+            putVector(batch, v);
+            continue;
+        }
+        put32(batch, static_cast<uint32_t>(v.size()));
+        codec::encode(v.data(), v.size(), batch);
+    }
+    return batch;
+}
+
+// Отправляет пакет порциями по chunk байт (0 — целиком) с паузами, чтобы
+// сервер получал вектор частями, и читает ответ до закрытия соединения
+std::string exchange(int to, const std::string& batch, bool compact, size_t chunk) {
+    int fd = connectTcp(to);
+    if (fd < 0) return "<нет соединения>";
+    std::string reply;
+    bool ok = sendAll(fd, authMessage(compact ? "Z" : ""));
+    for (size_t pos = 0; ok && pos < batch.size();) {
+        size_t len = chunk ? std::min(chunk, batch.size() - pos) : batch.size();
+        ok = sendAll(fd, batch.substr(pos, len));
+        pos += len;
+        if (chunk) std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    if (ok) recvUntilClose(fd, reply);
+    close(fd);
+    return reply;
+}
+
+double loadDouble(const char* p) {
+    uint64_t bits;
+    memcpy(&bits, p, sizeof(bits));
+    bits = le64toh(bits);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+// Ответы совпадают, кроме дисперсии и отклонения: они — с точностью 1e-9
+bool sameReply(const std::string& got, const std::string& want, uint32_t ops, size_t vectors) {
+    size_t record = ops ? proto::recordSize(ops) : sizeof(int64_t);
+    if (got.size() != want.size() || got.size() != 2 + record * vectors) return false;
+    if (!(ops & (proto::kOpVariance | proto::kOpStddev))) return got == want;
+    for (size_t pos = 2; pos < got.size();) {
+        for (uint32_t op = 1; op <= proto::kOpNegatives; op <<= 1) {
+            if (!(ops & op)) continue;
+            size_t size = op == proto::kOpSum ? 16 : 8;
+            if (op == proto::kOpVariance || op == proto::kOpStddev) {
+                double a = loadDouble(got.data() + pos), b = loadDouble(want.data() + pos);
+                if (std::fabs(a - b) > 1e-9 * std::fabs(b)) return false;
+            } else if (got.compare(pos, size, want, pos, size) != 0) {
+                return false;
+            }
+            pos += size;
+        }
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-p") == 0) port = std::atoi(argv[i + 1]);
+        if (strcmp(argv[i], "-r") == 0) reference_port = std::atoi(argv[i + 1]);
+    }
+
+    const auto vectors = makeVectors();
+    struct Request {
+        const char* name;
+        uint32_t ops;
+    };
+    const Request requests[] = {
+        {"средние", 0},
+        {"сумма, минимум, максимум, отрицательные", proto::kOpSum | proto::kOpMin | proto::kOpMax | proto::kOpNegatives},
+        {"все операции", proto::kKnownOps},
+    };
+    for (const Request& request : requests) {
+        const std::string want = exchange(reference_port, buildBatch(vectors, request.ops, false), false, 0);
+        std::string first;
+        bool same = true, stable = true;
+        for (bool compact : {false, true}) {
+            const std::string batch = buildBatch(vectors, request.ops, compact);
+            for (size_t chunk : {size_t(0), size_t(65539), size_t(4093)}) {
+                std::string got = exchange(port, batch, compact, chunk);
+                same = same && sameReply(got, want, request.ops, vectors.size());
+                if (first.empty()) first = got;
+                stable = stable && got == first;
+            }
+        }
+        check(same, std::string(request.name) + ": как у последовательной свёртки");
+        check(stable, std::string(request.name) + ": не зависит от порций и кодирования");
+    }
+
+    return summary();
+}
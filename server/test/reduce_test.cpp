@@ -0,0 +1,177 @@
+// Сверка ядер свёртки (make check): sumWrapped, accumulate и accumulateStats
+// под каждой реализацией, которую поддерживает процессор, сравниваются с
+// переносимыми эталонами *Scalar, а суммы, минимум и максимум — ещё и с
+// прямым циклом по __int128, не разделяющим с ядрами разложение суммы на
+// части. Длины не кратны ширине векторов, данные не выровнены; кроме
+// случайных значений — INT64_MIN и INT64_MAX.
+//
+//   ./test/reduce_test
+
+#include "../reduce.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <endian.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    printf("%s %s\n", ok ? "ok  " : "FAIL", what.c_str());
+    if (!ok) failures++;
+}
+
+struct Pattern {
+    const char* name;
+    int64_t (*next)(std::mt19937_64& rng);
+};
+
+const Pattern kPatterns[] = {
+    {"случайные", [](std::mt19937_64& rng) { return static_cast<int64_t>(rng()); }},
+    {"малые", [](std::mt19937_64& rng) { return static_cast<int64_t>(rng() % 2000001) - 1000000; }},
+    {"INT64_MAX", [](std::mt19937_64&) { return INT64_MAX; }},
+    {"INT64_MIN", [](std::mt19937_64&) { return INT64_MIN; }},
+    {"INT64_MIN/MAX", [](std::mt19937_64& rng) { return rng() & 1 ? INT64_MAX : INT64_MIN; }},
+    {"с крайними", [](std::mt19937_64& rng) {
+        uint64_t r = rng();
+        if (r % 8 == 0) return INT64_MIN;
+        if (r % 8 == 1) return INT64_MAX;
+        return static_cast<int64_t>(r) >> 8;
+    }},
+};
+
+std::vector<size_t> lengths() {
+    std::vector<size_t> out;
+    for (size_t n = 0; n <= 130; n++) out.push_back(n);
+    for (size_t n : {255, 256, 257, 1000, 4099, 65537}) out.push_back(n);
+    return out;
+}
+
+// Данные в сетевом (little-endian) порядке, начиная со смещения offset
+// байт от выровненного начала буфера
+const unsigned char* fill(std::vector<unsigned char>& buf, size_t offset, size_t n,
+                          const Pattern& pattern, std::mt19937_64& rng) {
+    buf.assign(offset + 8 * n + 8, 0);
+    for (size_t i = 0; i < n; i++) {
+        uint64_t le = htole64(static_cast<uint64_t>(pattern.next(rng)));
+        memcpy(buf.data() + offset + 8 * i, &le, sizeof(le));
+    }
+    return buf.data() + offset;
+}
+
+// Независимый эталон: элементы складываются по одному
+struct Plain {
+    int64_t wrapped = 0;
+    reduce::Sum sum;
+    int64_t min = INT64_MAX;
+    int64_t max = INT64_MIN;
+};
+
+Plain plain(const unsigned char* data, size_t n) {
+    Plain out;
+    uint64_t wrapped = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t le;
+        memcpy(&le, data + 8 * i, sizeof(le));
+        int64_t v = static_cast<int64_t>(le64toh(le));
+        wrapped += static_cast<uint64_t>(v);
+        out.sum.total += static_cast<reduce::int128_t>(v);
+        out.sum.count++;
+        out.sum.negatives += v < 0;
+        out.min = std::min(out.min, v);
+        out.max = std::max(out.max, v);
+    }
+    out.wrapped = static_cast<int64_t>(wrapped);
+    return out;
+}
+
+bool sameSum(const reduce::Sum& a, const reduce::Sum& b) {
+    return a.total == b.total && a.count == b.count && a.negatives == b.negatives;
+}
+
+// Сумма квадратов отклонений считается в другом порядке сложения
+bool nearlyEqual(double a, double b) {
+    return std::fabs(a - b) <= 1e-9 * std::max({1.0, std::fabs(a), std::fabs(b)});
+}
+
+bool sameStats(const reduce::Stats& a, const reduce::Stats& b) {
+    return sameSum(a.sum, b.sum) && a.min == b.min && a.max == b.max && nearlyEqual(a.mean, b.mean) &&
+           nearlyEqual(a.m2, b.m2);
+}
+
+// Все сочетания образца, длины и смещения под текущей реализацией;
+// возвращает описание первого расхождения или пустую строку
+std::string compareAll(const char* function) {
+    std::vector<unsigned char> buf;
+    std::mt19937_64 rng(42);
+    for (const Pattern& pattern : kPatterns) {
+        for (size_t n : lengths()) {
+            for (size_t offset : {0, 1, 3, 7, 8}) {
+                const unsigned char* data = fill(buf, offset, n, pattern, rng);
+                const Plain reference = plain(data, n);
+                bool ok = true;
+                if (strcmp(function, "sumWrapped") == 0) {
+                    int64_t got = reduce::sumWrapped(data, n);
+                    ok = got == reduce::sumWrappedScalar(data, n) && got == reference.wrapped;
+                } else if (strcmp(function, "accumulate") == 0) {
+                    // Накопление продолжается от непустого состояния
+                    reduce::Sum got, want, plain_want = reference.sum;
+                    got.total = want.total = -12345;
+                    got.count = want.count = 3;
+                    plain_want.total += -12345;
+                    plain_want.count += 3;
+                    reduce::accumulate(got, data, n);
+                    reduce::accumulateScalar(want, data, n);
+                    ok = sameSum(got, want) && sameSum(got, plain_want);
+                } else {
+                    for (bool with_variance : {false, true}) {
+                        reduce::Stats got, want;
+                        reduce::accumulateStats(got, data, n, with_variance);
+                        reduce::accumulateStatsScalar(want, data, n, with_variance);
+                        // Вторая часть объединяется с первой
+                        reduce::accumulateStats(got, data, n / 2, with_variance);
+                        reduce::accumulateStatsScalar(want, data, n / 2, with_variance);
+                        ok = ok && sameStats(got, want);
+                    }
+                    // Без объединения частей точная сумма, минимум и
+                    // максимум совпадают с прямым циклом
+                    reduce::Stats got;
+                    reduce::accumulateStats(got, data, n, true);
+                    ok = ok && sameSum(got.sum, reference.sum) && got.min == reference.min &&
+                         got.max == reference.max;
+                }
+                if (!ok) {
+                    return std::string(pattern.name) + ", n=" + std::to_string(n) + ", смещение " +
+                           std::to_string(offset);
+                }
+            }
+        }
+    }
+    return "";
+}
+
+}
+
+int main() {
+    for (const char* name : {"scalar", "avx2", "avx512"}) {
+        if (!reduce::forceImplementation(name)) {
+            printf("---- %s: не поддерживается процессором\n", name);
+            continue;
+        }
+        for (const char* function : {"sumWrapped", "accumulate", "accumulateStats"}) {
+            std::string mismatch = compareAll(function);
+            check(mismatch.empty(), std::string(name) + " " + function +
+                                        (mismatch.empty() ? "" : ": расхождение (" + mismatch + ")"));
+        }
+    }
+
+    printf("%s\n", failures ? "ЕСТЬ ОШИБКИ" : "Все проверки пройдены");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,204 @@
+// Проверка кольца в разделяемой памяти (make check): клиент Unix-сокета
+// запрашивает кольцо суффиксом 'M', получает memfd вместе с "OK" и пишет
+// в кольцо пакеты больше его размера, так что запись переходит через
+// границу двойного отображения; первый пакет заполняет кольцо до звонка, и
+// клиент ждёт места на futex. Второй пакет сессии отправляется после паузы, когда сервер
+// уже спит над пустым кольцом и нужен звонок. Ответы сверяются с ответами
+// на те же пакеты через сокет. Неверная позиция записи закрывает сессию,
+// а по TCP кольцо не передаётся. Сервер должен работать с кольцом -r 64 в
+// режиме суммирования wrap и знать пользователя user с паролем P@ssW0rd.
+//
+//   ./test/ring_test -p <port> -U <path>
+
+#include "../codec.h"
+#include "../protocol.h"
+#include "../shm_ring.h"
+#include "fixture.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace fixture;
+
+namespace {
+
+constexpr size_t kRingSize = 64 * 1024;
+
+int port = 33333;
+std::string unix_path;
+
+// Три вектора по 25000 элементов: пакет около 600 КиБ, в девять раз больше кольца
+std::string buildBatch(bool compact, uint32_t flags) {
+    std::mt19937_64 rng(42);
+    std::string batch;
+    put32(batch, 5 | flags);
+    for (size_t n : {25000, 1, 25000, 0, 25000}) {
+        std::vector<int64_t> v(n);
+        for (int64_t& x : v) x = static_cast<int64_t>(rng());
+        if (!compact) {
+            putVector(batch, v);
+            continue;
+        }
+        put32(batch, static_cast<uint32_t>(n));
+        codec::encode(v.data(), n, batch);
+    }
+    return batch;
+}
+
+// Ответ на пакет, отправленный через сокет без кольца
+std::string reference(const std::string& batch, bool compact) {
+    int fd = connectUnix(unix_path);
+    if (fd < 0) return "<нет соединения>";
+    std::string reply;
+    if (sendAll(fd, authMessage(compact ? "Z" : "") + batch)) recvUntilClose(fd, reply);
+    close(fd);
+    return reply;
+}
+
+// Читает "OK"; дескриптор кольца, если он пришёл с ответом, — в ring_fd
+bool recvStatus(int fd, int& ring_fd) {
+    ring_fd = -1;
+    char status[2];
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    iovec iov = {status, sizeof(status)};
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    if (n <= 0) return false;
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        memcpy(&ring_fd, CMSG_DATA(cmsg), sizeof(ring_fd));
+    }
+    std::string reply(status, static_cast<size_t>(n));
+    return recvExact(fd, sizeof(status) - reply.size(), reply) && reply == "OK";
+}
+
+// Пишет данные в кольцо так же, как отправлял бы их в сокет; doorbells —
+// число звонков уснувшему серверу
+bool writeRing(ShmRing& ring, int sock, const std::string& data, size_t& doorbells) {
+    for (size_t pos = 0; pos < data.size();) {
+        if (!ring.waitForSpace(1, 5000)) return false;
+        size_t n = std::min(data.size() - pos, ring.writable());
+        memcpy(ring.writePtr(), data.data() + pos, n);
+        pos += n;
+        if (ring.commit(n)) {
+            doorbells++;
+            if (!sendAll(sock, std::string(1, '\0'))) return false;
+        }
+    }
+    return true;
+}
+
+// Сессия через кольцо: два пакета, второй — после паузы
+void checkRingSession(bool compact) {
+    const std::string name = compact ? "компактное кодирование: " : "";
+    const std::string want = reference(buildBatch(compact, 0), compact);
+    std::string reply;
+    int ring_fd = -1;
+    int fd = connectUnix(unix_path);
+    bool ok = fd >= 0 && sendAll(fd, authMessage(compact ? "ZM" : "M")) && recvStatus(fd, ring_fd);
+    ShmRing ring;
+    ok = ok && ring_fd >= 0 && ring.attach(ring_fd) && ring.size() == kRingSize;
+    check(ok, name + "кольцо передано вместе с OK");
+    if (!ok) {
+        if (fd >= 0) close(fd);
+        return;
+    }
+    ring.closeFd();
+
+    // Обе копии области данных — одна и та же память
+    ring.data()[0] = 1;
+    ring.data()[ring.size()] = 2;
+    check(ring.data()[0] == 2, name + "область данных отображена дважды");
+
+    // Кольцо заполняется целиком до первого звонка: сервер спит, и после
+    // звонка клиент ждёт места на futex
+    const std::string first = buildBatch(compact, proto::kFlagKeepAlive);
+    memcpy(ring.writePtr(), first.data(), ring.size());
+    bool sleeping = ring.commit(ring.size());
+    check(sleeping && ring.writable() == 0, name + "сервер спит до первого звонка");
+    size_t doorbells = 0;
+    reply = "OK";
+    ok = sendAll(fd, std::string(1, '\0')) && ring.waitForSpace(1, 5000) &&
+         writeRing(ring, fd, first.substr(ring.size()), doorbells) && recvExact(fd, want.size() - 2, reply);
+    check(ok, name + "сервер освобождает место в заполненном кольце");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    doorbells = 0;
+    ok = ok && writeRing(ring, fd, buildBatch(compact, 0), doorbells);
+    check(doorbells > 0, name + "после паузы сервер будит звонок");
+    if (ok) recvUntilClose(fd, reply);
+    close(fd);
+    check(ok && want.size() > 2 && reply == want + want.substr(2), name + "ответы как через сокет");
+}
+
+// Позиция записи дальше конца кольца: сервер закрывает сессию
+void checkInvalidHead() {
+    int ring_fd = -1;
+    int fd = connectUnix(unix_path);
+    bool ok = fd >= 0 && sendAll(fd, authMessage("M")) && recvStatus(fd, ring_fd);
+    ShmRing ring;
+    ok = ok && ring_fd >= 0 && ring.attach(ring_fd);
+    if (ok) {
+        // В кольце начало длинного вектора: без проверки позиции сервер
+        // ждал бы его продолжения, а не закрывал сессию
+        std::string batch;
+        put32(batch, 1 | proto::kFlagKeepAlive);
+        put32(batch, 100000);
+        batch.resize(ring.size());
+        memcpy(ring.writePtr(), batch.data(), batch.size());
+        ring.commit(ring.size() + 1);
+        char rest;
+        ok = sendAll(fd, std::string(1, '\0'));
+        ssize_t n = recv(fd, &rest, 1, 0);
+        ok = ok && (n == 0 || (n < 0 && errno == ECONNRESET));
+    }
+    if (fd >= 0) close(fd);
+    check(ok, "неверная позиция записи закрывает сессию");
+}
+
+// По TCP кольцо не передаётся, и сессия продолжается через сокет
+void checkTcp() {
+    const std::string batch = buildBatch(false, 0);
+    const std::string want = reference(batch, false);
+    int ring_fd = -1;
+    std::string reply = "OK";
+    int fd = connectTcp(port);
+    bool ok = fd >= 0 && sendAll(fd, authMessage("M")) && recvStatus(fd, ring_fd) && ring_fd < 0 &&
+              sendAll(fd, batch);
+    if (ok) recvUntilClose(fd, reply);
+    if (fd >= 0) close(fd);
+    if (ring_fd >= 0) close(ring_fd);
+    check(ok && reply == want, "по TCP кольцо не передаётся");
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-p") == 0) port = std::atoi(argv[i + 1]);
+        if (strcmp(argv[i], "-U") == 0) unix_path = argv[i + 1];
+    }
+
+    checkRingSession(false);
+    checkRingSession(true);
+    checkInvalidHead();
+    checkTcp();
+
+    return summary();
+}
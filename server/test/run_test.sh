@@ -0,0 +1,98 @@
+#!/bin/sh
+# Проверка протокола сервера, запущенного на отдельном порту с временной
+# базой: по TCP, затем через Unix-сокет и кольцо в разделяемой памяти;
+# лимит скорости — с epoll, рабочими потоками (-t) и io_uring (-U);
+# передача сокетов новому процессу (-H); параллельная свёртка (-P) против
+# последовательной на втором порту. Затем сервер со счётчиком выделений
+# памяти (test/server_alloc) проверяется в однопоточном режиме и с рабочими
+# потоками (-t).
+#
+#   make check [CHECK_PORT=33398]
+set -e
+cd "$(dirname "$0")/.."
+
+PORT=$((${CHECK_PORT:-33398} + 1))
+TMP=$(mktemp -d)
+SERVER=
+trap 'kill $SERVER 2>/dev/null || true; wait 2>/dev/null; rm -rf "$TMP"' EXIT
+
+echo "user P@ssW0rd" > "$TMP/db.txt"
+./server -d "$TMP/db.txt" -LU "$TMP/log.txt" -p "$PORT" -u "$TMP/server.sock" -r 64 -v warn > /dev/null &
+SERVER=$!
+sleep 0.5
+
+echo "--- TCP"
+./test/session_test -p "$PORT"
+echo "--- Unix-сокет"
+./test/session_test -U "$TMP/server.sock"
+echo "--- Кольцо в разделяемой памяти"
+./test/ring_test -p "$PORT" -U "$TMP/server.sock"
+kill $SERVER
+wait $SERVER 2>/dev/null || true
+
+for MODE in "" "-t 4" "-U"; do
+    echo "--- Лимит скорости ${MODE:-(epoll)}"
+    ./server -d "$TMP/db.txt" -LU "$TMP/log.txt" -p "$PORT" -q 5,4000 -v warn $MODE > /dev/null &
+    SERVER=$!
+    sleep 0.5
+    ./test/session_test -p "$PORT" -q 5,4000
+    kill $SERVER
+    wait $SERVER 2>/dev/null || true
+done
+
+# Сессия, начатая до передачи сокетов, дообслуживается прежним процессом;
+# клиенты, подключившиеся во время передачи, обслуживаются; прежний
+# процесс завершается, дообслужив сессии
+echo "--- Передача сокетов"
+./server -d "$TMP/db.txt" -LU "$TMP/log.txt" -p "$PORT" -H "$TMP/handoff.sock" -v warn > /dev/null &
+OLD=$!
+sleep 0.5
+./test/session_test -p "$PORT" -s 1000 &
+CLIENT=$!
+sleep 0.2
+./server -d "$TMP/db.txt" -LU "$TMP/log2.txt" -p "$PORT" -H "$TMP/handoff.sock" -v warn > /dev/null &
+SERVER=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    if ! ./test/session_test -p "$PORT" > /dev/null; then
+        echo "FAIL соединение во время передачи сокетов"
+        kill $OLD 2>/dev/null || true
+        exit 1
+    fi
+done
+echo "ok   соединения во время передачи сокетов"
+wait $CLIENT
+(sleep 5; kill $OLD 2>/dev/null) &
+TIMER=$!
+if ! wait $OLD; then
+    echo "FAIL прежний процесс не завершился после передачи сокетов"
+    exit 1
+fi
+kill $TIMER 2>/dev/null || true
+echo "ok   прежний процесс завершился"
+./test/session_test -p "$PORT"
+kill $SERVER
+wait $SERVER 2>/dev/null || true
+
+# Порог -P 1000 вместо миллиона по умолчанию: иначе при -n 100000 пул
+# параллельной свёртки даже не создаётся
+for MODE in "-s wrap" "-s wide -t 4"; do
+    echo "--- Параллельная свёртка $MODE"
+    ./server -d "$TMP/db.txt" -LU "$TMP/log.txt" -p "$PORT" -n 300000 -P 1000,4 -v warn $MODE > /dev/null &
+    SERVER=$!
+    ./server -d "$TMP/db.txt" -LU "$TMP/log2.txt" -p "$((PORT + 1))" -n 300000 -P 0 -v warn $MODE > /dev/null &
+    SERVER="$SERVER $!"
+    sleep 0.5
+    ./test/parallel_test -p "$PORT" -r "$((PORT + 1))"
+    kill $SERVER
+    wait $SERVER 2>/dev/null || true
+done
+
+for MODE in "" "-t 4"; do
+    echo "--- Выделения памяти ${MODE:-(один поток)}"
+    ./test/server_alloc -d "$TMP/db.txt" -LU "$TMP/log.txt" -p "$PORT" -M "$TMP/metrics.sock" -v warn $MODE > /dev/null &
+    SERVER=$!
+    sleep 0.5
+    ./test/alloc_test -p "$PORT" -M "$TMP/metrics.sock"
+    kill $SERVER
+    wait $SERVER 2>/dev/null || true
+done
@@ -0,0 +1,171 @@
+// Проверка поведения сервера на уровне протокола (make check): пакеты
+// собираются вручную, ответ читается до закрытия соединения. Сервер должен
+// работать в режиме суммирования wrap с ограничением размера вектора по
+// умолчанию (100000 элементов) и знать пользователя user с паролем P@ssW0rd.
+// С -q проверяется только лимит скорости: сервер запущен с тем же -q; с -s —
+// только сессия с паузой между пакетами (на время паузы run_test.sh
+// передаёт сокеты новому процессу).
+//
+//   ./test/session_test [-p <port>] [-U <path>] [-q <векторов/с>,<байт/с>] [-s <мс>]
+
+#include "../codec.h"
+#include "../protocol.h"
+#include "fixture.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace fixture;
+
+namespace {
+
+int port = 33333;
+std::string unix_path;
+
+int connectServer() {
+    return unix_path.empty() ? connectTcp(port) : connectUnix(unix_path);
+}
+
+// Отправляет сообщение аутентификации и запрос целиком, затем читает всё,
+// что сервер пришлёт до закрытия соединения. Ошибки отправки не считаются:
+// сервер вправе закрыть соединение, не дочитав запрос
+std::string exchange(const std::string& request, bool compact = false) {
+    int fd = connectServer();
+    if (fd < 0) return "<нет соединения>";
+    std::string reply;
+    sendAll(fd, authMessage(compact ? "Z" : "") + request);
+    recvUntilClose(fd, reply);
+    close(fd);
+    return reply;
+}
+
+// Сессия с компактным кодированием ('Z') получает те же средние, что и с
+// обычным; векторы — на все способы блоков, с коротким последним блоком
+void checkCompact() {
+    std::mt19937_64 rng(42);
+    std::vector<std::vector<int64_t>> vectors;
+    vectors.push_back({});
+    vectors.push_back({INT64_MAX, INT64_MAX, INT64_MIN});
+    vectors.push_back(std::vector<int64_t>(300, -5));
+    for (size_t n : {1, 127, 129, 1000}) {
+        std::vector<int64_t> small, large, rising;
+        for (size_t i = 0; i < n; i++) {
+            small.push_back(static_cast<int64_t>(rng() % 2001) - 1000);
+            large.push_back(static_cast<int64_t>(rng()));
+            rising.push_back(static_cast<int64_t>(1000000000000 + 7 * i));
+        }
+        vectors.insert(vectors.end(), {small, large, rising});
+    }
+
+    std::string plain, compact;
+    put32(plain, static_cast<uint32_t>(vectors.size()));
+    put32(compact, static_cast<uint32_t>(vectors.size()));
+    for (const auto& v : vectors) {
+        putVector(plain, v);
+        put32(compact, static_cast<uint32_t>(v.size()));
+        codec::encode(v.data(), v.size(), compact);
+    }
+    std::string want = exchange(plain);
+    check(want.size() == 2 + 8 * vectors.size() && exchange(compact, true) == want,
+          "компактное кодирование: те же средние");
+}
+
+// Запросы больше ёмкости ведра (секунды лимита) проходят: сессия ждёт
+// пополнения ведра, не читая вход, а не закрывается
+void checkRateLimit(uint32_t vectors_per_sec, uint32_t bytes_per_sec) {
+    std::string batch;
+    std::string reply = "OK";
+    put32(batch, 2 * vectors_per_sec);
+    for (uint32_t i = 0; i < 2 * vectors_per_sec; i++) {
+        putVector(batch, {int64_t(i)});
+        reply += le64(i);
+    }
+    check(exchange(batch) == reply, "пакет больше ёмкости ведра векторов");
+
+    std::string vector;
+    put32(vector, 1);
+    putVector(vector, std::vector<int64_t>(2 * bytes_per_sec / sizeof(int64_t), 7));
+    check(exchange(vector) == "OK" + le64(7), "вектор больше ёмкости ведра байт");
+
+    // Ведро векторов пусто: следующий пакет ждёт его пополнения
+    auto start = std::chrono::steady_clock::now();
+    bool ok = exchange(batch) == reply;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    check(ok && elapsed > 0.5, "пакет ждёт пополнения ведра");
+}
+
+// Сессия, начатая до паузы, дообслуживается тем же процессом после неё
+void checkPausedSession(int pause_ms) {
+    std::string expected = "OK" + le64(2) + le64(5);
+    std::string reply;
+    int fd = connectServer();
+    if (fd >= 0) {
+        std::string first = authMessage();
+        put32(first, 1 | proto::kFlagKeepAlive);
+        putVector(first, {1, 2, 3});
+        std::string second;
+        put32(second, 1);
+        putVector(second, {4, 6});
+
+        if (sendAll(fd, first) && recvExact(fd, 10, reply)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(pause_ms));
+            if (sendAll(fd, second)) recvUntilClose(fd, reply);
+        }
+        close(fd);
+    }
+    check(reply == expected, "сессия продолжается после паузы");
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t vectors_per_sec = 0, bytes_per_sec = 0;
+    int pause_ms = -1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-p") == 0) port = std::atoi(argv[i + 1]);
+        if (strcmp(argv[i], "-U") == 0) unix_path = argv[i + 1];
+        if (strcmp(argv[i], "-q") == 0) sscanf(argv[i + 1], "%u,%u", &vectors_per_sec, &bytes_per_sec);
+        if (strcmp(argv[i], "-s") == 0) pause_ms = std::atoi(argv[i + 1]);
+    }
+    if (pause_ms >= 0) {
+        checkPausedSession(pause_ms);
+        return summary();
+    }
+    if (vectors_per_sec && bytes_per_sec) {
+        checkRateLimit(vectors_per_sec, bytes_per_sec);
+        return summary();
+    }
+    const std::vector<int64_t> oversize(200000, 1);
+
+    // Ошибка в середине пакета: результаты предыдущих векторов доходят до
+    // клиента до закрытия соединения
+    std::string request;
+    put32(request, 3);
+    putVector(request, {4, 6});
+    putVector(request, oversize);
+    check(exchange(request) == "OK" + le64(5), "результаты до ошибки в пакете");
+
+    // Кадр ответа отправляется только целиком: незаконченный кадр
+    // отбрасывается, а ответ на предыдущий пакет сессии доходит
+    request.clear();
+    put32(request, 1 | proto::kFlagFramedReply | proto::kFlagKeepAlive);
+    putVector(request, {1, 2, 3});
+    put32(request, 2 | proto::kFlagFramedReply | proto::kFlagKeepAlive);
+    putVector(request, {4, 6});
+    putVector(request, oversize);
+    std::string framed = "OK";
+    put32(framed, 1);
+    framed += le64(2);
+    check(exchange(request) == framed, "незаконченный кадр ответа не отправляется");
+
+    checkCompact();
+
+    return summary();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+// Отладочная трассировка в stdout с уровнями TRACE/DEBUG/INFO/WARN/CRIT.
+// Минимальный уровень задаётся при сборке (make TRACE_LEVEL=0..5): вызовы
+// ниже него отбрасываются через if constexpr и не компилируются вовсе.
+// Включённые при сборке уровни дополнительно фильтруются по уровню,
+// заданному при запуске (-v).
+//
+//   trace::print<trace::Level::Debug>("Размер вектора ", i, ": ", size);
+//   if (trace::enabled<trace::Level::Trace>()) { ...дорогой вывод... }
+//
+// Уровень сборки входит в параметры шаблонов: объекты, собранные с разными
+// TRACE_LEVEL, компонуются вместе без смешения экземпляров (bench/trace_bench).
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL 1
+#endif
+
+namespace trace {
+
+enum class Level : int { Trace = 0, Debug = 1, Info = 2, Warn = 3, Crit = 4, Off = 5 };
+
+constexpr Level kCompiledLevel = static_cast<Level>(TRACE_LEVEL);
+
+inline std::atomic<int> runtime_level{static_cast<int>(Level::Info)};
+inline std::mutex output_mutex;
+
+template <Level L, Level Compiled = kCompiledLevel>
+constexpr bool compiled() {
+    return static_cast<int>(L) >= static_cast<int>(Compiled);
+}
+
+template <Level L, Level Compiled = kCompiledLevel>
+inline bool enabled() {
+    if constexpr (!compiled<L, Compiled>()) {
+        return false;
+    } else {
+        return static_cast<int>(L) >= runtime_level.load(std::memory_order_relaxed);
+    }
+}
+
+inline void setLevel(Level level) {
+    runtime_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+// Разбор уровня из командной строки: имя (trace, debug, ...) или число 0-5
+inline bool parseLevel(const char* text, Level& level) {
+    static const char* const names[] = {"trace", "debug", "info", "warn", "crit", "off"};
+    for (int i = 0; i <= static_cast<int>(Level::Off); i++) {
+        if (strcmp(text, names[i]) == 0 || (text[0] == '0' + i && text[1] == '\0')) {
+            level = static_cast<Level>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+template <Level L, Level Compiled = kCompiledLevel, typename... Args>
+inline void print(const Args&... args) {
+    if constexpr (compiled<L, Compiled>()) {
+        if (!enabled<L, Compiled>()) return;
+        std::lock_guard<std::mutex> lock(output_mutex);
+        (std::cout << ... << args) << '\n';
+    }
+}
+
+}
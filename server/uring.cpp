@@ -0,0 +1,295 @@
+#include "uring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+int setup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int registerRing(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+template <typename T>
+T* at(void* base, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+// Индексы колец разделяются с ядром: чтение чужого — acquire, запись своего — release
+unsigned loadAcquire(const unsigned* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+void storeRelease(unsigned* p, unsigned v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+}
+
+Uring::~Uring() {
+    close();
+}
+
+bool Uring::init(unsigned entries, unsigned buf_count, size_t buf_size) {
+    // Завершения выполняются в контексте потока при входе в ядро — без
+    // межпроцессорных прерываний; старые ядра не знают этот флаг
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+    fd_ = setup(entries, &params);
+    if (fd_ < 0 && errno == EINVAL) {
+        memset(&params, 0, sizeof(params));
+        fd_ = setup(entries, &params);
+    }
+    if (fd_ < 0) return false;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                    IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        sq_ring_ = nullptr;
+        close();
+        return false;
+    }
+    if (single_mmap) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                        IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            cq_ring_ = nullptr;
+            close();
+            return false;
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                      IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        close();
+        return false;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    sq_head_ = at<unsigned>(sq_ring_, params.sq_off.head);
+    sq_tail_ = at<unsigned>(sq_ring_, params.sq_off.tail);
+    sq_mask_ = *at<unsigned>(sq_ring_, params.sq_off.ring_mask);
+    sq_entries_ = *at<unsigned>(sq_ring_, params.sq_off.ring_entries);
+    sq_array_ = at<unsigned>(sq_ring_, params.sq_off.array);
+    sq_local_tail_ = *sq_tail_;
+    cq_head_ = at<unsigned>(cq_ring_, params.cq_off.head);
+    cq_tail_ = at<unsigned>(cq_ring_, params.cq_off.tail);
+    cq_mask_ = *at<unsigned>(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = at<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+
+    // Кольцо предоставленных буферов: ядро само выбирает буфер для приёма,
+    // поэтому память не закрепляется за соединениями, ожидающими данных
+    buf_count_ = buf_count;
+    buf_size_ = buf_size;
+    buffers_.reset(new char[buf_count * buf_size]);
+    if (!initBufferRing() && !initProvidedBuffers()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool Uring::initBufferRing() {
+    buf_ring_size_ = buf_count_ * sizeof(io_uring_buf);
+    void* ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) return false;
+    buf_ring_ = static_cast<io_uring_buf_ring*>(ring);
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = buf_count_;
+    reg.bgid = kBufGroup;
+    if (registerRing(fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        munmap(buf_ring_, buf_ring_size_);
+        buf_ring_ = nullptr;
+        return false;
+    }
+    for (unsigned i = 0; i < buf_count_; i++) recycle(static_cast<uint16_t>(i));
+
+    // Регистрация проходит и там, где ядро потом не выдаёт буферы из
+    // кольца (приём завершается ENOBUFS); проверяем одним байтом
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) < 0) return true;
+    ssize_t n = write(pair[1], "", 1);
+    int res = -1;
+    uint32_t flags = 0;
+    io_uring_sqe* probe = sqe();
+    if (n == 1) {
+        probe->opcode = IORING_OP_RECV;
+        probe->fd = pair[0];
+        probe->flags = IOSQE_BUFFER_SELECT;
+        probe->buf_group = kBufGroup;
+        if (submit(1) >= 0) {
+            if (io_uring_cqe* cqe = peek()) {
+                res = cqe->res;
+                flags = cqe->flags;
+                advance();
+            }
+        }
+    }
+    ::close(pair[0]);
+    ::close(pair[1]);
+    if (flags & IORING_CQE_F_BUFFER) recycle(static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT));
+    if (res == 1) return true;
+
+    io_uring_buf_reg unreg;
+    memset(&unreg, 0, sizeof(unreg));
+    unreg.bgid = kBufGroup;
+    registerRing(fd_, IORING_UNREGISTER_PBUF_RING, &unreg, 1);
+    munmap(buf_ring_, buf_ring_size_);
+    buf_ring_ = nullptr;
+    return false;
+}
+
+bool Uring::initProvidedBuffers() {
+    // Прежний способ (5.7+): буферы передаются ядру операциями
+    // IORING_OP_PROVIDE_BUFFERS; возврат буфера — ещё один SQE
+    io_uring_sqe* provide = sqe();
+    provide->opcode = IORING_OP_PROVIDE_BUFFERS;
+    provide->fd = static_cast<int>(buf_count_);
+    provide->addr = reinterpret_cast<uint64_t>(buffers_.get());
+    provide->len = static_cast<uint32_t>(buf_size_);
+    provide->buf_group = kBufGroup;
+    if (submit(1) < 0) return false;
+    io_uring_cqe* cqe = peek();
+    if (!cqe) return false;
+    int res = cqe->res;
+    advance();
+    recycled_ += buf_count_;
+    return res >= 0;
+}
+
+void Uring::close() {
+    if (buf_ring_) munmap(buf_ring_, buf_ring_size_);
+    if (sqes_) munmap(sqes_, sqes_size_);
+    if (cq_ring_ && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_) munmap(sq_ring_, sq_ring_size_);
+    if (fd_ >= 0) ::close(fd_);
+    buf_ring_ = nullptr;
+    sqes_ = nullptr;
+    cq_ring_ = sq_ring_ = nullptr;
+    deferred_.clear();
+    fd_ = -1;
+}
+
+bool Uring::sqFull() const {
+    return sq_local_tail_ - loadAcquire(sq_head_) >= sq_entries_;
+}
+
+io_uring_sqe* Uring::sqe() {
+    if (deferred_.empty() && sqFull()) {
+        deferLinkedTail();
+        submitQueued(0);
+    }
+    if (!deferred_.empty() || sqFull()) {
+        deferred_.emplace_back();
+        return &deferred_.back();
+    }
+    unsigned index = sq_local_tail_ & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    sq_local_tail_++;
+    return sqe;
+}
+
+// Неотправленное начало цепочки IOSQE_IO_LINK в конце кольца уходит в
+// отложенные: отправленное без продолжения, оно выполнилось бы отдельно
+void Uring::deferLinkedTail() {
+    unsigned start = sq_local_tail_;
+    while (start != *sq_tail_ && (sqes_[(start - 1) & sq_mask_].flags & IOSQE_IO_LINK)) start--;
+    for (unsigned i = start; i != sq_local_tail_; i++) deferred_.push_back(sqes_[i & sq_mask_]);
+    sq_local_tail_ = start;
+}
+
+// Отложенные SQE переносятся в кольцо по порядку, цепочки — целиком
+void Uring::moveDeferred() {
+    while (!deferred_.empty()) {
+        size_t chain = 1;
+        while (chain < deferred_.size() && (deferred_[chain - 1].flags & IOSQE_IO_LINK)) chain++;
+        if (sq_entries_ - (sq_local_tail_ - loadAcquire(sq_head_)) < chain) return;
+        for (size_t i = 0; i < chain; i++) {
+            unsigned index = sq_local_tail_ & sq_mask_;
+            sqes_[index] = deferred_.front();
+            sq_array_[index] = index;
+            sq_local_tail_++;
+            deferred_.pop_front();
+        }
+    }
+}
+
+int Uring::submit(unsigned wait_nr) {
+    while (!deferred_.empty()) {
+        moveDeferred();
+        int ret = submitQueued(0);
+        if (ret < 0) return ret;
+        if (ret == 0) break;
+    }
+    return submitQueued(wait_nr);
+}
+
+int Uring::submitQueued(unsigned wait_nr) {
+    unsigned to_submit = sq_local_tail_ - *sq_tail_;
+    storeRelease(sq_tail_, sq_local_tail_);
+    if (to_submit == 0 && wait_nr == 0) return 0;
+    for (;;) {
+        int ret = enter(fd_, to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+        if (ret < 0 && errno == EINTR) continue;
+        return ret;
+    }
+}
+
+io_uring_cqe* Uring::peek() {
+    unsigned head = *cq_head_;
+    if (head == loadAcquire(cq_tail_)) return nullptr;
+    return &cqes_[head & cq_mask_];
+}
+
+void Uring::advance() {
+    storeRelease(cq_head_, *cq_head_ + 1);
+}
+
+void Uring::recycle(uint16_t bid) {
+    if (!buf_ring_) {
+        // Успешное завершение не порождает CQE; ошибка придёт с user_data 0
+        io_uring_sqe* provide = sqe();
+        provide->opcode = IORING_OP_PROVIDE_BUFFERS;
+        provide->flags = IOSQE_CQE_SKIP_SUCCESS;
+        provide->fd = 1;
+        provide->addr = reinterpret_cast<uint64_t>(buffers_.get() + bid * buf_size_);
+        provide->len = static_cast<uint32_t>(buf_size_);
+        provide->buf_group = kBufGroup;
+        provide->off = bid;
+        recycled_++;
+        return;
+    }
+    unsigned short tail = buf_ring_->tail;
+    io_uring_buf* buf = &buf_ring_->bufs[tail & (buf_count_ - 1)];
+    buf->addr = reinterpret_cast<uint64_t>(buffers_.get() + bid * buf_size_);
+    buf->len = static_cast<uint32_t>(buf_size_);
+    buf->bid = bid;
+    __atomic_store_n(&buf_ring_->tail, static_cast<unsigned short>(tail + 1), __ATOMIC_RELEASE);
+    recycled_++;
+}
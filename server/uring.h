@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <linux/io_uring.h>
+#include <memory>
+
+// Минимальная обёртка io_uring поверх системных вызовов (без liburing):
+// кольца SQ/CQ, подготовка SQE и группа предоставленных буферов для
+// приёма — кольцо буферов (IORING_REGISTER_PBUF_RING, ядро 5.19+), а если
+// оно не работает, IORING_OP_PROVIDE_BUFFERS. Объект используется одним
+// потоком; user_data 0 зарезервирован для служебных операций обёртки.
+class Uring {
+public:
+    Uring() = default;
+    ~Uring();
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+
+    // Создаёт кольцо на entries SQE и группу из buf_count буферов по
+    // buf_size байт (buf_count — степень двойки); false, если io_uring или
+    // нужные возможности ядра недоступны
+    bool init(unsigned entries, unsigned buf_count, size_t buf_size);
+
+    // Свободный SQE (обнулённый), никогда не nullptr. При заполненном
+    // кольце накопленное отправляется в ядро; если ядро не приняло SQE
+    // (EBUSY, пока не разобраны CQE), новые откладываются и уходят
+    // последующими submit в том же порядке. SQE с IOSQE_IO_LINK нужно
+    // заполнить до запроса следующего: цепочка не разрывается между отправками
+    io_uring_sqe* sqe();
+    // Отправляет отложенные и подготовленные SQE и ждёт не меньше wait_nr
+    // завершений; EBUSY — сначала нужно разобрать готовые CQE
+    int submit(unsigned wait_nr);
+
+    // Обход готовых CQE: peek, затем advance после обработки
+    io_uring_cqe* peek();
+    void advance();
+
+    static constexpr uint16_t kBufGroup = 0;
+    const char* buffer(uint16_t bid) const { return buffers_.get() + bid * buf_size_; }
+    size_t bufferSize() const { return buf_size_; }
+    // Возвращает буфер в кольцо предоставленных буферов
+    void recycle(uint16_t bid);
+    // Сколько раз буферы возвращались в кольцо (для повтора приёма после ENOBUFS)
+    uint64_t recycled() const { return recycled_; }
+
+private:
+    int fd_ = -1;
+    void* sq_ring_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    void* cq_ring_ = nullptr;
+    size_t cq_ring_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sq_local_tail_ = 0;
+    // SQE, не поместившиеся в кольцо (deque: адреса не меняются при росте)
+    std::deque<io_uring_sqe> deferred_;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned cq_mask_ = 0;
+
+    io_uring_buf_ring* buf_ring_ = nullptr;
+    size_t buf_ring_size_ = 0;
+    unsigned buf_count_ = 0;
+    size_t buf_size_ = 0;
+    uint64_t recycled_ = 0;
+    std::unique_ptr<char[]> buffers_;
+
+    bool sqFull() const;
+    void deferLinkedTail();
+    void moveDeferred();
+    int submitQueued(unsigned wait_nr);
+    bool initBufferRing();
+    bool initProvidedBuffers();
+    void close();
+};
@@ -0,0 +1,112 @@
+#include "worker_pool.h"
+
+namespace {
+// Пул и номер очереди текущего рабочего потока (для локальной постановки)
+thread_local const WorkerPool* tls_pool = nullptr;
+thread_local size_t tls_index = 0;
+}
+
+void WorkerPool::Queue::pushBack(Task&& task) {
+    if (count == ring.size()) {
+        std::vector<Task> grown(ring.size() * 2);
+        for (size_t i = 0; i < count; i++) {
+            grown[i] = std::move(ring[(head + i) % ring.size()]);
+        }
+        ring.swap(grown);
+        head = 0;
+    }
+    ring[(head + count) % ring.size()] = std::move(task);
+    count++;
+}
+
+bool WorkerPool::Queue::popFront(Task& task) {
+    if (count == 0) return false;
+    task = std::move(ring[head]);
+    ring[head] = nullptr;
+    head = (head + 1) % ring.size();
+    count--;
+    return true;
+}
+
+bool WorkerPool::Queue::popBack(Task& task) {
+    if (count == 0) return false;
+    size_t index = (head + count - 1) % ring.size();
+    task = std::move(ring[index]);
+    ring[index] = nullptr;
+    count--;
+    return true;
+}
+
+WorkerPool::WorkerPool(size_t threads) {
+    if (threads == 0) threads = 1;
+    for (size_t i = 0; i < threads; i++) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        threads_.emplace_back(&WorkerPool::workerLoop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() { stop(); }
+
+void WorkerPool::submit(Task task) {
+    size_t index = (tls_pool == this) 
+        ? tls_index 
+        : next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->pushBack(std::move(task));
+    }
+    pending_.fetch_add(1, std::memory_order_release);
+    {
+        // Пустая критическая секция исключает потерю пробуждения
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+    }
+    wait_cv_.notify_one();
+}
+
+void WorkerPool::stop() {
+    if (stopping_.exchange(true)) return;
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+    }
+    wait_cv_.notify_all();
+    for (auto& t : threads_) {
+        if (t.joinable()) t.join();
+    }
+}
+
+bool WorkerPool::popLocal(size_t index, Task& task) {
+    Queue& q = *queues_[index];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    return q.popFront(task);
+}
+
+bool WorkerPool::steal(size_t index, Task& task) {
+    for (size_t k = 1; k < queues_.size(); k++) {
+        Queue& q = *queues_[(index + k) % queues_.size()];
+        std::unique_lock<std::mutex> lock(q.mutex, std::try_to_lock);
+        if (lock.owns_lock() && q.popBack(task)) return true;
+    }
+    return false;
+}
+
+void WorkerPool::workerLoop(size_t index) {
+    tls_pool = this;
+    tls_index = index;
+
+    Task task;
+    while (!stopping_.load(std::memory_order_acquire)) {
+        if (popLocal(index, task) || steal(index, task)) {
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wait_mutex_);
+        wait_cv_.wait(lock, [this] {
+            return stopping_.load(std::memory_order_acquire) ||
+                   pending_.load(std::memory_order_acquire) > 0;
+        });
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул рабочих потоков с отдельной очередью на каждый поток и кражей задач.
+// Задача, поставленная из рабочего потока, попадает в его собственную
+// очередь; остальные распределяются по кругу. Освободившийся поток сначала
+// берёт задачи из своей очереди (с начала), затем крадёт с конца чужих.
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkerPool(size_t threads);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void submit(Task task);
+    void stop();
+    size_t size() const { return queues_.size(); }
+
+private:
+    // Кольцевая очередь задач: в отличие от std::deque не выделяет и не
+    // освобождает блоки памяти при постоянном потоке задач
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::vector<Task> ring = std::vector<Task>(64);
+        size_t head = 0;
+        size_t count = 0;
+
+        void pushBack(Task&& task);
+        bool popFront(Task& task);
+        bool popBack(Task& task);
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_{0};
+    std::atomic<size_t> pending_{0};
+    std::atomic<bool> stopping_{false};
+    std::mutex wait_mutex_;
+    std::condition_variable wait_cv_;
+
+    bool popLocal(size_t index, Task& task);
+    bool steal(size_t index, Task& task);
+    void workerLoop(size_t index);
+};